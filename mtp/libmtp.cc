@@ -0,0 +1,354 @@
+/*
+ *  mtp is the ``Multi Tracked Paths'', an implementation of the
+ *  k-shortest paths algorithm for multi-target tracking.
+ *
+ *  Copyright (c) 2012 Idiap Research Institute, http://www.idiap.ch/
+ *  Written by Francois Fleuret <francois.fleuret@idiap.ch>
+ *
+ *  This file is part of mtp.
+ *
+ *  mtp is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  mtp is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ *  License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with selector.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <stdint.h>
+
+#include "libmtp.h"
+#include "mtp_tracker.h"
+#include "mtp_greedy.h"
+#include "mtp_detections.h"
+
+struct mtp_tracker {
+  MTPTracker tracker;
+  // Applied to the scores by mtp_track
+  int quantization;
+  // With the greedy engine, mtp_track uses greedy, and the read-out
+  // is from it
+  int engine;
+  MTPGreedy greedy;
+};
+
+mtp_tracker *mtp_create(int nb_time_steps, int nb_locations,
+                        const int *motion_first, const int *motion_to) {
+  if(nb_time_steps <= 0 || nb_locations <= 0 || !motion_first || !motion_to) return 0;
+  // The entrances, exits and scores are indexed with a size_t
+  if((unsigned long long) nb_time_steps * (unsigned long long) nb_locations >
+     SIZE_MAX / (2 * sizeof(int) + sizeof(scalar_t))) return 0;
+
+  if(motion_first[0] != 0) return 0;
+  for(int l = 0; l < nb_locations; l++) {
+    if(motion_first[l + 1] < motion_first[l]) return 0;
+  }
+  for(int k = 0; k < motion_first[nb_locations]; k++) {
+    if(motion_to[k] < 0 || motion_to[k] >= nb_locations) return 0;
+  }
+
+  mtp_tracker *result = new mtp_tracker;
+  result->quantization = MTPTracker::QUANTIZATION_NONE;
+  result->engine = MTP_ENGINE_KSP;
+  if(result->tracker.allocate(nb_time_steps, nb_locations, motion_first, motion_to) < 0) {
+    delete result;
+    return 0;
+  }
+  return result;
+}
+
+void mtp_destroy(mtp_tracker *tracker) {
+  delete tracker;
+}
+
+static int copy_flags(mtp_tracker *tracker, int **to, const int *from) {
+  if(!tracker || !from) return -1;
+  int n = tracker->tracker.nb_locations;
+  for(int t = 0; t < tracker->tracker.nb_time_steps; t++) {
+    for(int l = 0; l < n; l++) {
+      to[t][l] = from[size_t(t) * size_t(n) + size_t(l)];
+    }
+  }
+  return 0;
+}
+
+int mtp_set_entrances(mtp_tracker *tracker, const int *entrances) {
+  return copy_flags(tracker, tracker ? tracker->tracker.entrances : 0, entrances);
+}
+
+int mtp_set_exits(mtp_tracker *tracker, const int *exits) {
+  return copy_flags(tracker, tracker ? tracker->tracker.exits : 0, exits);
+}
+
+int mtp_set_scores(mtp_tracker *tracker, float *scores) {
+  if(!tracker || !scores) return -1;
+  tracker->tracker.borrow_detection_scores(scores);
+  return 0;
+}
+
+int mtp_set_option(mtp_tracker *tracker, const char *name, double value) {
+  if(!tracker || !name) return -1;
+  MTPTracker *t = &tracker->tracker;
+  if(strcmp(name, "prune") == 0) {
+    t->prune_unreachable_vertices = value != 0;
+  } else if(strcmp(name, "gating") == 0) {
+    t->gating = value != 0;
+  } else if(strcmp(name, "gating_threshold") == 0) {
+    t->gating_threshold = scalar_t(value);
+  } else if(strcmp(name, "gating_radius") == 0) {
+    if(value < 0) return -1;
+    t->gating_radius = int(value);
+  } else if(strcmp(name, "grid_width") == 0) {
+    t->grid_width = int(value);
+  } else if(strcmp(name, "coarse_cell_size") == 0) {
+    t->coarse_cell_size = int(value);
+  } else if(strcmp(name, "coarse_pooling") == 0) {
+    if(value != MTPTracker::POOLING_MAX && value != MTPTracker::POOLING_LOG_SUM_EXP) return -1;
+    t->coarse_pooling = int(value);
+  } else if(strcmp(name, "corridor_radius") == 0) {
+    if(value < 0) return -1;
+    t->corridor_radius = int(value);
+  } else if(strcmp(name, "temporal_factor") == 0) {
+    t->temporal_factor = int(value);
+  } else if(strcmp(name, "max_trajectories") == 0) {
+    if(value < 0) return -1;
+    t->max_nb_trajectories = int(value);
+  } else if(strcmp(name, "min_gain") == 0) {
+    t->min_trajectory_gain = scalar_t(value);
+  } else if(strcmp(name, "quantization") == 0) {
+    if(value != MTPTracker::QUANTIZATION_NONE && value != MTPTracker::QUANTIZATION_INT8 &&
+       value != MTPTracker::QUANTIZATION_FP16) return -1;
+    tracker->quantization = int(value);
+  } else if(strcmp(name, "exact_trajectories") == 0) {
+    t->exact_nb_trajectories = value != 0;
+  } else if(strcmp(name, "incremental") == 0) {
+    t->incremental_shortest_paths = value != 0;
+  } else if(strcmp(name, "bidirectional") == 0) {
+    t->bidirectional_shortest_paths = value != 0;
+  } else if(strcmp(name, "build_threads") == 0) {
+    t->nb_build_threads = int(value);
+  } else if(strcmp(name, "engine") == 0) {
+    if(value != MTP_ENGINE_KSP && value != MTP_ENGINE_GREEDY) return -1;
+    tracker->engine = int(value);
+  } else if(strcmp(name, "memory_budget") == 0) {
+    if(value < 0) return -1;
+    t->memory_budget = size_t(value);
+  } else if(strcmp(name, "pages") == 0) {
+    if(value != STORAGE_PAGES_DEFAULT && value != STORAGE_PAGES_TRANSPARENT &&
+       value != STORAGE_PAGES_HUGETLB) return -1;
+    t->storage_pages = int(value);
+  } else if(strcmp(name, "numa_node") == 0) {
+    if(value >= storage_nb_numa_nodes()) return -1;
+    t->storage_numa_node = value < 0 ? -1 : int(value);
+  } else if(strcmp(name, "vertex_order") == 0) {
+    if(value != MTPTracker::ORDER_LOCATION && value != MTPTracker::ORDER_HILBERT &&
+       value != MTPTracker::ORDER_MORTON) return -1;
+    t->vertex_order = int(value);
+  } else {
+    return -1;
+  }
+  return 0;
+}
+
+int mtp_set_initial_trajectories(mtp_tracker *tracker, int nb,
+                                 const int *entrance_times, const int *durations,
+                                 const int *locations) {
+  if(!tracker || nb < 0) return -1;
+  if(nb > 0 && (!entrance_times || !durations || !locations)) return -1;
+  return tracker->tracker.set_initial_trajectories(nb, entrance_times, durations, locations);
+}
+
+int mtp_plan(mtp_tracker *tracker,
+             double *memory_bytes, double *storage_bytes, double *seconds) {
+  static MTPPlan calibrated;
+  static int calibration_done = 0;
+  if(!tracker) return -1;
+  if(!calibration_done) {
+    calibrated.calibrate();
+    calibration_done = 1;
+  }
+  MTPPlan plan = calibrated;
+  tracker->tracker.plan(&plan);
+  if(memory_bytes) *memory_bytes = double(plan.memory_bytes);
+  if(storage_bytes) *storage_bytes = double(plan.storage_bytes);
+  if(seconds) *seconds = plan.total_seconds;
+  return plan.nb_recommendations;
+}
+
+int mtp_track(mtp_tracker *tracker, double time_budget) {
+  if(!tracker) return -1;
+  MTPTracker *t = &tracker->tracker;
+  // MTPTracker aborts on these, we can report them instead
+  if(t->coarse_cell_size > 1 && t->temporal_factor > 1) return -1;
+  if((t->coarse_cell_size > 1 || t->temporal_factor > 1) &&
+     t->nb_initial_trajectories() > 0) return -1;
+  // Without a number, the exact mode would add every path left
+  if(t->exact_nb_trajectories && t->max_nb_trajectories < 1) return -1;
+  if((t->coarse_cell_size > 1 || t->vertex_order != MTPTracker::ORDER_LOCATION) &&
+     (t->grid_width <= 0 || t->nb_locations % t->grid_width != 0)) return -1;
+  // Does nothing if the scores are already quantized
+  t->quantize_detection_scores(tracker->quantization);
+  if(tracker->engine == MTP_ENGINE_GREEDY) {
+    tracker->greedy.track(t);
+    return 0;
+  }
+  // Both fail without allocating when over memory_budget
+  if(t->build_graph() < 0 || t->track(time_budget) < 0) return -1;
+  return 0;
+}
+
+int mtp_sweep(mtp_tracker *tracker, int nb_transforms,
+              const float *offsets, const float *scales, const float *clamps,
+              float *total_scores, int *nb_trajectories, int nb_threads) {
+  if(!tracker || nb_transforms < 0 || !offsets || !scales || !clamps ||
+     !total_scores || !nb_trajectories) return -1;
+  MTPTracker *t = &tracker->tracker;
+  if(tracker->engine != MTP_ENGINE_KSP) return -1;
+  if(t->coarse_cell_size > 1 || t->temporal_factor > 1) return -1;
+  if(t->exact_nb_trajectories && t->max_nb_trajectories < 1) return -1;
+  if(t->vertex_order != MTPTracker::ORDER_LOCATION &&
+     (t->grid_width <= 0 || t->nb_locations % t->grid_width != 0)) return -1;
+  t->quantize_detection_scores(tracker->quantization);
+  ScoreTransform *transforms = new ScoreTransform[nb_transforms];
+  SweepResult *results = new SweepResult[nb_transforms];
+  for(int k = 0; k < nb_transforms; k++) {
+    transforms[k].offset = offsets[k];
+    transforms[k].scale = scales[k];
+    transforms[k].clamp = clamps[k];
+  }
+  int result = -1;
+  // Both fail without allocating when over memory_budget, the sweep
+  // once the graph and a single copy do not fit
+  if(t->build_graph() >= 0 && t->sweep(nb_transforms, transforms, results, nb_threads) >= 0) {
+    for(int k = 0; k < nb_transforms; k++) {
+      total_scores[k] = results[k].total_score;
+      nb_trajectories[k] = results[k].nb_trajectories;
+    }
+    result = 0;
+  }
+  delete[] transforms;
+  delete[] results;
+  return result;
+}
+
+int mtp_interrupted(mtp_tracker *tracker) {
+  if(!tracker) return -1;
+  if(tracker->engine == MTP_ENGINE_GREEDY) return 0;
+  return tracker->tracker.interrupted();
+}
+
+int mtp_nb_trajectories(mtp_tracker *tracker) {
+  if(!tracker) return -1;
+  if(tracker->engine == MTP_ENGINE_GREEDY) return tracker->greedy.nb_trajectories();
+  return tracker->tracker.nb_trajectories();
+}
+
+// MTPTracker and MTPGreedy have the same read-out
+
+template<class Tracker>
+static int total_nb_locations(Tracker *t) {
+  long long total = 0;
+  for(int k = 0; k < t->nb_trajectories(); k++) {
+    total += t->trajectory_duration(k);
+  }
+  // More than an int can count
+  if(total > INT_MAX) return -1;
+  return int(total);
+}
+
+template<class Tracker>
+static int get_trajectories(Tracker *t,
+                            int *entrance_times, int *durations, float *scores,
+                            int *locations, int locations_size) {
+  if(locations) {
+    int total = total_nb_locations(t);
+    if(total < 0 || total > locations_size) return -1;
+  }
+
+  int n = 0;
+  for(int k = 0; k < t->nb_trajectories(); k++) {
+    if(entrance_times) entrance_times[k] = t->trajectory_entrance_time(k);
+    if(durations) durations[k] = t->trajectory_duration(k);
+    if(scores) scores[k] = t->trajectory_score(k);
+    if(locations) {
+      for(int u = 0; u < t->trajectory_duration(k); u++) {
+        locations[n++] = t->trajectory_location(k, u);
+      }
+    }
+  }
+
+  return t->nb_trajectories();
+}
+
+int mtp_total_nb_locations(mtp_tracker *tracker) {
+  if(!tracker) return -1;
+  if(tracker->engine == MTP_ENGINE_GREEDY) return total_nb_locations(&tracker->greedy);
+  return total_nb_locations(&tracker->tracker);
+}
+
+int mtp_get_trajectories(mtp_tracker *tracker,
+                         int *entrance_times, int *durations, float *scores,
+                         int *locations, int locations_size) {
+  if(!tracker) return -1;
+  if(tracker->engine == MTP_ENGINE_GREEDY) {
+    return get_trajectories(&tracker->greedy,
+                            entrance_times, durations, scores, locations, locations_size);
+  }
+  return get_trajectories(&tracker->tracker,
+                          entrance_times, durations, scores, locations, locations_size);
+}
+
+int mtp_rasterize_detections(float *scores, int nb_frames, const int *frame_first,
+                             const float *xy, const float *confidences,
+                             float x_min, float x_max, float y_min, float y_max,
+                             int grid_width, int grid_height, int splat,
+                             float false_positive_rate, float false_negative_rate,
+                             int nb_threads) {
+  if(!scores || nb_frames <= 0 || !frame_first || grid_width <= 0 || grid_height <= 0) return -1;
+  // The locations of a frame are indexed with an int
+  if((long long) grid_width * grid_height > INT_MAX) return -1;
+  if(false_positive_rate <= 0 || false_positive_rate >= 1 ||
+     false_negative_rate <= 0 || false_negative_rate >= 1) return -1;
+  if(frame_first[0] != 0) return -1;
+  for(int t = 0; t < nb_frames; t++) {
+    if(frame_first[t + 1] < frame_first[t]) return -1;
+  }
+  if(frame_first[nb_frames] > 0 && !xy) return -1;
+  if(!isfinite(x_min) || !isfinite(x_max) || !isfinite(y_min) || !isfinite(y_max)) return -1;
+  if(confidences) {
+    for(int k = 0; k < frame_first[nb_frames]; k++) {
+      // Also false for a NaN
+      if(!(confidences[k] >= 0 && confidences[k] <= 1)) return -1;
+    }
+  }
+
+  MTPDetections detections;
+  detections.x_min = x_min;
+  detections.x_max = x_max;
+  detections.y_min = y_min;
+  detections.y_max = y_max;
+  detections.grid_width = grid_width;
+  detections.grid_height = grid_height;
+  detections.mode = splat ? MTPDetections::SPLAT : MTPDetections::SNAP;
+  detections.false_positive_rate = false_positive_rate;
+  detections.false_negative_rate = false_negative_rate;
+  detections.nb_threads = nb_threads;
+
+  float **rows = new float *[nb_frames];
+  for(int t = 0; t < nb_frames; t++) {
+    rows[t] = scores + size_t(t) * size_t(grid_width) * size_t(grid_height);
+  }
+  detections.rasterize(nb_frames, frame_first, xy, confidences, rows);
+  delete[] rows;
+
+  return 0;
+}
@@ -0,0 +1,166 @@
+/*
+ *  mtp is the ``Multi Tracked Paths'', an implementation of the
+ *  k-shortest paths algorithm for multi-target tracking.
+ *
+ *  Copyright (c) 2012 Idiap Research Institute, http://www.idiap.ch/
+ *  Written by Francois Fleuret <francois.fleuret@idiap.ch>
+ *
+ *  This file is part of mtp.
+ *
+ *  mtp is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  mtp is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ *  License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with selector.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LIBMTP_H
+#define LIBMTP_H
+
+// A C interface to MTPTracker, for the libmtp shared library, so that
+// it can be used from other languages (e.g. python through ctypes)
+// without going through files and a process.
+//
+// All the arrays are row-major and contiguous. Except for
+// mtp_create, the functions returning an int return 0, or a count,
+// on success, and -1 if the arguments are invalid.
+
+#ifdef _WIN32
+#define MTP_API __declspec(dllexport)
+#else
+#define MTP_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct mtp_tracker mtp_tracker;
+
+// The values of the "engine" option
+enum { MTP_ENGINE_KSP, MTP_ENGINE_GREEDY };
+
+// Creates a tracker for nb_time_steps x nb_locations, with the
+// motions given as lists: the locations reachable from l are
+// motion_to[motion_first[l]] to motion_to[motion_first[l+1]-1], so
+// motion_first has nb_locations+1 entries. Returns null if the
+// arguments are invalid, if nb_time_steps x nb_locations can not be
+// indexed, or if the tracker would take more than the default memory
+// budget.
+MTP_API mtp_tracker *mtp_create(int nb_time_steps, int nb_locations,
+                                const int *motion_first, const int *motion_to);
+
+MTP_API void mtp_destroy(mtp_tracker *tracker);
+
+// Copy the nb_time_steps x nb_locations flags
+MTP_API int mtp_set_entrances(mtp_tracker *tracker, const int *entrances);
+MTP_API int mtp_set_exits(mtp_tracker *tracker, const int *exits);
+
+// The nb_time_steps x nb_locations scores are not copied, the buffer
+// has to stay valid until the next call to mtp_set_scores or
+// mtp_destroy
+MTP_API int mtp_set_scores(mtp_tracker *tracker, float *scores);
+
+// Sets one of the options of MTPTracker: "prune", "gating",
+// "gating_threshold", "gating_radius", "grid_width",
+// "coarse_cell_size", "coarse_pooling" (0 for max, 1 for
+// log-sum-exp), "corridor_radius", "temporal_factor",
+// "max_trajectories", "min_gain", "exact_trajectories", "incremental",
+// "bidirectional", "quantization" (0 for none, 1 for 8 bits, 2 for
+// half-precision floats, applied by mtp_track to the scores),
+// "vertex_order" (0 for the locations, 1 for a Hilbert curve, 2 for a
+// Z-order curve), "build_threads" (0 for one per core),
+// "memory_budget" (in bytes, 0 for none, the size of the RAM by
+// default), "pages" (0 for the default, 1 for transparent huge pages,
+// 2 for explicit ones), "numa_node" (-1 for none) or "engine"
+// (MTP_ENGINE_KSP, or MTP_ENGINE_GREEDY for the fast but not optimal
+// MTPGreedy, which uses only the max_trajectories, min_gain and
+// quantization options). Returns -1 for an unknown name, or a value
+// out of range, such as a negative gating_radius.
+MTP_API int mtp_set_option(mtp_tracker *tracker, const char *name, double value);
+
+// Makes mtp_track start from the given trajectories, for instance
+// the ones of a previous tracking with slightly different scores,
+// see MTPTracker::set_initial_trajectories. They are in the format of
+// mtp_get_trajectories, and copied. Returns -1 and keeps none if they
+// do not fit the entrances, exits and motions, nb zero removes them.
+MTP_API int mtp_set_initial_trajectories(mtp_tracker *tracker, int nb,
+                                         const int *entrance_times, const int *durations,
+                                         const int *locations);
+
+// Predicts the memory the tracking will use, in RAM and in the
+// file-backed storage, in bytes, and its duration in seconds, with a
+// cost model calibrated at the first call. Any of the pointers can be
+// null. Returns the number of options mtp --plan would recommend to
+// fit in the memory budget, 0 if it fits.
+MTP_API int mtp_plan(mtp_tracker *tracker,
+                     double *memory_bytes, double *storage_bytes, double *seconds);
+
+// Builds the graph and tracks, during at most time_budget seconds if
+// it is not zero. Returns -1, with no trajectory, if the memory
+// budget is exceeded by the graph, or with the coarse-to-fine
+// trackings by one of their graphs, and without tracking if
+// exact_trajectories is set with a max_trajectories below 1.
+MTP_API int mtp_track(mtp_tracker *tracker, double time_budget);
+
+// Builds the graph and tracks once per transform of the scores, the
+// score s of transform k becoming offsets[k] + scales[k] * s, bounded
+// to [-clamps[k], clamps[k]] if clamps[k] is not zero, and fills
+// total_scores and nb_trajectories, of nb_transforms entries, see
+// MTPTracker::sweep. Every tracking starts from the trajectories of
+// the previous transform, with nb_threads blocks of transforms
+// tracked concurrently, or one per core if it is zero. The tracker
+// has no trajectories afterwards, until the next mtp_track. Returns
+// -1 with the greedy engine, with exact_trajectories but no
+// max_trajectories of at least 1, or if the memory budget is exceeded.
+MTP_API int mtp_sweep(mtp_tracker *tracker, int nb_transforms,
+                      const float *offsets, const float *scales, const float *clamps,
+                      float *total_scores, int *nb_trajectories, int nb_threads);
+
+// Non-zero if the last mtp_track was stopped by its time budget
+MTP_API int mtp_interrupted(mtp_tracker *tracker);
+
+MTP_API int mtp_nb_trajectories(mtp_tracker *tracker);
+
+// Sum of the durations of the trajectories, that is the size needed
+// for the locations of mtp_get_trajectories, or -1 if it does not fit
+// in an int
+MTP_API int mtp_total_nb_locations(mtp_tracker *tracker);
+
+// Fills entrance_times, durations and scores, of mtp_nb_trajectories
+// entries each, and locations with the locations of all the
+// trajectories one after another. Any of them can be null. Returns
+// the number of trajectories, or -1 if locations_size is too small.
+MTP_API int mtp_get_trajectories(mtp_tracker *tracker,
+                                 int *entrance_times, int *durations, float *scores,
+                                 int *locations, int locations_size);
+
+// Writes in scores the nb_frames x (grid_width * grid_height) scores
+// computed from point detections, see MTPDetections. The detections
+// of frame t are frame_first[t] to frame_first[t+1]-1, at xy[2k],
+// xy[2k+1] and of confidence confidences[k], or 1 if confidences is
+// null. With splat zero, every detection is snapped to its nearest
+// location, and otherwise splatted on the four nearest ones. The
+// detections with a coordinate which is not finite, such as a NaN for
+// a target which was not located, are ignored. Returns -1 if a
+// confidence is not in [0, 1]. The frames are done in parallel with
+// nb_threads threads, or one per core if it is zero.
+MTP_API int mtp_rasterize_detections(float *scores, int nb_frames, const int *frame_first,
+                                     const float *xy, const float *confidences,
+                                     float x_min, float x_max, float y_min, float y_max,
+                                     int grid_width, int grid_height, int splat,
+                                     float false_positive_rate, float false_negative_rate,
+                                     int nb_threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
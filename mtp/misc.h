@@ -26,9 +26,21 @@
 #define MISC_H
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <chrono>
 
 typedef float scalar_t;
 
+// Indices of the vertices and edges, which may not fit in an int on
+// long sequences
+typedef int64_t index_t;
+
+// Wall-clock time in seconds from an arbitrary origin, to measure
+// durations
+inline double now_in_seconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 #ifdef DEBUG
 #define ASSERT(x) if(!(x)) {                                            \
     std::cerr << "ASSERT FAILED IN " << __FILE__ << ":" << __LINE__ << endl; \
@@ -40,7 +52,7 @@ typedef float scalar_t;
 
 template<class T>
 T **allocate_array(int a, int b) {
-  T *whole = new T[a * b];
+  T *whole = new T[size_t(a) * size_t(b)];
   T **array = new T *[a];
   for(int k = 0; k < a; k++) {
     array[k] = whole;
@@ -1,231 +1,910 @@
-//
-///*
-// *  mtp is the ``Multi Tracked Paths'', an implementation of the
-// *  k-shortest paths algorithm for multi-target tracking.
-// *
-// *  Copyright (c) 2012 Idiap Research Institute, http://www.idiap.ch/
-// *  Written by Francois Fleuret <francois.fleuret@idiap.ch>
-// *
-// *  This file is part of mtp.
-// *
-// *  mtp is free software: you can redistribute it and/or modify it
-// *  under the terms of the GNU General Public License version 3 as
-// *  published by the Free Software Foundation.
-// *
-// *  mtp is distributed in the hope that it will be useful, but WITHOUT
-// *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
-// *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
-// *  License for more details.
-// *
-// *  You should have received a copy of the GNU General Public License
-// *  along with selector.  If not, see <http://www.gnu.org/licenses/>.
-// *
-// */
-//
-//#include <iostream>
-//#include <fstream>
-//#include <time.h>
-//#include <windows.h>
-////#include "mtp/getopt.h"
-//#include <limits.h>
-//#include <string.h>
-//
-//using namespace std;
-//
-//#include "mtp_tracker.h"
-//
-//#define FILENAME_SIZE 1024
-//
-//struct Global {
-//  char trajectory_filename[FILENAME_SIZE];
-//  char graph_filename[FILENAME_SIZE];
-//  int verbose;
-//} global;
-//
-//void usage(ostream *os) {
-//  (*os) << "mtp [-h|--help] [--help-formats] [-v|--verbose] [-t|--trajectory-filename <trajectory filename>] [-g|--graph-filename <graph filename>] [<tracking parameter file>]" << endl;
-//  (*os) << endl;
-//  (*os) << "The mtp command processes a file containing the description of a topology" << endl;
-//  (*os) << "and detection scores, and prints the optimal set of trajectories." << endl;
-//  (*os) << endl;
-//  (*os) << "If no filename is provided, it reads the parameters from the standard" << endl;
-//  (*os) << "input. If no trajectory filename is provided, it writes the result to" << endl;
-//  (*os) << "the standard output." << endl;
-//  (*os) << endl;
-//  (*os) << "Written by Francois Fleuret. (C) Idiap Research Institute, 2012." << endl;
-//}
-//
-//void print_help_formats() {
-//  cout << "The tracking parameters the command takes as input have the following" << endl;
-//  cout << "format, where L is the number of locations and T is the number of time" << endl;
-//  cout << "steps:" << endl;
-//  cout << endl;
-//  cout << "---------------------------- snip snip -------------------------------" << endl;
-//  cout << "  int:L int:T" << endl;
-//  cout << endl;
-//  cout << "  bool:allowed_motion_from_1_to_1 ... bool:allowed_motion_from_1_to_L" << endl;
-//  cout << "  ..." << endl;
-//  cout << "  bool:allowed_motion_from_L_to_1 ... bool:allowed_motion_from_L_to_L" << endl;
-//  cout << endl;
-//  cout << "  bool:entrance_1_1 ... bool:entrance_1_L" << endl;
-//  cout << "  ..." << endl;
-//  cout << "  bool:entrance_T_1 ... bool:entrance_T_L" << endl;
-//  cout << endl;
-//  cout << "  bool:exit_1_1 ... bool:exit_1_L" << endl;
-//  cout << "  ..." << endl;
-//  cout << "  bool:exit_T_1 ... bool:exit_T_L" << endl;
-//  cout << endl;
-//  cout << "  float:detection_score_1_1 ... float:detection_score_1_L" << endl;
-//  cout << "  ..." << endl;
-//  cout << "  float:detection_score_T_1 ... float:detection_score_T_L" << endl;
-//  cout << "---------------------------- snip snip -------------------------------" << endl;
-//  cout << endl;
-//  cout << "As results, the command writes first the number of trajectories," << endl;
-//  cout << "followed by one line per trajectory with the following structure:" << endl;
-//  cout << endl;
-//  cout << "---------------------------- snip snip -------------------------------" << endl;
-//  cout << "  int:traj_number int:entrance_time int:duration float:score int:location_1 ... int:location_duration" << endl;
-//  cout << "---------------------------- snip snip -------------------------------" << endl;
-//}
-//
-//scalar_t diff_in_second(struct timeval *start, struct timeval *end) {
-//  return
-//    scalar_t(end->tv_sec - start->tv_sec) +
-//    scalar_t(end->tv_usec - start->tv_usec)/1000000;
-//}
-//
-//void do_tracking(istream *in_tracker) {
-//  timeval start_time, end_time;
-//  MTPTracker *tracker = new MTPTracker();
-//
-//  if(global.verbose) { cout << "Reading the tracking parameters." << endl; }
-//  tracker->read(in_tracker);
-//
-//  if(global.verbose) {
-//    cout << "Building the graph ... "; cout.flush();
-//    //gettimeofday(&start_time, 0);
-//  }
-//  tracker->build_graph();
-//  if(global.verbose) {
-//    //gettimeofday(&end_time, 0);
-//    cout << "done (" << diff_in_second(&start_time, &end_time) << "s)." << endl;
-//  }
-//
-//  if(global.verbose) {
-//    cout << "Tracking ... "; cout.flush();
-//    //gettimeofday(&start_time, 0);
-//  }
-//  tracker->track();
-//  if(global.verbose) {
-//    //gettimeofday(&end_time, 0);
-//    cout << "done (" << diff_in_second(&start_time, &end_time) << "s)." << endl;
-//  }
-//
-//  if(global.trajectory_filename[0]) {
-//    ofstream out_traj(global.trajectory_filename);
-//    tracker->write_trajectories(&out_traj);
-//    if(global.verbose) { cout << "Wrote " << global.trajectory_filename << "." << endl; }
-//  } else {
-//    tracker->write_trajectories(&cout);
-//  }
-//
-//  if(global.graph_filename[0]) {
-//    ofstream out_dot(global.graph_filename);
-//    tracker->print_graph_dot(&out_dot);
-//    if(global.verbose) { cout << "Wrote " << global.graph_filename << "." << endl; }
-//  }
-//
-//  delete tracker;
-//}
-//
-//enum
-//{
-//  OPT_HELP_FORMATS = CHAR_MAX + 1
-//};
-//
-////static struct option long_options[] = {
-////  { "trajectory-file", 1, 0, 't' },
-////  { "graph-file", 1, 0, 'g' },
-////  { "help", no_argument, 0, 'h' },
-////  { "verbose", no_argument, 0, 'v' },
-////  { "help-formats", no_argument, 0, OPT_HELP_FORMATS },
-////  { 0, 0, 0, 0 }
-////};
-//
-//int main(int argc, char *argv[]) {
-//  int c;
-//  int error = 0, show_help = 0;
-//
-//  strncpy(global.trajectory_filename, argv[2], FILENAME_SIZE);
-//  strncpy(global.graph_filename, argv[3], FILENAME_SIZE);
-//  global.verbose = atoi(argv[4]);
-//
-//  ifstream *file_in_tracker = new ifstream(argv[1]);
-//  if (file_in_tracker->good()) {
-//	  do_tracking(file_in_tracker);
-//  }
-//  else {
-//	  cerr << "Can not open " << argv[1] << endl;
-//	  exit(EXIT_FAILURE);
-//  }
-//  
-//  /*strncpy(global.trajectory_filename, "", FILENAME_SIZE);
-//  strncpy(global.graph_filename, "", FILENAME_SIZE);
-//  global.verbose = 0;
-//
-//  while ((c = getopt(argc, argv, "t:g:hv")) != -1) {
-//
-//    switch(c) {
-//
-//    case 't':
-//      strncpy(global.trajectory_filename, optarg, FILENAME_SIZE);
-//      break;
-//
-//    case 'g':
-//      strncpy(global.graph_filename, optarg, FILENAME_SIZE);
-//      break;
-//
-//    case 'h':
-//      show_help = 1;
-//      break;
-//
-//    case OPT_HELP_FORMATS:
-//      print_help_formats();
-//      exit(EXIT_SUCCESS);
-//      break;
-//
-//    case 'v':
-//      global.verbose = 1;
-//      break;
-//
-//    default:
-//      error = 1;
-//      break;
-//    }
-//  }*/
-//
-//  /*if(error) {
-//    usage(&cerr);
-//    exit(EXIT_FAILURE);
-//  }
-//
-//  if(show_help) {
-//    usage(&cout);
-//    exit(EXIT_SUCCESS);
-//  }*/
-//
-//  /*if(optind < argc) {
-//    ifstream *file_in_tracker = new ifstream(argv[optind]);
-//    if(file_in_tracker->good()) {
-//      do_tracking(file_in_tracker);
-//    } else {
-//      cerr << "Can not open " << argv[optind] << endl;
-//      exit(EXIT_FAILURE);
-//    }
-//    delete file_in_tracker;
-//  } else {
-//    do_tracking(&cin);
-//  }*/
-//
-//  exit(EXIT_SUCCESS);
-//}
+/*
+ *  mtp is the ``Multi Tracked Paths'', an implementation of the
+ *  k-shortest paths algorithm for multi-target tracking.
+ *
+ *  Copyright (c) 2012 Idiap Research Institute, http://www.idiap.ch/
+ *  Written by Francois Fleuret <francois.fleuret@idiap.ch>
+ *
+ *  This file is part of mtp.
+ *
+ *  mtp is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  mtp is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ *  License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with selector.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+using namespace std;
+
+#include "mtp_tracker.h"
+#include "mtp_greedy.h"
+#include "mtp_server.h"
+
+#define FILENAME_SIZE 1024
+
+struct Global {
+  char trajectory_filename[FILENAME_SIZE];
+  char graph_filename[FILENAME_SIZE];
+  char stats_filename[FILENAME_SIZE];
+  int perf_counters;
+  int prune_unreachable;
+  int gating;
+  scalar_t gating_threshold;
+  int gating_radius;
+  int grid_width;
+  int coarse_cell_size;
+  int coarse_pooling;
+  int corridor_radius;
+  int temporal_factor;
+  int reference;
+  int max_nb_trajectories;
+  scalar_t min_trajectory_gain;
+  int exact_nb_trajectories;
+  int incremental;
+  int bidirectional;
+  double time_budget;
+  int quantization;
+  int vertex_order;
+  int nb_build_threads;
+  char storage_directory[FILENAME_SIZE];
+  int storage_pages;
+  int numa_node;
+  char checkpoint_filename[FILENAME_SIZE];
+  double checkpoint_period;
+  char resume_filename[FILENAME_SIZE];
+  char seed_filename[FILENAME_SIZE];
+  char sweep_filename[FILENAME_SIZE];
+  char replay_filename[FILENAME_SIZE];
+  int nb_sweep_threads;
+  int plan;
+  int greedy;
+  double memory_budget;
+  char serve_socket[FILENAME_SIZE];
+  char connect_socket[FILENAME_SIZE];
+  int nb_workers;
+  int cache_size;
+  int verbose;
+} global;
+
+void usage(ostream *os) {
+  (*os) << "mtp [-h|--help] [--help-formats] [-v|--verbose] [-t|--trajectory-file <trajectory filename>] [-g|--graph-file <graph filename>] [--stats <stats filename>] [--perf-counters] [--prune] [--gating <score threshold>] [--gating-radius <radius>] [--grid-width <width>] [--coarse-to-fine <cell size>] [--pooling max|lse] [--corridor-radius <cells>] [--temporal-factor <k>] [--reference] [--max-trajectories <K>] [--exact-trajectories <K>] [--min-gain <score>] [--incremental] [--bidirectional] [--time-budget <seconds>] [--quantize int8|fp16] [--vertex-order location|hilbert|morton] [--build-threads <n>] [--storage <directory>] [--pages default|transparent|hugetlb] [--numa-node <node>] [--checkpoint <checkpoint filename> [--checkpoint-period <seconds>]] [--resume <checkpoint filename>] [--seed <trajectory filename>] [--sweep <transform filename> [--sweep-threads <n>]] [--capture <replay filename>] [--plan] [--memory-budget <MB>] [--engine ksp|greedy] [--serve <socket> [--workers <n>] [--cache-size <n>]] [--connect <socket>] [<tracking parameter file>]" << endl;
+  (*os) << endl;
+  (*os) << "The mtp command processes a file containing the description of a topology" << endl;
+  (*os) << "and detection scores, and prints the optimal set of trajectories." << endl;
+  (*os) << endl;
+  (*os) << "If no filename is provided, it reads the parameters from the standard" << endl;
+  (*os) << "input. If no trajectory filename is provided, it writes the result to" << endl;
+  (*os) << "the standard output. With --stats, it writes the solver statistics in" << endl;
+  (*os) << "JSON to the given file. With --perf-counters, it samples the hardware" << endl;
+  (*os) << "performance counters around every solver phase, prints them on the" << endl;
+  (*os) << "standard error, and adds them to the statistics." << endl;
+  (*os) << endl;
+  (*os) << "With --prune, the locations which are not on a path from an entrance to" << endl;
+  (*os) << "an exit are removed from the graph, which does not change the result." << endl;
+  (*os) << "With --gating, only the locations less than the gating radius (default 2)" << endl;
+  (*os) << "motions and time steps away from a detection score above the threshold" << endl;
+  (*os) << "are kept, and no corridor between them, so that a target missed for" << endl;
+  (*os) << "more than twice the radius in frames gets its trajectory cut in two." << endl;
+  (*os) << endl;
+  (*os) << "With --coarse-to-fine, the locations have to be a grid of the given" << endl;
+  (*os) << "width, numbered row by row. The tracking is first done on a grid of" << endl;
+  (*os) << "cells of the given size, with the max (default) or the log-sum-exp of" << endl;
+  (*os) << "their scores offset by their mean, and then at full resolution in a" << endl;
+  (*os) << "corridor of --corridor-radius cells (default 0) around the coarse" << endl;
+  (*os) << "trajectories, widened where the fine ones reach its border." << endl;
+  (*os) << endl;
+  (*os) << "With --temporal-factor k, the tracking is first done on one frame out of" << endl;
+  (*os) << "k, and then at full frame rate in tubes around the coarse trajectories." << endl;
+  (*os) << "With --reference, the problem is solved again without any pruning, and" << endl;
+  (*os) << "the speedup and the score loss are printed on the standard error." << endl;
+  (*os) << endl;
+  (*os) << "With --max-trajectories K, the result is the best set of at most K" << endl;
+  (*os) << "trajectories, and with --exact-trajectories K, of exactly K, whatever" << endl;
+  (*os) << "their scores. With --min-gain, trajectories which would increase the" << endl;
+  (*os) << "total score by less than the given value are not added." << endl;
+  (*os) << endl;
+  (*os) << "With --incremental, after every trajectory, the shortest paths are" << endl;
+  (*os) << "recomputed only downstream of it instead of everywhere." << endl;
+  (*os) << "With --bidirectional, they are computed from both ends of the time" << endl;
+  (*os) << "axis until the two searches meet." << endl;
+  (*os) << endl;
+  (*os) << "With --time-budget, the tracking stops after the given number of seconds" << endl;
+  (*os) << "and the best trajectories found so far are written." << endl;
+  (*os) << endl;
+  (*os) << "With --checkpoint, the state of the tracking is written to the given file" << endl;
+  (*os) << "every --checkpoint-period seconds, and when mtp receives SIGUSR1, after" << endl;
+  (*os) << "the current shortest path. With --resume, the tracking starts from such" << endl;
+  (*os) << "a file, with the same parameter file and options, and ends with the same" << endl;
+  (*os) << "trajectories as without interruption." << endl;
+  (*os) << endl;
+  (*os) << "With --seed, the tracking starts from the trajectories of the given file," << endl;
+  (*os) << "in the format of --trajectory-file, for instance the ones of a previous" << endl;
+  (*os) << "tracking with slightly different scores, or of --engine greedy. It ends" << endl;
+  (*os) << "with the same total score as without them, and faster if they are close" << endl;
+  (*os) << "to the result." << endl;
+  (*os) << endl;
+  (*os) << "With --sweep, the file gives one transform of the scores per line, as" << endl;
+  (*os) << "\"offset scale clamp\", and mtp tracks once per transform on one graph," << endl;
+  (*os) << "each tracking starting from the trajectories of the previous line, with" << endl;
+  (*os) << "--sweep-threads blocks of lines done concurrently. It writes one line per" << endl;
+  (*os) << "transform, \"offset scale clamp total_score nb_trajectories" << endl;
+  (*os) << "nb_initial_trajectories seconds\", instead of the trajectories." << endl;
+  (*os) << endl;
+  (*os) << "With --capture, every tracking appends a replay record of its sequence," << endl;
+  (*os) << "options and result to the given file, also with --serve, which" << endl;
+  (*os) << "mtp_replay runs again to compare the scores and durations." << endl;
+  (*os) << endl;
+  (*os) << "With --quantize, the detection scores are stored on 8 or 16 bits, and" << endl;
+  (*os) << "the bound on the resulting error on the total score is reported in the" << endl;
+  (*os) << "statistics." << endl;
+  (*os) << endl;
+  (*os) << "With --vertex-order hilbert or morton, the vertices of every time step" << endl;
+  (*os) << "are numbered along a curve over the grid given by --grid-width, which" << endl;
+  (*os) << "keeps neighbouring locations close in memory." << endl;
+  (*os) << endl;
+  (*os) << "With --build-threads, the graph is built with the given number of" << endl;
+  (*os) << "threads (default one per core)." << endl;
+  (*os) << endl;
+  (*os) << "With --storage, the graph is kept in a temporary file in the given" << endl;
+  (*os) << "directory instead of in memory, for sequences too long for the RAM." << endl;
+  (*os) << "Otherwise, with --pages transparent or hugetlb, it is in transparent or" << endl;
+  (*os) << "explicit 2MB huge pages, and with --numa-node, on the given NUMA node." << endl;
+  (*os) << endl;
+  (*os) << "With --plan, mtp does not track, but prints the size of the graph, the" << endl;
+  (*os) << "memory of every data structure, and the predicted duration, and writes" << endl;
+  (*os) << "them in JSON in the --stats file if one is given. If the memory is over" << endl;
+  (*os) << "--memory-budget, in megabytes (default the size of the RAM), it lists" << endl;
+  (*os) << "options which would reduce it. The tracking checks the same budget" << endl;
+  (*os) << "before allocating, and stops if it is exceeded." << endl;
+  (*os) << endl;
+  (*os) << "With --engine greedy, the trajectories are not the optimal ones, but" << endl;
+  (*os) << "built frame by frame by linking every trajectory to the best detection" << endl;
+  (*os) << "it can reach, which takes milliseconds. It takes the same input and" << endl;
+  (*os) << "--max-trajectories, --min-gain, --quantize and --reference options." << endl;
+  (*os) << endl;
+  (*os) << "With --serve, mtp runs as a server on the given unix socket, which keeps" << endl;
+  (*os) << "the graphs of the last --cache-size topologies (default 16) it received" << endl;
+  (*os) << "and tracks with --workers threads (default one per core), with the above" << endl;
+  (*os) << "options. With --connect, the tracking is done by such a server." << endl;
+  (*os) << endl;
+  (*os) << "For compatibility with the Windows pipeline, it also accepts" << endl;
+  (*os) << "  mtp <tracking parameter file> <trajectory filename> <graph filename> <verbose>" << endl;
+  (*os) << endl;
+  (*os) << "Written by Francois Fleuret. (C) Idiap Research Institute, 2012." << endl;
+}
+
+void print_help_formats() {
+  cout << "The tracking parameters the command takes as input have the following" << endl;
+  cout << "format, where L is the number of locations and T is the number of time" << endl;
+  cout << "steps:" << endl;
+  cout << endl;
+  cout << "---------------------------- snip snip -------------------------------" << endl;
+  cout << "  int:L int:T" << endl;
+  cout << endl;
+  cout << "  bool:allowed_motion_from_1_to_1 ... bool:allowed_motion_from_1_to_L" << endl;
+  cout << "  ..." << endl;
+  cout << "  bool:allowed_motion_from_L_to_1 ... bool:allowed_motion_from_L_to_L" << endl;
+  cout << endl;
+  cout << "  bool:entrance_1_1 ... bool:entrance_1_L" << endl;
+  cout << "  ..." << endl;
+  cout << "  bool:entrance_T_1 ... bool:entrance_T_L" << endl;
+  cout << endl;
+  cout << "  bool:exit_1_1 ... bool:exit_1_L" << endl;
+  cout << "  ..." << endl;
+  cout << "  bool:exit_T_1 ... bool:exit_T_L" << endl;
+  cout << endl;
+  cout << "  float:detection_score_1_1 ... float:detection_score_1_L" << endl;
+  cout << "  ..." << endl;
+  cout << "  float:detection_score_T_1 ... float:detection_score_T_L" << endl;
+  cout << "---------------------------- snip snip -------------------------------" << endl;
+  cout << endl;
+  cout << "As results, the command writes first the number of trajectories," << endl;
+  cout << "followed by one line per trajectory with the following structure:" << endl;
+  cout << endl;
+  cout << "---------------------------- snip snip -------------------------------" << endl;
+  cout << "  int:traj_number int:entrance_time int:duration float:score int:location_1 ... int:location_duration" << endl;
+  cout << "---------------------------- snip snip -------------------------------" << endl;
+}
+
+void set_tracker_options(MTPTracker *tracker) {
+  tracker->prune_unreachable_vertices = global.prune_unreachable;
+  tracker->gating = global.gating;
+  tracker->gating_threshold = global.gating_threshold;
+  tracker->gating_radius = global.gating_radius;
+  tracker->grid_width = global.grid_width;
+  tracker->coarse_cell_size = global.coarse_cell_size;
+  tracker->coarse_pooling = global.coarse_pooling;
+  tracker->corridor_radius = global.corridor_radius;
+  tracker->temporal_factor = global.temporal_factor;
+  tracker->max_nb_trajectories = global.max_nb_trajectories;
+  tracker->min_trajectory_gain = global.min_trajectory_gain;
+  tracker->exact_nb_trajectories = global.exact_nb_trajectories;
+  tracker->incremental_shortest_paths = global.incremental;
+  tracker->bidirectional_shortest_paths = global.bidirectional;
+  tracker->vertex_order = global.vertex_order;
+  tracker->nb_build_threads = global.nb_build_threads;
+  if(global.storage_directory[0]) tracker->storage_directory = global.storage_directory;
+  tracker->storage_pages = global.storage_pages;
+  tracker->storage_numa_node = global.numa_node;
+  if(global.memory_budget >= 0) tracker->memory_budget = size_t(global.memory_budget * 1048576.0);
+  if(global.replay_filename[0]) tracker->replay_file = global.replay_filename;
+}
+
+// The tracker aborts if the grid does not fit the locations read
+void check_grid(MTPTracker *tracker) {
+  if((global.coarse_cell_size > 1 || global.vertex_order != MTPTracker::ORDER_LOCATION) &&
+     tracker->nb_locations % global.grid_width != 0) {
+    cerr << "The number of locations " << tracker->nb_locations
+         << " is not a multiple of --grid-width " << global.grid_width << "." << endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+void do_plan(istream *in_tracker) {
+  MTPTracker *tracker = new MTPTracker();
+  MTPPlan plan;
+
+  set_tracker_options(tracker);
+  size_t memory_budget = tracker->memory_budget;
+
+  // The point is to know whether it fits, so the reading should not
+  // stop on it
+  tracker->memory_budget = 0;
+  tracker->read(in_tracker);
+
+  check_grid(tracker);
+  tracker->memory_budget = memory_budget;
+
+  if(global.quantization != MTPTracker::QUANTIZATION_NONE) {
+    tracker->quantize_detection_scores(global.quantization);
+  }
+
+  if(global.verbose) { cout << "Calibrating the cost model ... "; cout.flush(); }
+  plan.calibrate();
+  if(global.verbose) { cout << "done." << endl; }
+
+  tracker->plan(&plan);
+  plan.print(&cout);
+
+  if(global.stats_filename[0]) {
+    ofstream out_stats(global.stats_filename);
+    plan.write_json(&out_stats);
+    if(global.verbose) { cout << "Wrote " << global.stats_filename << "." << endl; }
+  }
+
+  delete tracker;
+}
+
+void do_serve() {
+  MTPServer *server = new MTPServer();
+  set_tracker_options(&server->options);
+  server->time_budget = global.time_budget;
+  server->nb_workers = global.nb_workers;
+  server->cache_size = global.cache_size;
+  server->verbose = global.verbose;
+  server->serve(global.serve_socket);
+  delete server;
+  exit(EXIT_FAILURE);
+}
+
+void do_remote_tracking(istream *in_tracker) {
+  MTPTracker *tracker = new MTPTracker();
+  MTPClient *client = new MTPClient();
+  uint64_t key;
+  int status = MTP_STATUS_UNKNOWN_TOPOLOGY, interrupted = 0;
+  stringstream trajectories;
+
+  tracker->read(in_tracker);
+
+  if(client->connect(global.connect_socket) < 0) {
+    cerr << "Can not connect to " << global.connect_socket << "." << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  // The topology may be evicted by the server between the two
+  // messages, in which case we send it again
+  for(int k = 0; k < 2 && status == MTP_STATUS_UNKNOWN_TOPOLOGY; k++) {
+    if(client->send_topology(tracker, &key) < 0 ||
+       client->solve(key, tracker, global.time_budget, &trajectories, &status, &interrupted) < 0) {
+      cerr << "Communication with the server failed." << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if(status != MTP_STATUS_OK) {
+    cerr << "The server could not track." << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if(interrupted) {
+    cerr << "The time budget is exhausted." << endl;
+  }
+
+  if(global.trajectory_filename[0]) {
+    ofstream out_traj(global.trajectory_filename);
+    out_traj << trajectories.str();
+    if(global.verbose) { cout << "Wrote " << global.trajectory_filename << "." << endl; }
+  } else {
+    cout << trajectories.str();
+  }
+
+  delete client;
+  delete tracker;
+}
+
+void do_sweep(istream *in_tracker) {
+  MTPTracker *tracker = new MTPTracker();
+  int nb_transforms = 0, size = 16;
+  ScoreTransform *transforms = new ScoreTransform[size];
+
+  ifstream in_sweep(global.sweep_filename);
+  if(!in_sweep.good()) {
+    cerr << "Can not open " << global.sweep_filename << endl;
+    exit(EXIT_FAILURE);
+  }
+  ScoreTransform transform;
+  while(in_sweep >> transform.offset >> transform.scale >> transform.clamp) {
+    if(nb_transforms == size) {
+      size = 2 * size;
+      ScoreTransform *tmp = new ScoreTransform[size];
+      for(int k = 0; k < nb_transforms; k++) tmp[k] = transforms[k];
+      delete[] transforms;
+      transforms = tmp;
+    }
+    transforms[nb_transforms++] = transform;
+  }
+  if(!in_sweep.eof()) {
+    cerr << "Invalid transform in " << global.sweep_filename << "." << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  set_tracker_options(tracker);
+
+  if(global.verbose) { cout << "Reading the tracking parameters." << endl; }
+  tracker->read(in_tracker);
+  check_grid(tracker);
+
+  if(global.quantization != MTPTracker::QUANTIZATION_NONE) {
+    tracker->quantize_detection_scores(global.quantization);
+  }
+
+  // check_memory has said why
+  if(tracker->build_graph() < 0) exit(EXIT_FAILURE);
+
+  SweepResult *results = new SweepResult[nb_transforms];
+  double start_time = now_in_seconds();
+  if(tracker->sweep(nb_transforms, transforms, results, global.nb_sweep_threads) < 0) {
+    exit(EXIT_FAILURE);
+  }
+  if(global.verbose) {
+    cout << "Swept " << nb_transforms << " transforms in "
+         << now_in_seconds() - start_time << "s." << endl;
+  }
+
+  stringstream table;
+  for(int k = 0; k < nb_transforms; k++) {
+    table << transforms[k].offset
+          << " " << transforms[k].scale
+          << " " << transforms[k].clamp
+          << " " << results[k].total_score
+          << " " << results[k].nb_trajectories
+          << " " << results[k].nb_initial_trajectories
+          << " " << results[k].duration
+          << endl;
+  }
+
+  if(global.trajectory_filename[0]) {
+    ofstream out_table(global.trajectory_filename);
+    out_table << table.str();
+    if(global.verbose) { cout << "Wrote " << global.trajectory_filename << "." << endl; }
+  } else {
+    cout << table.str();
+  }
+
+  delete[] results;
+  delete[] transforms;
+  delete tracker;
+}
+
+void do_greedy_tracking(istream *in_tracker) {
+  MTPTracker *tracker = new MTPTracker();
+  MTPGreedy *greedy = new MTPGreedy();
+
+  set_tracker_options(tracker);
+
+  if(global.verbose) { cout << "Reading the tracking parameters." << endl; }
+  tracker->read(in_tracker);
+
+  stringstream description;
+  if(global.reference) tracker->write(&description);
+
+  if(global.quantization != MTPTracker::QUANTIZATION_NONE) {
+    tracker->quantize_detection_scores(global.quantization);
+  }
+
+  double start_time = now_in_seconds();
+  greedy->track(tracker);
+  double duration = now_in_seconds() - start_time;
+  if(global.verbose) { cout << "Tracked greedily in " << duration << "s." << endl; }
+
+  if(global.reference) {
+    MTPTracker *reference = new MTPTracker();
+    reference->read(&description);
+    double reference_start_time = now_in_seconds();
+    reference->build_graph();
+    reference->track();
+    double reference_duration = now_in_seconds() - reference_start_time;
+    cerr << "Speedup " << reference_duration / duration
+         << " (" << duration << "s instead of " << reference_duration << "s),"
+         << " score " << greedy->total_score() << " instead of " << reference->total_score()
+         << "." << endl;
+    delete reference;
+  }
+
+  if(global.trajectory_filename[0]) {
+    ofstream out_traj(global.trajectory_filename);
+    greedy->write_trajectories(&out_traj);
+    if(global.verbose) { cout << "Wrote " << global.trajectory_filename << "." << endl; }
+  } else {
+    greedy->write_trajectories(&cout);
+  }
+
+  delete greedy;
+  delete tracker;
+}
+
+// Set by SIGUSR1, and reset by the tracker once the checkpoint is
+// written
+atomic<bool> checkpoint_requested(false);
+
+void request_checkpoint(int) {
+  checkpoint_requested = true;
+}
+
+void do_tracking(istream *in_tracker) {
+  double start_time = 0;
+  MTPTracker *tracker = new MTPTracker();
+
+  if(global.stats_filename[0] || global.perf_counters || global.replay_filename[0]) {
+    tracker->enable_stats(1);
+  }
+
+  if(global.perf_counters) {
+    if(tracker->stats()->enable_perf_counters(1) < NB_COUNTERS) {
+      cerr << "Some hardware performance counters are not available:";
+      for(int c = 0; c < NB_COUNTERS; c++) {
+        if(!tracker->stats()->counters_available[c]) cerr << " " << PerfCounters::counter_name(c);
+      }
+      cerr << "." << endl;
+    }
+  }
+
+  set_tracker_options(tracker);
+
+  // Only this tracker, not the reference one
+  if(global.checkpoint_filename[0]) {
+    tracker->checkpoint_file = global.checkpoint_filename;
+    tracker->checkpoint_period = global.checkpoint_period;
+    tracker->checkpoint_request = &checkpoint_requested;
+#ifdef SIGUSR1
+    signal(SIGUSR1, request_checkpoint);
+#endif
+  }
+  if(global.resume_filename[0]) tracker->resume_file = global.resume_filename;
+
+  if(global.verbose) { cout << "Reading the tracking parameters." << endl; }
+  tracker->read(in_tracker);
+  check_grid(tracker);
+
+  if(global.seed_filename[0]) {
+    ifstream seed_in(global.seed_filename);
+    if(!seed_in.good()) {
+      cerr << "Can not open " << global.seed_filename << endl;
+      exit(EXIT_FAILURE);
+    }
+    if(tracker->read_initial_trajectories(&seed_in) < 0) {
+      cerr << "The trajectories of " << global.seed_filename
+           << " do not fit the tracking parameters." << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // The reference uses the exact scores
+  stringstream description;
+  if(global.reference) tracker->write(&description);
+
+  if(global.quantization != MTPTracker::QUANTIZATION_NONE) {
+    tracker->quantize_detection_scores(global.quantization);
+    if(global.verbose) {
+      cout << "Quantized the scores with a max error of "
+           << tracker->quantization_max_error() << "." << endl;
+    }
+  }
+
+  double tracking_start_time = now_in_seconds();
+
+  if(global.verbose) {
+    cout << "Building the graph ... "; cout.flush();
+    start_time = now_in_seconds();
+  }
+  // check_memory has said why
+  if(tracker->build_graph() < 0) exit(EXIT_FAILURE);
+  if(global.verbose) {
+    cout << "done (" << now_in_seconds() - start_time << "s)." << endl;
+    if(global.prune_unreachable || global.gating) {
+      cout << "Pruned " << tracker->pruning_ratio() * 100 << "% of the locations." << endl;
+    }
+  }
+
+  if(global.verbose) {
+    cout << "Tracking ... "; cout.flush();
+    start_time = now_in_seconds();
+  }
+  if(tracker->track(global.time_budget) < 0) exit(EXIT_FAILURE);
+  if(global.verbose) {
+    cout << "done (" << now_in_seconds() - start_time << "s)." << endl;
+    if(global.coarse_cell_size > 1 || global.temporal_factor > 1) {
+      cout << "The final corridor has " << (1 - tracker->pruning_ratio()) * 100
+           << "% of the locations." << endl;
+    }
+  }
+
+  if(tracker->interrupted()) {
+    cerr << "The time budget is exhausted, keeping " << tracker->nb_trajectories()
+         << " trajectories of total score " << tracker->total_score() << "." << endl;
+  }
+
+  if(global.exact_nb_trajectories && tracker->nb_trajectories() < global.max_nb_trajectories) {
+    cerr << "Found only " << tracker->nb_trajectories() << " disjoint trajectories." << endl;
+  }
+
+  if(global.reference) {
+    double duration = now_in_seconds() - tracking_start_time;
+    scalar_t score = 0, reference_score = 0;
+    for(int k = 0; k < tracker->nb_trajectories(); k++) {
+      score += tracker->trajectory_score(k);
+    }
+
+    MTPTracker *reference = new MTPTracker();
+    reference->read(&description);
+    double reference_start_time = now_in_seconds();
+    reference->build_graph();
+    reference->track();
+    double reference_duration = now_in_seconds() - reference_start_time;
+    for(int k = 0; k < reference->nb_trajectories(); k++) {
+      reference_score += reference->trajectory_score(k);
+    }
+    delete reference;
+
+    cerr << "Speedup " << reference_duration / duration
+         << " (" << duration << "s instead of " << reference_duration << "s),"
+         << " score " << score << " instead of " << reference_score << "." << endl;
+  }
+
+  if(global.trajectory_filename[0]) {
+    ofstream out_traj(global.trajectory_filename);
+    tracker->write_trajectories(&out_traj);
+    if(global.verbose) { cout << "Wrote " << global.trajectory_filename << "." << endl; }
+  } else {
+    tracker->write_trajectories(&cout);
+  }
+
+  if(global.graph_filename[0]) {
+    ofstream out_dot(global.graph_filename);
+    tracker->print_graph_dot(&out_dot);
+    if(global.verbose) { cout << "Wrote " << global.graph_filename << "." << endl; }
+  }
+
+  if(global.stats_filename[0]) {
+    ofstream out_stats(global.stats_filename);
+    tracker->stats()->write_json(&out_stats);
+    if(global.verbose) {
+      tracker->stats()->print(&cout);
+      cout << "Wrote " << global.stats_filename << "." << endl;
+    }
+  }
+
+  if(global.perf_counters) {
+    tracker->stats()->print(&cerr);
+  }
+
+  delete tracker;
+}
+
+int main(int argc, char *argv[]) {
+  int error = 0, show_help = 0;
+  int nb_arguments = 0;
+  char *arguments[4];
+
+  strncpy(global.trajectory_filename, "", FILENAME_SIZE);
+  strncpy(global.graph_filename, "", FILENAME_SIZE);
+  strncpy(global.stats_filename, "", FILENAME_SIZE);
+  global.perf_counters = 0;
+  global.prune_unreachable = 0;
+  global.gating = 0;
+  global.gating_threshold = 0;
+  global.gating_radius = 2;
+  global.grid_width = 0;
+  global.coarse_cell_size = 0;
+  global.coarse_pooling = MTPTracker::POOLING_MAX;
+  global.corridor_radius = 0;
+  global.temporal_factor = 0;
+  global.reference = 0;
+  global.max_nb_trajectories = 0;
+  global.min_trajectory_gain = 0;
+  global.exact_nb_trajectories = 0;
+  global.incremental = 0;
+  global.bidirectional = 0;
+  global.time_budget = 0;
+  global.quantization = MTPTracker::QUANTIZATION_NONE;
+  global.vertex_order = MTPTracker::ORDER_LOCATION;
+  global.nb_build_threads = 0;
+  strncpy(global.storage_directory, "", FILENAME_SIZE);
+  global.storage_pages = STORAGE_PAGES_DEFAULT;
+  global.numa_node = -1;
+  strncpy(global.checkpoint_filename, "", FILENAME_SIZE);
+  global.checkpoint_period = 0;
+  strncpy(global.resume_filename, "", FILENAME_SIZE);
+  strncpy(global.seed_filename, "", FILENAME_SIZE);
+  strncpy(global.sweep_filename, "", FILENAME_SIZE);
+  strncpy(global.replay_filename, "", FILENAME_SIZE);
+  global.nb_sweep_threads = 0;
+  global.plan = 0;
+  global.greedy = 0;
+  // Negative to keep the default of the tracker
+  global.memory_budget = -1;
+  strncpy(global.serve_socket, "", FILENAME_SIZE);
+  strncpy(global.connect_socket, "", FILENAME_SIZE);
+  global.nb_workers = 0;
+  global.cache_size = 16;
+  global.verbose = 0;
+
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--trajectory-file") == 0) {
+      if(++i < argc) strncpy(global.trajectory_filename, argv[i], FILENAME_SIZE - 1);
+      else error = 1;
+    } else if(strcmp(argv[i], "-g") == 0 || strcmp(argv[i], "--graph-file") == 0) {
+      if(++i < argc) strncpy(global.graph_filename, argv[i], FILENAME_SIZE - 1);
+      else error = 1;
+    } else if(strcmp(argv[i], "--stats") == 0) {
+      if(++i < argc) strncpy(global.stats_filename, argv[i], FILENAME_SIZE - 1);
+      else error = 1;
+    } else if(strcmp(argv[i], "--perf-counters") == 0) {
+      global.perf_counters = 1;
+    } else if(strcmp(argv[i], "--prune") == 0) {
+      global.prune_unreachable = 1;
+    } else if(strcmp(argv[i], "--gating") == 0) {
+      global.gating = 1;
+      if(++i < argc) global.gating_threshold = scalar_t(atof(argv[i]));
+      else error = 1;
+    } else if(strcmp(argv[i], "--gating-radius") == 0) {
+      if(++i < argc) global.gating_radius = atoi(argv[i]);
+      if(i >= argc || global.gating_radius < 0) error = 1;
+    } else if(strcmp(argv[i], "--grid-width") == 0) {
+      if(++i < argc) global.grid_width = atoi(argv[i]);
+      else error = 1;
+    } else if(strcmp(argv[i], "--coarse-to-fine") == 0) {
+      if(++i < argc) global.coarse_cell_size = atoi(argv[i]);
+      else error = 1;
+    } else if(strcmp(argv[i], "--pooling") == 0) {
+      if(++i < argc && strcmp(argv[i], "max") == 0) global.coarse_pooling = MTPTracker::POOLING_MAX;
+      else if(i < argc && strcmp(argv[i], "lse") == 0) global.coarse_pooling = MTPTracker::POOLING_LOG_SUM_EXP;
+      else error = 1;
+    } else if(strcmp(argv[i], "--corridor-radius") == 0) {
+      if(++i < argc) global.corridor_radius = atoi(argv[i]);
+      if(i >= argc || global.corridor_radius < 0) error = 1;
+    } else if(strcmp(argv[i], "--temporal-factor") == 0) {
+      if(++i < argc) global.temporal_factor = atoi(argv[i]);
+      else error = 1;
+    } else if(strcmp(argv[i], "--reference") == 0) {
+      global.reference = 1;
+    } else if(strcmp(argv[i], "--max-trajectories") == 0) {
+      if(++i < argc) global.max_nb_trajectories = atoi(argv[i]);
+      else error = 1;
+    } else if(strcmp(argv[i], "--exact-trajectories") == 0) {
+      global.exact_nb_trajectories = 1;
+      if(++i < argc) global.max_nb_trajectories = atoi(argv[i]);
+      else error = 1;
+    } else if(strcmp(argv[i], "--min-gain") == 0) {
+      if(++i < argc) global.min_trajectory_gain = scalar_t(atof(argv[i]));
+      else error = 1;
+    } else if(strcmp(argv[i], "--incremental") == 0) {
+      global.incremental = 1;
+    } else if(strcmp(argv[i], "--bidirectional") == 0) {
+      global.bidirectional = 1;
+    } else if(strcmp(argv[i], "--time-budget") == 0) {
+      if(++i < argc) global.time_budget = atof(argv[i]);
+      else error = 1;
+    } else if(strcmp(argv[i], "--quantize") == 0) {
+      if(++i < argc && strcmp(argv[i], "int8") == 0) global.quantization = MTPTracker::QUANTIZATION_INT8;
+      else if(i < argc && strcmp(argv[i], "fp16") == 0) global.quantization = MTPTracker::QUANTIZATION_FP16;
+      else error = 1;
+    } else if(strcmp(argv[i], "--vertex-order") == 0) {
+      if(++i < argc && strcmp(argv[i], "location") == 0) global.vertex_order = MTPTracker::ORDER_LOCATION;
+      else if(i < argc && strcmp(argv[i], "hilbert") == 0) global.vertex_order = MTPTracker::ORDER_HILBERT;
+      else if(i < argc && strcmp(argv[i], "morton") == 0) global.vertex_order = MTPTracker::ORDER_MORTON;
+      else error = 1;
+    } else if(strcmp(argv[i], "--build-threads") == 0) {
+      if(++i < argc) global.nb_build_threads = atoi(argv[i]);
+      else error = 1;
+    } else if(strcmp(argv[i], "--storage") == 0) {
+      if(++i < argc) strncpy(global.storage_directory, argv[i], FILENAME_SIZE - 1);
+      else error = 1;
+    } else if(strcmp(argv[i], "--pages") == 0) {
+      if(++i < argc && strcmp(argv[i], "default") == 0) global.storage_pages = STORAGE_PAGES_DEFAULT;
+      else if(i < argc && strcmp(argv[i], "transparent") == 0) global.storage_pages = STORAGE_PAGES_TRANSPARENT;
+      else if(i < argc && strcmp(argv[i], "hugetlb") == 0) global.storage_pages = STORAGE_PAGES_HUGETLB;
+      else error = 1;
+    } else if(strcmp(argv[i], "--numa-node") == 0) {
+      if(++i < argc) global.numa_node = atoi(argv[i]);
+      else error = 1;
+    } else if(strcmp(argv[i], "--checkpoint") == 0) {
+      if(++i < argc) strncpy(global.checkpoint_filename, argv[i], FILENAME_SIZE - 1);
+      else error = 1;
+    } else if(strcmp(argv[i], "--checkpoint-period") == 0) {
+      if(++i < argc) global.checkpoint_period = atof(argv[i]);
+      else error = 1;
+    } else if(strcmp(argv[i], "--resume") == 0) {
+      if(++i < argc) strncpy(global.resume_filename, argv[i], FILENAME_SIZE - 1);
+      else error = 1;
+    } else if(strcmp(argv[i], "--seed") == 0) {
+      if(++i < argc) strncpy(global.seed_filename, argv[i], FILENAME_SIZE - 1);
+      else error = 1;
+    } else if(strcmp(argv[i], "--sweep") == 0) {
+      if(++i < argc) strncpy(global.sweep_filename, argv[i], FILENAME_SIZE - 1);
+      else error = 1;
+    } else if(strcmp(argv[i], "--capture") == 0) {
+      if(++i < argc) strncpy(global.replay_filename, argv[i], FILENAME_SIZE - 1);
+      else error = 1;
+    } else if(strcmp(argv[i], "--sweep-threads") == 0) {
+      if(++i < argc) global.nb_sweep_threads = atoi(argv[i]);
+      else error = 1;
+    } else if(strcmp(argv[i], "--engine") == 0) {
+      if(++i < argc && strcmp(argv[i], "ksp") == 0) global.greedy = 0;
+      else if(i < argc && strcmp(argv[i], "greedy") == 0) global.greedy = 1;
+      else error = 1;
+    } else if(strcmp(argv[i], "--plan") == 0) {
+      global.plan = 1;
+    } else if(strcmp(argv[i], "--memory-budget") == 0) {
+      if(++i < argc) global.memory_budget = atof(argv[i]);
+      else error = 1;
+    } else if(strcmp(argv[i], "--serve") == 0) {
+      if(++i < argc) strncpy(global.serve_socket, argv[i], FILENAME_SIZE - 1);
+      else error = 1;
+    } else if(strcmp(argv[i], "--connect") == 0) {
+      if(++i < argc) strncpy(global.connect_socket, argv[i], FILENAME_SIZE - 1);
+      else error = 1;
+    } else if(strcmp(argv[i], "--workers") == 0) {
+      if(++i < argc) global.nb_workers = atoi(argv[i]);
+      else error = 1;
+    } else if(strcmp(argv[i], "--cache-size") == 0) {
+      if(++i < argc) global.cache_size = atoi(argv[i]);
+      else error = 1;
+    } else if(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+      show_help = 1;
+    } else if(strcmp(argv[i], "--help-formats") == 0) {
+      print_help_formats();
+      exit(EXIT_SUCCESS);
+    } else if(strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verbose") == 0) {
+      global.verbose = 1;
+    } else if(argv[i][0] == '-' && argv[i][1]) {
+      error = 1;
+    } else if(nb_arguments < 4) {
+      arguments[nb_arguments++] = argv[i];
+    } else {
+      error = 1;
+    }
+  }
+
+  if(nb_arguments == 4) {
+    // The legacy form used by python/main.py
+    strncpy(global.trajectory_filename, arguments[1], FILENAME_SIZE - 1);
+    strncpy(global.graph_filename, arguments[2], FILENAME_SIZE - 1);
+    global.verbose = atoi(arguments[3]);
+    nb_arguments = 1;
+  } else if(nb_arguments > 1) {
+    error = 1;
+  }
+
+  if(global.coarse_cell_size > 1 && global.grid_width <= 0) {
+    cerr << "--coarse-to-fine requires --grid-width." << endl;
+    error = 1;
+  }
+
+  if(global.vertex_order != MTPTracker::ORDER_LOCATION && global.grid_width <= 0) {
+    cerr << "--vertex-order hilbert and morton require --grid-width." << endl;
+    error = 1;
+  }
+
+  if(global.exact_nb_trajectories && global.max_nb_trajectories < 1) {
+    cerr << "--exact-trajectories requires a number of trajectories of at least 1." << endl;
+    error = 1;
+  }
+
+  if(global.coarse_cell_size > 1 && global.temporal_factor > 1) {
+    cerr << "--coarse-to-fine and --temporal-factor can not be combined." << endl;
+    error = 1;
+  }
+
+  if(global.numa_node >= storage_nb_numa_nodes()) {
+    cerr << "There are only " << storage_nb_numa_nodes() << " NUMA nodes." << endl;
+    error = 1;
+  }
+
+  if((global.checkpoint_filename[0] || global.resume_filename[0]) &&
+     (global.coarse_cell_size > 1 || global.temporal_factor > 1 ||
+      global.greedy || global.serve_socket[0] || global.connect_socket[0])) {
+    cerr << "--checkpoint and --resume are only for the direct tracking." << endl;
+    error = 1;
+  }
+
+  if(global.seed_filename[0] &&
+     (global.coarse_cell_size > 1 || global.temporal_factor > 1 ||
+      global.greedy || global.serve_socket[0] || global.connect_socket[0])) {
+    cerr << "--seed is only for the direct tracking." << endl;
+    error = 1;
+  }
+
+  if(global.sweep_filename[0] &&
+     (global.coarse_cell_size > 1 || global.temporal_factor > 1 || global.plan ||
+      global.greedy || global.serve_socket[0] || global.connect_socket[0] ||
+      global.seed_filename[0] || global.checkpoint_filename[0] || global.resume_filename[0])) {
+    cerr << "--sweep is only for the direct tracking, without seed or checkpoint." << endl;
+    error = 1;
+  }
+
+  if(error) {
+    usage(&cerr);
+    exit(EXIT_FAILURE);
+  }
+
+  if(show_help) {
+    usage(&cout);
+    exit(EXIT_SUCCESS);
+  }
+
+  if(global.serve_socket[0]) {
+    do_serve();
+  }
+
+  if(nb_arguments == 1) {
+    ifstream *file_in_tracker = new ifstream(arguments[0]);
+    if(file_in_tracker->good()) {
+      if(global.plan) do_plan(file_in_tracker);
+      else if(global.sweep_filename[0]) do_sweep(file_in_tracker);
+      else if(global.greedy) do_greedy_tracking(file_in_tracker);
+      else if(global.connect_socket[0]) do_remote_tracking(file_in_tracker);
+      else do_tracking(file_in_tracker);
+    } else {
+      cerr << "Can not open " << arguments[0] << endl;
+      exit(EXIT_FAILURE);
+    }
+    delete file_in_tracker;
+  } else if(global.plan) {
+    do_plan(&cin);
+  } else if(global.sweep_filename[0]) {
+    do_sweep(&cin);
+  } else if(global.greedy) {
+    do_greedy_tracking(&cin);
+  } else if(global.connect_socket[0]) {
+    do_remote_tracking(&cin);
+  } else {
+    do_tracking(&cin);
+  }
+
+  exit(EXIT_SUCCESS);
+}
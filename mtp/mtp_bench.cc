@@ -0,0 +1,943 @@
+/*
+ *  mtp is the ``Multi Tracked Paths'', an implementation of the
+ *  k-shortest paths algorithm for multi-target tracking.
+ *
+ *  Copyright (c) 2012 Idiap Research Institute, http://www.idiap.ch/
+ *  Written by Francois Fleuret <francois.fleuret@idiap.ch>
+ *
+ *  This file is part of mtp.
+ *
+ *  mtp is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  mtp is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ *  License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with selector.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <cmath>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+#include "mtp_tracker.h"
+#include "mtp_greedy.h"
+
+//////////////////////////////////////////////////////////////////////
+
+// A xorshift64* generator. We do not use rand() so that a scenario
+// with a given seed is the same across platforms and threads.
+
+class Random {
+  unsigned long long _state;
+public:
+  Random(unsigned long long seed) {
+    _state = seed * 2685821657736338717ULL + 1;
+  }
+
+  unsigned long long next() {
+    _state ^= _state >> 12;
+    _state ^= _state << 25;
+    _state ^= _state >> 27;
+    return _state * 2685821657736338717ULL;
+  }
+
+  // Uniform in [0, 1)
+  double uniform() {
+    return double(next() >> 11) / 9007199254740992.0;
+  }
+
+  // Uniform in {0, ..., n-1}
+  int integer(int n) {
+    return int(uniform() * n);
+  }
+};
+
+scalar_t noisy_score(Random *random,
+                     scalar_t true_score, scalar_t erroneous_score,
+                     scalar_t score_noise, scalar_t flip_noise) {
+  scalar_t noise = score_noise * scalar_t(2.0 * random->uniform() - 1.0);
+  if(random->uniform() < flip_noise) {
+    return erroneous_score + noise;
+  } else {
+    return true_score + noise;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+// Scenario generators. They all take the requested number of
+// locations, number of time steps and density, whose meaning depends
+// on the scenario, and may round the number of locations to fit
+// their spatial structure.
+
+// The toy example of mtp_example: two targets in a 1D space, with a
+// typical tracking local minimum. The density is the score flip
+// noise.
+
+void create_light_scenario(MTPTracker *tracker, int nb_locations, int nb_time_steps,
+                           scalar_t density, Random *random) {
+  int motion_amplitude = 1;
+  scalar_t flip_noise = density, score_noise = 0.0;
+
+  if(tracker->allocate(nb_time_steps, nb_locations) < 0) exit(EXIT_FAILURE);
+
+  for(int l = 0; l < nb_locations; l++) {
+    for(int m = 0; m < nb_locations; m++) {
+      tracker->allowed_motions[l][m] = abs(l - m) <= motion_amplitude;
+    }
+  }
+
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int l = 0; l < nb_locations; l++) {
+      tracker->entrances[t][l] = (t == 0 || l == 0);
+      tracker->exits[t][l] = (t == nb_time_steps - 1 || l == nb_locations-1);
+      tracker->detection_scores[t][l] = noisy_score(random, -1.0, 1.0, score_noise, flip_noise);
+    }
+  }
+
+  int la, lb;
+  scalar_t sa, sb;
+  for(int t = 0; t < nb_time_steps; t++) {
+    if(t < nb_time_steps/2) {
+      la = t;
+      lb = nb_locations - 1 - t;
+      sa = noisy_score(random, 10.0, -1.0, score_noise, flip_noise);
+      sb = noisy_score(random,  1.0, -1.0, score_noise, flip_noise);
+    } else {
+      la = nb_time_steps - 1 - t;
+      lb = t - nb_time_steps + nb_locations;
+      sa = noisy_score(random,  1.0, -1.0, score_noise, flip_noise);
+      sb = noisy_score(random, 10.0, -1.0, score_noise, flip_noise);
+    }
+
+    if(la > nb_locations/2 - 1) la = nb_locations/2 - 1;
+    if(lb < nb_locations/2 + 1) lb = nb_locations/2 + 1;
+    if(la < 0) la = 0;
+    if(lb > nb_locations - 1) lb = nb_locations - 1;
+
+    tracker->detection_scores[t][la] = sa;
+    tracker->detection_scores[t][lb] = sb;
+  }
+}
+
+// The stress test of mtp_example: uniformly random motions,
+// entrances, exits and scores. The density is the probability of a
+// motion between two locations.
+
+void create_heavy_scenario(MTPTracker *tracker, int nb_locations, int nb_time_steps,
+                           scalar_t density, Random *random) {
+  if(tracker->allocate(nb_time_steps, nb_locations) < 0) exit(EXIT_FAILURE);
+
+  for(int l = 0; l < nb_locations; l++) {
+    for(int m = 0; m < nb_locations; m++) {
+      tracker->allowed_motions[l][m] = random->uniform() < density;
+    }
+  }
+
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int l = 0; l < nb_locations; l++) {
+      tracker->entrances[t][l] = random->uniform() < 0.01;
+      tracker->exits[t][l] = random->uniform() < 0.01;
+    }
+  }
+
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int l = 0; l < nb_locations; l++) {
+      tracker->detection_scores[t][l] = scalar_t(random->uniform()) - 0.95f;
+    }
+  }
+}
+
+// Sets the motions of a width x height grid with the 8-neighborhood
+// plus staying still, with locations numbered row by row, as done by
+// python/create_graph_input.py
+
+void set_grid_motions(MTPTracker *tracker, int width, int height) {
+  for(int l = 0; l < width * height; l++) {
+    for(int m = 0; m < width * height; m++) {
+      tracker->allowed_motions[l][m] =
+        abs(l % width - m % width) <= 1 && abs(l / width - m / width) <= 1;
+    }
+  }
+}
+
+// Moves nb_targets random walkers on a width x height grid and sets
+// the scores accordingly: detected targets have a positive score,
+// missed with probability miss_rate, and the background has a
+// negative one, with false positives with probability
+// false_positive_rate.
+
+void set_random_walk_scores(MTPTracker *tracker, int width, int height, int nb_targets,
+                            scalar_t miss_rate, scalar_t false_positive_rate,
+                            Random *random) {
+  int nb_locations = width * height;
+  if(nb_targets > nb_locations) nb_targets = nb_locations;
+  int *x = new int[nb_targets], *y = new int[nb_targets];
+  int *occupied = new int[nb_locations];
+
+  for(int l = 0; l < nb_locations; l++) occupied[l] = 0;
+
+  for(int n = 0; n < nb_targets; n++) {
+    do {
+      x[n] = random->integer(width);
+      y[n] = random->integer(height);
+    } while(occupied[x[n] + y[n] * width]);
+    occupied[x[n] + y[n] * width] = 1;
+  }
+
+  for(int t = 0; t < tracker->nb_time_steps; t++) {
+    for(int l = 0; l < nb_locations; l++) {
+      tracker->detection_scores[t][l] =
+        noisy_score(random, -1.0, 1.0, 0.25, false_positive_rate);
+    }
+
+    for(int n = 0; n < nb_targets; n++) {
+      tracker->detection_scores[t][x[n] + y[n] * width] =
+        noisy_score(random, 1.0, -1.0, 0.25, miss_rate);
+    }
+
+    // Every target tries to move to a random neighbor, and stays
+    // still if it is taken
+    for(int n = 0; n < nb_targets; n++) {
+      int nx = x[n] + random->integer(3) - 1, ny = y[n] + random->integer(3) - 1;
+      if(nx >= 0 && nx < width && ny >= 0 && ny < height &&
+         !occupied[nx + ny * width]) {
+        occupied[x[n] + y[n] * width] = 0;
+        x[n] = nx; y[n] = ny;
+        occupied[x[n] + y[n] * width] = 1;
+      }
+    }
+  }
+
+  delete[] occupied;
+  delete[] x;
+  delete[] y;
+}
+
+// Our soccer setup: a grid with the 110x88 aspect ratio of the pitch,
+// targets which can be anywhere in the first frame and leave from
+// anywhere in the last one, as in python/create_graph_input.py. The
+// density is the number of targets per location, 25/9680 for a full
+// match.
+
+void create_soccer_scenario(MTPTracker *tracker, int nb_locations, int nb_time_steps,
+                            scalar_t density, Random *random) {
+  int width = int(sqrt(scalar_t(nb_locations) * 110.0 / 88.0) + 0.5);
+  if(width < 1) width = 1;
+  int height = nb_locations / width;
+  if(height < 1) height = 1;
+
+  if(tracker->allocate(nb_time_steps, width * height) < 0) exit(EXIT_FAILURE);
+  tracker->grid_width = width;
+  set_grid_motions(tracker, width, height);
+
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int l = 0; l < width * height; l++) {
+      tracker->entrances[t][l] = (t == 0);
+      tracker->exits[t][l] = (t == nb_time_steps - 1);
+    }
+  }
+
+  int nb_targets = int(density * scalar_t(width * height) + 0.5);
+  set_random_walk_scores(tracker, width, height, nb_targets, 0.1f, 0.001f, random);
+}
+
+// Dense crowds: a small square grid with targets on a large fraction
+// of the locations, entering and leaving from the border at any time.
+// The density is the number of targets per location.
+
+void create_crowd_scenario(MTPTracker *tracker, int nb_locations, int nb_time_steps,
+                           scalar_t density, Random *random) {
+  int width = int(sqrt(scalar_t(nb_locations)) + 0.5);
+  if(width < 1) width = 1;
+  int height = nb_locations / width;
+  if(height < 1) height = 1;
+
+  if(tracker->allocate(nb_time_steps, width * height) < 0) exit(EXIT_FAILURE);
+  tracker->grid_width = width;
+  set_grid_motions(tracker, width, height);
+
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int l = 0; l < width * height; l++) {
+      int border = l % width == 0 || l % width == width - 1 ||
+        l / width == 0 || l / width == height - 1;
+      tracker->entrances[t][l] = (t == 0 || border);
+      tracker->exits[t][l] = (t == nb_time_steps - 1 || border);
+    }
+  }
+
+  int nb_targets = int(density * scalar_t(width * height) + 0.5);
+  set_random_walk_scores(tracker, width, height, nb_targets, 0.1f, 0.01f, random);
+}
+
+// Long corridors: parallel 1D corridors of 100 locations, entered
+// from one end and left from the other, with targets walking along
+// them at various speeds, so that trajectories span many time
+// steps. The density is the number of targets per location.
+
+void create_corridor_scenario(MTPTracker *tracker, int nb_locations, int nb_time_steps,
+                              scalar_t density, Random *random) {
+  int length = 100;
+  int nb_corridors = nb_locations / length;
+  if(nb_corridors < 1) { nb_corridors = 1; length = nb_locations; }
+
+  if(tracker->allocate(nb_time_steps, nb_corridors * length) < 0) exit(EXIT_FAILURE);
+  // One corridor per row
+  tracker->grid_width = length;
+
+  for(int l = 0; l < nb_corridors * length; l++) {
+    for(int m = 0; m < nb_corridors * length; m++) {
+      tracker->allowed_motions[l][m] = l / length == m / length && abs(l - m) <= 1;
+    }
+  }
+
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int l = 0; l < nb_corridors * length; l++) {
+      tracker->entrances[t][l] = (t == 0 || l % length == 0);
+      tracker->exits[t][l] = (t == nb_time_steps - 1 || l % length == length - 1);
+      tracker->detection_scores[t][l] = noisy_score(random, -1.0, 1.0, 0.25, 0.001f);
+    }
+  }
+
+  int nb_targets = int(density * scalar_t(nb_corridors * length) + 0.5);
+  for(int n = 0; n < nb_targets; n++) {
+    int corridor = random->integer(nb_corridors);
+    int start = random->integer(nb_time_steps);
+    // Speed in locations per time step, between 1/4 and 1
+    scalar_t speed = scalar_t(0.25 + 0.75 * random->uniform());
+    for(int t = start; t < nb_time_steps; t++) {
+      int x = int(scalar_t(t - start) * speed);
+      if(x >= length) break;
+      tracker->detection_scores[t][corridor * length + x] =
+        noisy_score(random, 1.0, -1.0, 0.25, 0.1f);
+    }
+  }
+}
+
+struct Scenario {
+  const char *name;
+  void (*create)(MTPTracker *, int, int, scalar_t, Random *);
+  int nb_locations, nb_time_steps;
+  scalar_t density;
+};
+
+Scenario scenarios[] = {
+  { "light",    create_light_scenario,    7,    8,    0.05f },
+  { "heavy",    create_heavy_scenario,    100,  1000, 0.1f },
+  { "soccer",   create_soccer_scenario,   9680, 25,   25.0f / 9680.0f },
+  { "corridor", create_corridor_scenario, 400,  1000, 0.02f },
+  { "crowd",    create_crowd_scenario,    400,  100,  0.1f },
+};
+
+const int nb_scenarios = sizeof(scenarios) / sizeof(Scenario);
+
+//////////////////////////////////////////////////////////////////////
+
+// The graph pruning applied to every instance, see MTPTracker
+
+struct Pruning {
+  int prune_unreachable;
+  int gating;
+  scalar_t gating_threshold;
+  int gating_radius;
+  int coarse_cell_size;
+  int coarse_pooling;
+  int corridor_radius;
+  int temporal_factor;
+  int max_nb_trajectories;
+  scalar_t min_trajectory_gain;
+  int exact_nb_trajectories;
+  int incremental;
+  int bidirectional;
+  int quantization;
+  int vertex_order;
+  // See MTPTracker::storage_pages and storage_numa_node
+  int storage_pages;
+  int numa_node;
+  // Track with MTPGreedy instead of the k-shortest paths
+  int greedy;
+  // Solve also without any pruning, to measure the speedup and the
+  // score loss
+  int reference;
+} pruning;
+
+struct Measure {
+  int nb_locations, nb_time_steps;
+  unsigned long long seed;
+  // Phase durations in seconds. build_graph does not include
+  // compute_dp_ordering, which is reported separately.
+  double read, coarse_solve, build_graph, dp_ordering, dp_distances, retrieval;
+  int nb_shortest_paths;
+  double *shortest_paths;
+  double shortest_paths_total, shortest_paths_max;
+  // Over all the shortest paths
+  long long settled_vertices;
+  double total;
+  int nb_trajectories;
+  scalar_t total_score;
+  scalar_t pruning_ratio;
+  // Of the solve without pruning, if requested
+  double reference_total;
+  scalar_t reference_score;
+  // Bound on the error due to the score quantization
+  scalar_t quantization_score_error;
+  // Last-level cache and data TLB misses of the DP and of all the
+  // Dijkstra, -1 if the counters are disabled or unavailable
+  long long dp_distances_llc_misses, dp_distances_dtlb_misses;
+  long long shortest_paths_llc_misses, shortest_paths_dtlb_misses;
+};
+
+// Whether run_instance reads the hardware counters
+int perf_counters;
+
+long long phase_counter(MTPStats *stats, int phase, int counter) {
+  if(!stats->counters_available[counter]) return -1;
+  return stats->phase_counters[phase][counter];
+}
+
+void run_instance(Scenario *scenario, int nb_locations, int nb_time_steps,
+                  scalar_t density, unsigned long long seed, Measure *measure) {
+  Random random(seed);
+  string description;
+
+  int grid_width;
+
+  {
+    MTPTracker *generator = new MTPTracker();
+    scenario->create(generator, nb_locations, nb_time_steps, density, &random);
+    ostringstream out;
+    generator->write(&out);
+    description = out.str();
+    grid_width = generator->grid_width;
+    delete generator;
+  }
+
+  MTPTracker *tracker = new MTPTracker();
+  istringstream in(description);
+  double start_time = now_in_seconds();
+
+  tracker->enable_stats(1);
+  if(perf_counters) tracker->stats()->enable_perf_counters(1);
+  tracker->prune_unreachable_vertices = pruning.prune_unreachable;
+  tracker->gating = pruning.gating;
+  tracker->gating_threshold = pruning.gating_threshold;
+  tracker->gating_radius = pruning.gating_radius;
+  tracker->grid_width = grid_width;
+  tracker->coarse_cell_size = pruning.coarse_cell_size;
+  tracker->coarse_pooling = pruning.coarse_pooling;
+  tracker->corridor_radius = pruning.corridor_radius;
+  tracker->temporal_factor = pruning.temporal_factor;
+  tracker->max_nb_trajectories = pruning.max_nb_trajectories;
+  tracker->min_trajectory_gain = pruning.min_trajectory_gain;
+  tracker->exact_nb_trajectories = pruning.exact_nb_trajectories;
+  tracker->incremental_shortest_paths = pruning.incremental;
+  tracker->bidirectional_shortest_paths = pruning.bidirectional;
+  tracker->vertex_order = grid_width > 0 ? pruning.vertex_order : MTPTracker::ORDER_LOCATION;
+  tracker->storage_pages = pruning.storage_pages;
+  tracker->storage_numa_node = pruning.numa_node;
+  tracker->read(&in);
+  tracker->quantize_detection_scores(pruning.quantization);
+
+  // The read-out is the same
+  MTPGreedy *greedy = 0;
+  if(pruning.greedy) {
+    greedy = new MTPGreedy();
+    greedy->track(tracker);
+  } else {
+    tracker->build_graph();
+    tracker->track();
+  }
+  measure->total = now_in_seconds() - start_time;
+
+  MTPStats *stats = tracker->stats();
+  measure->nb_locations = tracker->nb_locations;
+  measure->nb_time_steps = tracker->nb_time_steps;
+  measure->seed = seed;
+  measure->read = stats->phase_durations[PHASE_READ];
+  measure->coarse_solve = stats->phase_durations[PHASE_COARSE_SOLVE];
+  measure->build_graph = stats->phase_durations[PHASE_BUILD_GRAPH];
+  measure->dp_ordering = stats->phase_durations[PHASE_DP_ORDERING];
+  measure->dp_distances = stats->phase_durations[PHASE_DP_DISTANCES];
+  measure->retrieval = stats->phase_durations[PHASE_RETRIEVAL];
+  measure->pruning_ratio = stats->pruning_ratio;
+  measure->quantization_score_error = stats->quantization_score_error;
+  measure->dp_distances_llc_misses = phase_counter(stats, PHASE_DP_DISTANCES, COUNTER_LLC_MISSES);
+  measure->dp_distances_dtlb_misses = phase_counter(stats, PHASE_DP_DISTANCES, COUNTER_DTLB_MISSES);
+  measure->shortest_paths_llc_misses = phase_counter(stats, PHASE_SHORTEST_PATH, COUNTER_LLC_MISSES);
+  measure->shortest_paths_dtlb_misses = phase_counter(stats, PHASE_SHORTEST_PATH, COUNTER_DTLB_MISSES);
+  measure->nb_shortest_paths = stats->nb_shortest_paths;
+  measure->shortest_paths = new double[stats->nb_shortest_paths];
+  measure->shortest_paths_total = 0;
+  measure->shortest_paths_max = 0;
+  measure->settled_vertices = stats->settled_vertices;
+  for(int k = 0; k < stats->nb_shortest_paths; k++) {
+    double d = stats->shortest_paths[k].duration;
+    measure->shortest_paths[k] = d;
+    measure->shortest_paths_total += d;
+    if(d > measure->shortest_paths_max) measure->shortest_paths_max = d;
+  }
+
+  if(greedy) {
+    measure->nb_trajectories = greedy->nb_trajectories();
+    measure->total_score = greedy->total_score();
+  } else {
+    measure->nb_trajectories = tracker->nb_trajectories();
+    measure->total_score = 0;
+    for(int k = 0; k < tracker->nb_trajectories(); k++) {
+      measure->total_score += tracker->trajectory_score(k);
+    }
+  }
+
+  delete greedy;
+  delete tracker;
+
+  measure->reference_total = 0;
+  measure->reference_score = 0;
+
+  if(pruning.reference) {
+    MTPTracker *reference = new MTPTracker();
+    istringstream reference_in(description);
+    start_time = now_in_seconds();
+    reference->read(&reference_in);
+    reference->build_graph();
+    reference->track();
+    measure->reference_total = now_in_seconds() - start_time;
+    for(int k = 0; k < reference->nb_trajectories(); k++) {
+      measure->reference_score += reference->trajectory_score(k);
+    }
+    delete reference;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+#define MAX_SWEEP_SIZE 64
+
+struct Global {
+  int nb_scenarios;
+  Scenario *scenarios[MAX_SWEEP_SIZE];
+  int nb_locations[MAX_SWEEP_SIZE], nb_nb_locations;
+  int nb_time_steps[MAX_SWEEP_SIZE], nb_nb_time_steps;
+  scalar_t densities[MAX_SWEEP_SIZE];
+  int nb_densities;
+  int nb_threads[MAX_SWEEP_SIZE], nb_nb_threads;
+  int nb_repeats;
+  unsigned long long seed;
+  const char *csv_filename, *json_filename;
+} global;
+
+void usage(ostream *os) {
+  (*os) << "mtp_bench [-h|--help] [--scenario <names>] [--locations <L list>] [--time-steps <T list>]" << endl;
+  (*os) << "          [--density <list>] [--threads <list>] [--repeats <n>] [--seed <n>]" << endl;
+  (*os) << "          [--prune] [--gating <threshold>] [--gating-radius <r>]" << endl;
+  (*os) << "          [--coarse-to-fine <cell size>] [--pooling max|lse] [--corridor-radius <r>]" << endl;
+  (*os) << "          [--temporal-factor <k>] [--quantize int8|fp16] [--reference]" << endl;
+  (*os) << "          [--vertex-order location|hilbert|morton] [--perf-counters] [--incremental]" << endl;
+  (*os) << "          [--bidirectional] [--pages default|transparent|hugetlb] [--numa-node <node>]" << endl;
+  (*os) << "          [--max-trajectories <K>] [--exact-trajectories <K>] [--min-gain <score>]" << endl;
+  (*os) << "          [--engine ksp|greedy]" << endl;
+  (*os) << "          [--csv <file>] [--json <file>]" << endl;
+  (*os) << endl;
+  (*os) << "Runs the tracker on seeded synthetic scenarios and times every phase:" << endl;
+  (*os) << "read, build_graph (without the DP ordering), compute_dp_ordering," << endl;
+  (*os) << "dp_compute_distances, every Dijkstra, and the path retrieval." << endl;
+  (*os) << endl;
+  (*os) << "Lists are comma-separated, and the cartesian product of them all is" << endl;
+  (*os) << "swept. A value of 0 stands for the scenario default. With n threads, n" << endl;
+  (*os) << "independent instances with consecutive seeds are solved concurrently." << endl;
+  (*os) << "The --prune and --gating options are those of mtp, and the fraction of" << endl;
+  (*os) << "the pruned locations is reported. So is --coarse-to-fine, for the" << endl;
+  (*os) << "grid scenarios, and --temporal-factor. With --reference, every instance" << endl;
+  (*os) << "is solved again without any of them, and the speedup and the relative" << endl;
+  (*os) << "score loss are reported. The options bounding the number of" << endl;
+  (*os) << "trajectories and --quantize are also those of mtp, and the bound on" << endl;
+  (*os) << "the error due to the quantization is reported." << endl;
+  (*os) << endl;
+  (*os) << "With --vertex-order, the vertices of the grid scenarios are numbered" << endl;
+  (*os) << "along the given curve, see mtp. With --perf-counters, the last-level" << endl;
+  (*os) << "cache and data TLB misses of dp_compute_distances and of the Dijkstra" << endl;
+  (*os) << "are reported, to compare the orders. So are --pages and --numa-node, see" << endl;
+  (*os) << "mtp, the huge pages cutting the TLB misses." << endl;
+  (*os) << endl;
+  (*os) << "With --incremental, the shortest paths are repaired after every" << endl;
+  (*os) << "trajectory, see mtp. The number of vertices settled by all the Dijkstra" << endl;
+  (*os) << "is reported in any case. With --bidirectional, they are computed" << endl;
+  (*os) << "from the source and the sink at once, see mtp." << endl;
+  (*os) << endl;
+  (*os) << "With --engine greedy, the instances are tracked frame by frame by" << endl;
+  (*os) << "MTPGreedy instead, and with --reference, the speedup and the score loss" << endl;
+  (*os) << "are those relative to the optimal trajectories." << endl;
+  (*os) << endl;
+  (*os) << "Scenarios (default L, T, density):" << endl;
+  for(int s = 0; s < nb_scenarios; s++) {
+    (*os) << "  " << scenarios[s].name
+          << " (" << scenarios[s].nb_locations
+          << ", " << scenarios[s].nb_time_steps
+          << ", " << scenarios[s].density << ")" << endl;
+  }
+  (*os) << "The density is the score flip noise for light, the motion probability" << endl;
+  (*os) << "for heavy, and the number of targets per location otherwise." << endl;
+}
+
+int parse_int_list(const char *s, int *values) {
+  int n = 0;
+  while(*s && n < MAX_SWEEP_SIZE) {
+    values[n++] = atoi(s);
+    while(*s && *s != ',') s++;
+    if(*s == ',') s++;
+  }
+  return n;
+}
+
+int parse_scalar_list(const char *s, scalar_t *values) {
+  int n = 0;
+  while(*s && n < MAX_SWEEP_SIZE) {
+    values[n++] = scalar_t(atof(s));
+    while(*s && *s != ',') s++;
+    if(*s == ',') s++;
+  }
+  return n;
+}
+
+int parse_scenario_list(const char *s, Scenario **values) {
+  int n = 0;
+  while(*s && n < MAX_SWEEP_SIZE) {
+    int length = 0;
+    while(s[length] && s[length] != ',') length++;
+    values[n] = 0;
+    for(int k = 0; k < nb_scenarios; k++) {
+      if(int(strlen(scenarios[k].name)) == length &&
+         strncmp(scenarios[k].name, s, length) == 0) {
+        values[n] = &scenarios[k];
+      }
+    }
+    if(!values[n]) {
+      cerr << "Unknown scenario " << string(s, length) << "." << endl;
+      exit(EXIT_FAILURE);
+    }
+    n++;
+    s += length;
+    if(*s == ',') s++;
+  }
+  return n;
+}
+
+void write_csv_header(ostream *os) {
+  (*os) << "scenario,locations,time_steps,density,threads,thread,repeat,seed,"
+        << "read,build_graph,dp_ordering,dp_distances,nb_shortest_paths,"
+        << "shortest_paths_total,shortest_paths_max,retrieval,total,batch_wall_time,"
+        << "nb_trajectories,total_score,pruning_ratio,coarse_solve,"
+        << "reference_total,reference_score,quantization_score_error,"
+        << "dp_distances_llc_misses,dp_distances_dtlb_misses,"
+        << "shortest_paths_llc_misses,shortest_paths_dtlb_misses,settled_vertices"
+        << endl;
+}
+
+void write_csv(ostream *os, Scenario *scenario, scalar_t density, int nb_threads,
+               int thread, int repeat, double batch_wall_time, Measure *m) {
+  (*os) << scenario->name
+        << "," << m->nb_locations
+        << "," << m->nb_time_steps
+        << "," << density
+        << "," << nb_threads
+        << "," << thread
+        << "," << repeat
+        << "," << m->seed
+        << "," << m->read
+        << "," << m->build_graph
+        << "," << m->dp_ordering
+        << "," << m->dp_distances
+        << "," << m->nb_shortest_paths
+        << "," << m->shortest_paths_total
+        << "," << m->shortest_paths_max
+        << "," << m->retrieval
+        << "," << m->total
+        << "," << batch_wall_time
+        << "," << m->nb_trajectories
+        << "," << m->total_score
+        << "," << m->pruning_ratio
+        << "," << m->coarse_solve
+        << "," << m->reference_total
+        << "," << m->reference_score
+        << "," << m->quantization_score_error
+        << "," << m->dp_distances_llc_misses
+        << "," << m->dp_distances_dtlb_misses
+        << "," << m->shortest_paths_llc_misses
+        << "," << m->shortest_paths_dtlb_misses
+        << "," << m->settled_vertices
+        << endl;
+}
+
+void write_json(ostream *os, Scenario *scenario, scalar_t density, int nb_threads,
+                int thread, int repeat, double batch_wall_time, Measure *m) {
+  (*os) << "  {\"scenario\": \"" << scenario->name << "\""
+        << ", \"locations\": " << m->nb_locations
+        << ", \"time_steps\": " << m->nb_time_steps
+        << ", \"density\": " << density
+        << ", \"threads\": " << nb_threads
+        << ", \"thread\": " << thread
+        << ", \"repeat\": " << repeat
+        << ", \"seed\": " << m->seed
+        << ", \"read\": " << m->read
+        << ", \"coarse_solve\": " << m->coarse_solve
+        << ", \"build_graph\": " << m->build_graph
+        << ", \"dp_ordering\": " << m->dp_ordering
+        << ", \"dp_distances\": " << m->dp_distances
+        << ", \"shortest_paths\": [";
+  for(int k = 0; k < m->nb_shortest_paths; k++) {
+    if(k > 0) (*os) << ", ";
+    (*os) << m->shortest_paths[k];
+  }
+  (*os) << "]"
+        << ", \"retrieval\": " << m->retrieval
+        << ", \"total\": " << m->total
+        << ", \"batch_wall_time\": " << batch_wall_time
+        << ", \"nb_trajectories\": " << m->nb_trajectories
+        << ", \"total_score\": " << m->total_score
+        << ", \"pruning_ratio\": " << m->pruning_ratio
+        << ", \"reference_total\": " << m->reference_total
+        << ", \"reference_score\": " << m->reference_score
+        << ", \"quantization_score_error\": " << m->quantization_score_error
+        << ", \"dp_distances_llc_misses\": " << m->dp_distances_llc_misses
+        << ", \"dp_distances_dtlb_misses\": " << m->dp_distances_dtlb_misses
+        << ", \"shortest_paths_llc_misses\": " << m->shortest_paths_llc_misses
+        << ", \"shortest_paths_dtlb_misses\": " << m->shortest_paths_dtlb_misses
+        << ", \"settled_vertices\": " << m->settled_vertices
+        << "}";
+}
+
+int main(int argc, char **argv) {
+  global.nb_scenarios = nb_scenarios;
+  for(int s = 0; s < nb_scenarios; s++) global.scenarios[s] = &scenarios[s];
+  global.nb_locations[0] = 0; global.nb_nb_locations = 1;
+  global.nb_time_steps[0] = 0; global.nb_nb_time_steps = 1;
+  global.densities[0] = 0; global.nb_densities = 1;
+  global.nb_threads[0] = 1; global.nb_nb_threads = 1;
+  global.nb_repeats = 1;
+  global.seed = 1;
+  global.csv_filename = 0;
+  global.json_filename = 0;
+  pruning.prune_unreachable = 0;
+  pruning.gating = 0;
+  pruning.gating_threshold = 0;
+  pruning.gating_radius = 2;
+  pruning.coarse_cell_size = 0;
+  pruning.coarse_pooling = MTPTracker::POOLING_MAX;
+  pruning.corridor_radius = 0;
+  pruning.temporal_factor = 0;
+  pruning.reference = 0;
+  pruning.max_nb_trajectories = 0;
+  pruning.min_trajectory_gain = 0;
+  pruning.exact_nb_trajectories = 0;
+  pruning.incremental = 0;
+  pruning.bidirectional = 0;
+  pruning.quantization = MTPTracker::QUANTIZATION_NONE;
+  pruning.vertex_order = MTPTracker::ORDER_LOCATION;
+  pruning.storage_pages = STORAGE_PAGES_DEFAULT;
+  pruning.numa_node = -1;
+  pruning.greedy = 0;
+  perf_counters = 0;
+
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+      usage(&cout);
+      exit(EXIT_SUCCESS);
+    } else if(i + 1 < argc && strcmp(argv[i], "--scenario") == 0) {
+      global.nb_scenarios = parse_scenario_list(argv[++i], global.scenarios);
+    } else if(i + 1 < argc && strcmp(argv[i], "--locations") == 0) {
+      global.nb_nb_locations = parse_int_list(argv[++i], global.nb_locations);
+    } else if(i + 1 < argc && strcmp(argv[i], "--time-steps") == 0) {
+      global.nb_nb_time_steps = parse_int_list(argv[++i], global.nb_time_steps);
+    } else if(i + 1 < argc && strcmp(argv[i], "--density") == 0) {
+      global.nb_densities = parse_scalar_list(argv[++i], global.densities);
+    } else if(i + 1 < argc && strcmp(argv[i], "--threads") == 0) {
+      global.nb_nb_threads = parse_int_list(argv[++i], global.nb_threads);
+    } else if(i + 1 < argc && strcmp(argv[i], "--repeats") == 0) {
+      global.nb_repeats = atoi(argv[++i]);
+    } else if(i + 1 < argc && strcmp(argv[i], "--seed") == 0) {
+      global.seed = strtoull(argv[++i], 0, 10);
+    } else if(strcmp(argv[i], "--prune") == 0) {
+      pruning.prune_unreachable = 1;
+    } else if(i + 1 < argc && strcmp(argv[i], "--gating") == 0) {
+      pruning.gating = 1;
+      pruning.gating_threshold = scalar_t(atof(argv[++i]));
+    } else if(i + 1 < argc && strcmp(argv[i], "--gating-radius") == 0) {
+      pruning.gating_radius = atoi(argv[++i]);
+      if(pruning.gating_radius < 0) { usage(&cerr); exit(EXIT_FAILURE); }
+    } else if(i + 1 < argc && strcmp(argv[i], "--coarse-to-fine") == 0) {
+      pruning.coarse_cell_size = atoi(argv[++i]);
+    } else if(i + 1 < argc && strcmp(argv[i], "--pooling") == 0) {
+      i++;
+      if(strcmp(argv[i], "lse") == 0) pruning.coarse_pooling = MTPTracker::POOLING_LOG_SUM_EXP;
+      else pruning.coarse_pooling = MTPTracker::POOLING_MAX;
+    } else if(i + 1 < argc && strcmp(argv[i], "--corridor-radius") == 0) {
+      pruning.corridor_radius = atoi(argv[++i]);
+      if(pruning.corridor_radius < 0) { usage(&cerr); exit(EXIT_FAILURE); }
+    } else if(i + 1 < argc && strcmp(argv[i], "--temporal-factor") == 0) {
+      pruning.temporal_factor = atoi(argv[++i]);
+    } else if(i + 1 < argc && strcmp(argv[i], "--max-trajectories") == 0) {
+      pruning.max_nb_trajectories = atoi(argv[++i]);
+    } else if(i + 1 < argc && strcmp(argv[i], "--exact-trajectories") == 0) {
+      pruning.exact_nb_trajectories = 1;
+      pruning.max_nb_trajectories = atoi(argv[++i]);
+      if(pruning.max_nb_trajectories < 1) { usage(&cerr); exit(EXIT_FAILURE); }
+    } else if(i + 1 < argc && strcmp(argv[i], "--min-gain") == 0) {
+      pruning.min_trajectory_gain = scalar_t(atof(argv[++i]));
+    } else if(i + 1 < argc && strcmp(argv[i], "--quantize") == 0) {
+      i++;
+      if(strcmp(argv[i], "int8") == 0) pruning.quantization = MTPTracker::QUANTIZATION_INT8;
+      else if(strcmp(argv[i], "fp16") == 0) pruning.quantization = MTPTracker::QUANTIZATION_FP16;
+      else pruning.quantization = MTPTracker::QUANTIZATION_NONE;
+    } else if(i + 1 < argc && strcmp(argv[i], "--vertex-order") == 0) {
+      i++;
+      if(strcmp(argv[i], "hilbert") == 0) pruning.vertex_order = MTPTracker::ORDER_HILBERT;
+      else if(strcmp(argv[i], "morton") == 0) pruning.vertex_order = MTPTracker::ORDER_MORTON;
+      else pruning.vertex_order = MTPTracker::ORDER_LOCATION;
+    } else if(i + 1 < argc && strcmp(argv[i], "--pages") == 0) {
+      i++;
+      if(strcmp(argv[i], "transparent") == 0) pruning.storage_pages = STORAGE_PAGES_TRANSPARENT;
+      else if(strcmp(argv[i], "hugetlb") == 0) pruning.storage_pages = STORAGE_PAGES_HUGETLB;
+      else pruning.storage_pages = STORAGE_PAGES_DEFAULT;
+    } else if(i + 1 < argc && strcmp(argv[i], "--numa-node") == 0) {
+      pruning.numa_node = atoi(argv[++i]);
+    } else if(i + 1 < argc && strcmp(argv[i], "--engine") == 0) {
+      i++;
+      pruning.greedy = strcmp(argv[i], "greedy") == 0;
+    } else if(strcmp(argv[i], "--incremental") == 0) {
+      pruning.incremental = 1;
+    } else if(strcmp(argv[i], "--bidirectional") == 0) {
+      pruning.bidirectional = 1;
+    } else if(strcmp(argv[i], "--perf-counters") == 0) {
+      perf_counters = 1;
+    } else if(strcmp(argv[i], "--reference") == 0) {
+      pruning.reference = 1;
+    } else if(i + 1 < argc && strcmp(argv[i], "--csv") == 0) {
+      global.csv_filename = argv[++i];
+    } else if(i + 1 < argc && strcmp(argv[i], "--json") == 0) {
+      global.json_filename = argv[++i];
+    } else {
+      usage(&cerr);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  ofstream *csv = 0, *json = 0;
+  int nb_json_records = 0;
+
+  if(global.csv_filename) {
+    csv = new ofstream(global.csv_filename);
+    write_csv_header(csv);
+  }
+
+  if(global.json_filename) {
+    json = new ofstream(global.json_filename);
+    (*json) << "[" << endl;
+  }
+
+  cout << "scenario L T density threads repeat"
+       << " read build_graph dp_ordering dp_distances #dijkstra dijkstra_total retrieval total"
+       << " #trajectories pruned settled";
+  if(pruning.reference) cout << " speedup score_loss";
+  if(perf_counters) cout << " dp_llc_misses dijkstra_llc_misses";
+  cout << endl;
+
+  for(int s = 0; s < global.nb_scenarios; s++) {
+    Scenario *scenario = global.scenarios[s];
+    for(int il = 0; il < global.nb_nb_locations; il++) {
+      int nb_locations = global.nb_locations[il] > 0 ?
+        global.nb_locations[il] : scenario->nb_locations;
+      for(int it = 0; it < global.nb_nb_time_steps; it++) {
+        int nb_time_steps = global.nb_time_steps[it] > 0 ?
+          global.nb_time_steps[it] : scenario->nb_time_steps;
+        for(int id = 0; id < global.nb_densities; id++) {
+          scalar_t density = global.densities[id] > 0 ?
+            global.densities[id] : scenario->density;
+          for(int ith = 0; ith < global.nb_nb_threads; ith++) {
+            int nb_threads = global.nb_threads[ith] > 0 ? global.nb_threads[ith] : 1;
+            for(int r = 0; r < global.nb_repeats; r++) {
+              Measure *measures = new Measure[nb_threads];
+              thread **threads = new thread *[nb_threads];
+              double start_time = now_in_seconds();
+
+              for(int k = 0; k < nb_threads; k++) {
+                threads[k] = new thread(run_instance, scenario, nb_locations, nb_time_steps,
+                                        density, global.seed + k, &measures[k]);
+              }
+
+              for(int k = 0; k < nb_threads; k++) {
+                threads[k]->join();
+                delete threads[k];
+              }
+
+              double batch_wall_time = now_in_seconds() - start_time;
+
+              for(int k = 0; k < nb_threads; k++) {
+                Measure *m = &measures[k];
+                cout << scenario->name
+                     << " " << m->nb_locations
+                     << " " << m->nb_time_steps
+                     << " " << density
+                     << " " << nb_threads
+                     << " " << r
+                     << " " << m->read
+                     << " " << m->build_graph
+                     << " " << m->dp_ordering
+                     << " " << m->dp_distances
+                     << " " << m->nb_shortest_paths
+                     << " " << m->shortest_paths_total
+                     << " " << m->retrieval
+                     << " " << m->total
+                     << " " << m->nb_trajectories
+                     << " " << m->pruning_ratio
+                     << " " << m->settled_vertices;
+                if(pruning.reference) {
+                  cout << " " << m->reference_total / m->total
+                       << " " << (m->reference_score - m->total_score) / m->reference_score;
+                }
+                if(perf_counters) {
+                  cout << " " << m->dp_distances_llc_misses
+                       << " " << m->shortest_paths_llc_misses;
+                }
+                cout << endl;
+
+                if(csv) {
+                  write_csv(csv, scenario, density, nb_threads, k, r, batch_wall_time, m);
+                }
+
+                if(json) {
+                  if(nb_json_records++ > 0) (*json) << "," << endl;
+                  write_json(json, scenario, density, nb_threads, k, r, batch_wall_time, m);
+                }
+
+                delete[] m->shortest_paths;
+              }
+
+              delete[] threads;
+              delete[] measures;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  if(json) {
+    (*json) << endl << "]" << endl;
+    delete json;
+  }
+
+  delete csv;
+
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,125 @@
+/*
+ *  mtp is the ``Multi Tracked Paths'', an implementation of the
+ *  k-shortest paths algorithm for multi-target tracking.
+ *
+ *  Copyright (c) 2012 Idiap Research Institute, http://www.idiap.ch/
+ *  Written by Francois Fleuret <francois.fleuret@idiap.ch>
+ *
+ *  This file is part of mtp.
+ *
+ *  mtp is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  mtp is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ *  License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with selector.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <math.h>
+#include <thread>
+
+#include "mtp_detections.h"
+
+MTPDetections::MTPDetections() {
+  x_min = 0;
+  x_max = 0;
+  y_min = 0;
+  y_max = 0;
+  grid_width = 0;
+  grid_height = 0;
+  mode = SNAP;
+  false_positive_rate = 0.1f;
+  false_negative_rate = 0.1f;
+  nb_threads = 0;
+}
+
+// The position of v in the grid of n points from v_min to v_max,
+// between 0 and n-1
+
+static scalar_t grid_coordinate(scalar_t v, scalar_t v_min, scalar_t v_max, int n) {
+  if(n <= 1 || v_max <= v_min) return 0;
+  scalar_t c = (v - v_min) / (v_max - v_min) * scalar_t(n - 1);
+  if(c < 0) return 0;
+  if(c > scalar_t(n - 1)) return scalar_t(n - 1);
+  return c;
+}
+
+void MTPDetections::rasterize_frame(int nb_detections, const scalar_t *xy,
+                                    const scalar_t *confidences, scalar_t *scores) {
+  int nb_locations = grid_width * grid_height;
+  scalar_t detected = scalar_t(log((1 - false_negative_rate) / false_positive_rate));
+  scalar_t missed = scalar_t(log(false_negative_rate / (1 - false_positive_rate)));
+
+  // Most locations have no detection. We first store in scores the
+  // probability of not being detected, and touch only the locations
+  // near a detection
+  for(int l = 0; l < nb_locations; l++) scores[l] = 1;
+
+  for(int k = 0; k < nb_detections; k++) {
+    // A target whose position is unknown, a NaN would not be clamped
+    if(!isfinite(xy[2 * k]) || !isfinite(xy[2 * k + 1])) continue;
+    scalar_t c = confidences ? confidences[k] : 1;
+    scalar_t u = grid_coordinate(xy[2 * k], x_min, x_max, grid_width);
+    scalar_t v = grid_coordinate(xy[2 * k + 1], y_min, y_max, grid_height);
+    if(mode == SNAP) {
+      int l = int(floor(v + 0.5f)) * grid_width + int(floor(u + 0.5f));
+      scores[l] *= 1 - c;
+    } else {
+      int i = int(floor(u)), j = int(floor(v));
+      if(i > grid_width - 2) i = grid_width - 2;
+      if(j > grid_height - 2) j = grid_height - 2;
+      if(i < 0) i = 0;
+      if(j < 0) j = 0;
+      scalar_t a = u - scalar_t(i), b = v - scalar_t(j);
+      for(int dj = 0; dj < 2 && j + dj < grid_height; dj++) {
+        for(int di = 0; di < 2 && i + di < grid_width; di++) {
+          scalar_t w = (di ? a : 1 - a) * (dj ? b : 1 - b);
+          scores[(j + dj) * grid_width + i + di] *= 1 - w * c;
+        }
+      }
+    }
+  }
+
+  for(int l = 0; l < nb_locations; l++) {
+    scores[l] = (1 - scores[l]) * detected + scores[l] * missed;
+  }
+}
+
+void MTPDetections::rasterize_frames(int first_frame, int nb_frames, const int *frame_first,
+                                     const scalar_t *xy, const scalar_t *confidences,
+                                     scalar_t **scores) {
+  for(int t = first_frame; t < first_frame + nb_frames; t++) {
+    int k = frame_first[t];
+    rasterize_frame(frame_first[t + 1] - k, xy + 2 * k, confidences ? confidences + k : 0,
+                    scores[t]);
+  }
+}
+
+void MTPDetections::rasterize(int nb_frames, const int *frame_first, const scalar_t *xy,
+                              const scalar_t *confidences, scalar_t **scores) {
+  ASSERT(grid_width > 0 && grid_height > 0);
+
+  int n = nb_threads;
+  if(n <= 0) n = int(thread::hardware_concurrency());
+  if(n > nb_frames) n = nb_frames;
+  if(n <= 1) {
+    rasterize_frames(0, nb_frames, frame_first, xy, confidences, scores);
+    return;
+  }
+
+  // The frames are independent, every thread does a contiguous block
+  thread *threads = new thread[n];
+  for(int k = 0; k < n; k++) {
+    int first = (nb_frames * k) / n, last = (nb_frames * (k + 1)) / n;
+    threads[k] = thread(&MTPDetections::rasterize_frames, this,
+                        first, last - first, frame_first, xy, confidences, scores);
+  }
+  for(int k = 0; k < n; k++) threads[k].join();
+  delete[] threads;
+}
@@ -0,0 +1,77 @@
+/*
+ *  mtp is the ``Multi Tracked Paths'', an implementation of the
+ *  k-shortest paths algorithm for multi-target tracking.
+ *
+ *  Copyright (c) 2012 Idiap Research Institute, http://www.idiap.ch/
+ *  Written by Francois Fleuret <francois.fleuret@idiap.ch>
+ *
+ *  This file is part of mtp.
+ *
+ *  mtp is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  mtp is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ *  License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with selector.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MTP_DETECTIONS_H
+#define MTP_DETECTIONS_H
+
+#include <iostream>
+
+using namespace std;
+
+#include "misc.h"
+
+// Computes the detection scores of a grid of locations from point
+// detections, without going through a dense occupancy map.
+//
+// The locations are the centres of a grid_width x grid_height grid,
+// evenly spaced from (x_min, y_min) to (x_max, y_max) and numbered row
+// by row, as in python/create_mock_data.py. A detection is either
+// snapped to the nearest location, or splatted on the four nearest
+// ones with bilinear weights. The probability that a location is
+// detected is then 1 - prod_k (1 - w_k c_k) over the detections k
+// reaching it with weight w_k and confidence c_k, and its score the
+// corresponding mix of the log-odds of occupancy given a detection,
+// log((1 - false_negative_rate) / false_positive_rate), and given
+// none, log(false_negative_rate / (1 - false_positive_rate)).
+
+class MTPDetections {
+  // Writes the scores of one frame
+  void rasterize_frame(int nb_detections, const scalar_t *xy, const scalar_t *confidences,
+                       scalar_t *scores);
+  void rasterize_frames(int first_frame, int nb_frames, const int *frame_first,
+                        const scalar_t *xy, const scalar_t *confidences, scalar_t **scores);
+public:
+  scalar_t x_min, x_max, y_min, y_max;
+  int grid_width, grid_height;
+
+  enum { SNAP, SPLAT };
+  int mode;
+
+  scalar_t false_positive_rate, false_negative_rate;
+
+  // Number of threads, one per core if zero
+  int nb_threads;
+
+  MTPDetections();
+
+  // The detections of frame t are frame_first[t] to
+  // frame_first[t+1]-1, with coordinates xy[2k], xy[2k+1] and
+  // confidence confidences[k], or 1 if confidences is null, which
+  // have to be in [0, 1]. The detections with a coordinate which is
+  // not finite are ignored. Writes the nb_frames x
+  // grid_width*grid_height scores, each frame in its row of scores.
+  void rasterize(int nb_frames, const int *frame_first, const scalar_t *xy,
+                 const scalar_t *confidences, scalar_t **scores);
+};
+
+#endif
@@ -24,6 +24,8 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <cmath>
 #include <stdlib.h>
 #include <string.h>
 
@@ -49,7 +51,7 @@ void create_light_test(MTPTracker *tracker) {
   int nb_time_steps = 8;
   int motion_amplitude = 1;
 
-  tracker->allocate(nb_time_steps, nb_locations);
+  if(tracker->allocate(nb_time_steps, nb_locations) < 0) exit(EXIT_FAILURE);
 
   // We define the spatial structure by stating what are the possible
   // motions of targets, and what are the entrances and the exits.
@@ -134,7 +136,7 @@ void create_heavy_test(MTPTracker *tracker) {
   int nb_locations = 100;
   int nb_time_steps = 1000;
 
-  tracker->allocate(nb_time_steps, nb_locations);
+  if(tracker->allocate(nb_time_steps, nb_locations) < 0) exit(EXIT_FAILURE);
 
   for(int l = 0; l < nb_locations; l++) {
     for(int m = 0; m < nb_locations; m++) {
@@ -158,6 +160,148 @@ void create_heavy_test(MTPTracker *tracker) {
   }
 }
 
+// Checks that an MTPGraph with cycles finds the same total length as
+// the DAG it extends. The DAG is a grid of locations along time, and
+// the cycles come from edges of positive length from vertices to
+// themselves, as for a target staying still, and back in time, which
+// no optimal path takes. Returns 0 if the two agree.
+
+int check_cyclic_graph() {
+  int nb_locations = 60;
+  int nb_time_steps = 200;
+  int nb_cycles = 100;
+
+  index_t nb_vertices = 2 + index_t(nb_time_steps) * nb_locations;
+  index_t source = 0, sink = nb_vertices - 1;
+  index_t max_nb_edges = index_t(nb_time_steps) * nb_locations * 7 + 2 * nb_cycles;
+  index_t *vertex_from = new index_t[max_nb_edges];
+  index_t *vertex_to = new index_t[max_nb_edges];
+  scalar_t *lengths = new scalar_t[max_nb_edges];
+  index_t nb_edges = 0;
+
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int l = 0; l < nb_locations; l++) {
+      index_t v = 1 + index_t(t) * nb_locations + l;
+      vertex_from[nb_edges] = source; vertex_to[nb_edges] = v; lengths[nb_edges++] = 1.0;
+      vertex_from[nb_edges] = v; vertex_to[nb_edges] = sink; lengths[nb_edges++] = 1.0;
+      if(t < nb_time_steps - 1) {
+        for(int d = -2; d <= 2; d++) {
+          if(l + d >= 0 && l + d < nb_locations) {
+            vertex_from[nb_edges] = v;
+            vertex_to[nb_edges] = v + nb_locations + d;
+            lengths[nb_edges++] = scalar_t(2.0 * double(rand()) / RAND_MAX - 1.2);
+          }
+        }
+      }
+    }
+  }
+
+  index_t nb_dag_edges = nb_edges;
+
+  for(int c = 0; c < nb_cycles; c++) {
+    index_t v = 1 + rand() % (nb_vertices - 2), w = 1 + rand() % (nb_vertices - 2);
+    vertex_from[nb_edges] = v; vertex_to[nb_edges] = v; lengths[nb_edges++] = 1.0;
+    vertex_from[nb_edges] = v; vertex_to[nb_edges] = w; lengths[nb_edges++] = 1000.0;
+  }
+
+  MTPStats dag_stats, cyclic_stats;
+  MTPGraph *dag = new MTPGraph(nb_vertices, nb_dag_edges, vertex_from, vertex_to,
+                               source, sink, &dag_stats);
+  MTPGraph *cyclic = new MTPGraph(nb_vertices, nb_edges, vertex_from, vertex_to,
+                                  source, sink, &cyclic_stats);
+  dag->find_best_paths(lengths);
+  cyclic->find_best_paths(lengths);
+
+  int result = fabs(dag->total_length - cyclic->total_length) > 1e-3 * (1 + fabs(dag->total_length));
+
+  cout << "DAG total length " << dag->total_length
+       << ", distances " << dag_stats.phase_durations[PHASE_DP_DISTANCES] << "s" << endl;
+  cout << "Cyclic total length " << cyclic->total_length
+       << ", distances " << cyclic_stats.phase_durations[PHASE_DP_DISTANCES] << "s" << endl;
+  cout << (result ? "MISMATCH" : "ok") << endl;
+
+  delete cyclic;
+  delete dag;
+  delete[] lengths;
+  delete[] vertex_to;
+  delete[] vertex_from;
+
+  return result;
+}
+
+// Checks that the coarse-to-fine tracking with the log-sum-exp
+// pooling finds the same total score as the tracking at full
+// resolution, on a grid with a few targets walking on a noisy
+// background. Returns 0 if the two agree.
+
+int check_coarse_pooling() {
+  int width = 40, height = 30;
+  int nb_locations = width * height;
+  int nb_time_steps = 60;
+  int nb_targets = 4;
+
+  MTPTracker *scene = new MTPTracker();
+  if(scene->allocate(nb_time_steps, nb_locations) < 0) exit(EXIT_FAILURE);
+
+  for(int l = 0; l < nb_locations; l++) {
+    for(int m = 0; m < nb_locations; m++) {
+      scene->allowed_motions[l][m] =
+        abs(l % width - m % width) <= 1 && abs(l / width - m / width) <= 1;
+    }
+  }
+
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int l = 0; l < nb_locations; l++) {
+      scene->entrances[t][l] = (t == 0);
+      scene->exits[t][l] = (t == nb_time_steps - 1);
+      scene->detection_scores[t][l] = noisy_score(-1.0, 1.0, 0.25, 0.001f);
+    }
+  }
+
+  for(int n = 0; n < nb_targets; n++) {
+    int x = rand() % width, y = rand() % height;
+    for(int t = 0; t < nb_time_steps; t++) {
+      scene->detection_scores[t][x + y * width] = noisy_score(1.0, -1.0, 0.25, 0.1f);
+      int nx = x + rand() % 3 - 1, ny = y + rand() % 3 - 1;
+      if(nx >= 0 && nx < width && ny >= 0 && ny < height) { x = nx; y = ny; }
+    }
+  }
+
+  stringstream description;
+  scene->write(&description);
+  delete scene;
+
+  MTPTracker *reference = new MTPTracker();
+  reference->read(&description);
+  reference->build_graph();
+  reference->track();
+
+  description.clear();
+  description.seekg(0);
+
+  MTPTracker *coarse = new MTPTracker();
+  coarse->grid_width = width;
+  coarse->coarse_cell_size = 4;
+  coarse->coarse_pooling = MTPTracker::POOLING_LOG_SUM_EXP;
+  coarse->read(&description);
+  coarse->build_graph();
+  coarse->track();
+
+  int result = fabs(reference->total_score() - coarse->total_score()) >
+    1e-3 * (1 + fabs(reference->total_score()));
+
+  cout << "Reference total score " << reference->total_score()
+       << ", " << reference->nb_trajectories() << " trajectories" << endl;
+  cout << "Coarse-to-fine total score " << coarse->total_score()
+       << ", " << coarse->nb_trajectories() << " trajectories" << endl;
+  cout << (result ? "MISMATCH" : "ok") << endl;
+
+  delete coarse;
+  delete reference;
+
+  return result;
+}
+
 int main(int argc, char **argv) {
   int stress_test;
 
@@ -165,8 +309,12 @@ int main(int argc, char **argv) {
     stress_test = 0;
   } else if(argc == 2 && strcmp(argv[1], "stress") == 0) {
     stress_test = 1;
+  } else if(argc == 2 && strcmp(argv[1], "cyclic") == 0) {
+    exit(check_cyclic_graph() ? EXIT_FAILURE : EXIT_SUCCESS);
+  } else if(argc == 2 && strcmp(argv[1], "lse") == 0) {
+    exit(check_coarse_pooling() ? EXIT_FAILURE : EXIT_SUCCESS);
   } else {
-    cerr << "mtp_examples [stress]" << endl;
+    cerr << "mtp_examples [stress|cyclic|lse]" << endl;
     exit(EXIT_FAILURE);
   }
 
@@ -26,6 +26,16 @@
 
 #include <cmath>
 #include <float.h>
+#include <string.h>
+#include <stdio.h>
+#include <new>
+#include <fstream>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "storage.h"
 
 using namespace std;
 
@@ -54,8 +64,9 @@ public:
 
   inline void add_leaving_edge(Edge *e);
   inline void del_leaving_edge(Edge *e);
-  inline void decrease_distance_in_heap(Vertex **heap);
-  inline void increase_distance_in_heap(Vertex **heap, Vertex **heap_bottom);
+  // These two return the number of swaps they did
+  inline int decrease_distance_in_heap(Vertex **heap);
+  inline int increase_distance_in_heap(Vertex **heap, Vertex **heap_bottom);
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -95,8 +106,9 @@ void Vertex::del_leaving_edge(Edge *e) {
   }
 }
 
-void Vertex::decrease_distance_in_heap(Vertex **heap) {
+int Vertex::decrease_distance_in_heap(Vertex **heap) {
   Vertex **p, **h;
+  int nb_swaps = 0;
   h = heap_slot;
   while(1) {
     if(h <= heap) break;
@@ -105,13 +117,17 @@ void Vertex::decrease_distance_in_heap(Vertex **heap) {
     swap((*p)->heap_slot, heap_slot);
     swap(*p, *h);
     h = p;
+    nb_swaps++;
   }
+  return nb_swaps;
 }
 
-void Vertex::increase_distance_in_heap(Vertex **heap, Vertex **heap_bottom) {
+int Vertex::increase_distance_in_heap(Vertex **heap, Vertex **heap_bottom) {
   Vertex **c1, **c2, **h;
+  int nb_swaps = 0;
   h = heap_slot;
   while(1) {
+    nb_swaps++;
     c1 = heap + 2 * (h - heap) + 1;
     if(c1 >= heap_bottom) break;
     c2 = c1 + 1;
@@ -133,32 +149,89 @@ void Vertex::increase_distance_in_heap(Vertex **heap, Vertex **heap_bottom) {
       } else break;
     }
   }
+  return nb_swaps - 1;
 }
 
 //////////////////////////////////////////////////////////////////////
 
-MTPGraph::MTPGraph(int nb_vertices, int nb_edges,
-                   int *vertex_from, int *vertex_to,
-                   int source, int sink) {
+MTPGraph::MTPGraph(index_t nb_vertices, index_t nb_edges,
+                   index_t *vertex_from, index_t *vertex_to,
+                   index_t source, index_t sink, MTPStats *stats,
+                   const StoragePolicy *storage) {
+  allocate(nb_vertices, nb_edges, source, sink, stats, storage);
+  for(index_t e = 0; e < nb_edges; e++) {
+    set_edge(e, vertex_from[e], vertex_to[e]);
+  }
+  end_construction(0);
+}
+
+MTPGraph::MTPGraph(index_t nb_vertices, index_t nb_edges,
+                   index_t source, index_t sink, MTPStats *stats,
+                   const StoragePolicy *storage) {
+  allocate(nb_vertices, nb_edges, source, sink, stats, storage);
+}
+
+MTPGraph::MTPGraph(MTPGraph *graph, MTPStats *stats) {
+  allocate(graph->_nb_vertices, graph->_nb_edges,
+           graph->_source - graph->_vertices, graph->_sink - graph->_vertices,
+           stats, &graph->_storage);
+
+  // The same pointers, rebased on our arrays
+  Edge *e0 = graph->_edges;
+  Vertex *v0 = graph->_vertices;
+
+  for(index_t k = 0; k < _nb_edges; k++) {
+    Edge *from = &e0[k], *to = &_edges[k];
+    to->occupied = from->occupied;
+    to->length = from->length;
+    to->positivized_length = from->positivized_length;
+    to->origin_vertex = _vertices + (from->origin_vertex - v0);
+    to->terminal_vertex = _vertices + (from->terminal_vertex - v0);
+    to->next_leaving_edge = from->next_leaving_edge ? _edges + (from->next_leaving_edge - e0) : 0;
+    to->pred_leaving_edge = from->pred_leaving_edge ? _edges + (from->pred_leaving_edge - e0) : 0;
+  }
+
+  for(index_t k = 0; k < _nb_vertices; k++) {
+    Vertex *from = &v0[k], *to = &_vertices[k];
+    to->distance_from_source = from->distance_from_source;
+    to->pred_edge_toward_source =
+      from->pred_edge_toward_source ? _edges + (from->pred_edge_toward_source - e0) : 0;
+    to->leaving_edge_list_root =
+      from->leaving_edge_list_root ? _edges + (from->leaving_edge_list_root - e0) : 0;
+    to->heap_slot = _heap + (from->heap_slot - graph->_heap);
+    _heap[k] = _vertices + (graph->_heap[k] - v0);
+    _dp_order[k] = _vertices + (graph->_dp_order[k] - v0);
+  }
+  _acyclic = graph->_acyclic;
+}
+
+void MTPGraph::allocate(index_t nb_vertices, index_t nb_edges,
+                        index_t source, index_t sink, MTPStats *stats,
+                        const StoragePolicy *storage) {
   _nb_vertices = nb_vertices;
   _nb_edges = nb_edges;
 
-  _edges = new Edge[_nb_edges];
-  _vertices = new Vertex[_nb_vertices];
-  _heap = new Vertex *[_nb_vertices];
-  _dp_order = new Vertex *[_nb_vertices];
+  _storage_directory = 0;
+  if(storage) {
+    _storage = *storage;
+    if(storage->directory) {
+      _storage_directory = new char[strlen(storage->directory) + 1];
+      strcpy(_storage_directory, storage->directory);
+    }
+  }
+  _storage.directory = _storage_directory;
+
+  _edges = (Edge *) storage_allocate(sizeof(Edge) * size_t(_nb_edges), &_storage);
+  _vertices = (Vertex *) storage_allocate(sizeof(Vertex) * size_t(_nb_vertices), &_storage);
+  _heap = (Vertex **) storage_allocate(sizeof(Vertex *) * size_t(_nb_vertices), &_storage);
+  _dp_order = (Vertex **) storage_allocate(sizeof(Vertex *) * size_t(_nb_vertices), &_storage);
+
+  for(index_t v = 0; v < _nb_vertices; v++) new (&_vertices[v]) Vertex();
 
   _source = &_vertices[source];
   _sink = &_vertices[sink];
 
-  for(int e = 0; e < nb_edges; e++) {
-    _vertices[vertex_from[e]].add_leaving_edge(&_edges[e]);
-    _edges[e].occupied = 0;
-    _edges[e].origin_vertex = &_vertices[vertex_from[e]];
-    _edges[e].terminal_vertex = &_vertices[vertex_to[e]];
-  }
-
-  for(int v = 0; v < _nb_vertices; v++) {
+  for(index_t v = 0; v < _nb_vertices; v++) {
     _heap[v] = &_vertices[v];
     _vertices[v].heap_slot = &_heap[v];
   }
@@ -166,22 +239,587 @@ MTPGraph::MTPGraph(int nb_vertices, int nb_edges,
   paths = 0;
   nb_paths = 0;
 
-  compute_dp_ordering();
+  _stats = stats;
+
+  _deadline = 0;
+  _cancel = 0;
+  interrupted = 0;
+  _nb_initial_paths = 0;
+  _nb_initial_edges = 0;
+  _initial_edges = 0;
+
+  _checkpoint_file = 0;
+  _resume_file = 0;
+  _checkpoint_period = 0;
+  _checkpoint_request = 0;
+  total_length = 0;
+
+  _acyclic = 1;
+  _nb_threads = 0;
+
+  _incremental = 0;
+  _in_region = 0;
+
+  _bidirectional = 0;
+  _entering_edge_list_root = 0;
+  _next_entering_edge = 0;
+  _pred_entering_edge = 0;
+  _distance_to_sink = 0;
+  _edge_toward_sink = 0;
+  _backward_heap = 0;
+  _backward_slot = 0;
+}
+
+void MTPGraph::set_edge(index_t e, index_t from, index_t to) {
+  _vertices[from].add_leaving_edge(&_edges[e]);
+  _edges[e].occupied = 0;
+  _edges[e].length = 0;
+  _edges[e].origin_vertex = &_vertices[from];
+  _edges[e].terminal_vertex = &_vertices[to];
+}
+
+void MTPGraph::end_construction(int in_topological_order) {
+  if(_stats) _stats->begin_phase(PHASE_DP_ORDERING);
+  if(in_topological_order) {
+#ifdef DEBUG
+    for(index_t k = 0; k < _nb_edges; k++) {
+      ASSERT(_edges[k].origin_vertex < _edges[k].terminal_vertex);
+    }
+#endif
+    for(index_t v = 0; v < _nb_vertices; v++) _dp_order[v] = &_vertices[v];
+    _acyclic = 1;
+  } else {
+    compute_dp_ordering();
+  }
+  if(_stats) _stats->end_phase(PHASE_DP_ORDERING, 0);
 }
 
 MTPGraph::~MTPGraph() {
-  delete[] _vertices;
-  delete[] _dp_order;
-  delete[] _heap;
-  delete[] _edges;
+  // Vertex and Edge have trivial destructors
+  storage_free(_vertices, sizeof(Vertex) * size_t(_nb_vertices), &_storage);
+  storage_free(_dp_order, sizeof(Vertex *) * size_t(_nb_vertices), &_storage);
+  storage_free(_heap, sizeof(Vertex *) * size_t(_nb_vertices), &_storage);
+  storage_free(_edges, sizeof(Edge) * size_t(_nb_edges), &_storage);
+  storage_free(_in_region, size_t(_nb_vertices), &_storage);
+  storage_free(_entering_edge_list_root, sizeof(Edge *) * size_t(_nb_vertices), &_storage);
+  storage_free(_next_entering_edge, sizeof(Edge *) * size_t(_nb_edges), &_storage);
+  storage_free(_pred_entering_edge, sizeof(Edge *) * size_t(_nb_edges), &_storage);
+  storage_free(_distance_to_sink, sizeof(scalar_t) * size_t(_nb_vertices), &_storage);
+  storage_free(_edge_toward_sink, sizeof(Edge *) * size_t(_nb_vertices), &_storage);
+  storage_free(_backward_heap, sizeof(index_t) * size_t(_nb_vertices), &_storage);
+  storage_free(_backward_slot, sizeof(index_t) * size_t(_nb_vertices), &_storage);
+  delete[] _storage_directory;
+  delete[] _initial_edges;
   for(int p = 0; p < nb_paths; p++) delete paths[p];
   delete[] paths;
 }
 
+size_t MTPGraph::vertex_bytes() {
+  return sizeof(Vertex);
+}
+
+size_t MTPGraph::edge_bytes() {
+  return sizeof(Edge);
+}
+
+size_t MTPGraph::bidirectional_vertex_bytes() {
+  return 2 * sizeof(Edge *) + sizeof(scalar_t) + 2 * sizeof(index_t);
+}
+
+size_t MTPGraph::bidirectional_edge_bytes() {
+  return 2 * sizeof(Edge *);
+}
+
+void MTPGraph::set_stats(MTPStats *stats) {
+  _stats = stats;
+}
+
+void MTPGraph::set_incremental(int incremental) {
+  _incremental = incremental;
+  if(_incremental && !_in_region) {
+    _in_region = (char *) storage_allocate(size_t(_nb_vertices), &_storage);
+    for(index_t v = 0; v < _nb_vertices; v++) _in_region[v] = 0;
+  }
+}
+
+void MTPGraph::set_bidirectional(int bidirectional) {
+  _bidirectional = bidirectional;
+  if(_bidirectional && !_entering_edge_list_root) {
+    _entering_edge_list_root =
+      (Edge **) storage_allocate(sizeof(Edge *) * size_t(_nb_vertices), &_storage);
+    _next_entering_edge =
+      (Edge **) storage_allocate(sizeof(Edge *) * size_t(_nb_edges), &_storage);
+    _pred_entering_edge =
+      (Edge **) storage_allocate(sizeof(Edge *) * size_t(_nb_edges), &_storage);
+    _distance_to_sink =
+      (scalar_t *) storage_allocate(sizeof(scalar_t) * size_t(_nb_vertices), &_storage);
+    _edge_toward_sink =
+      (Edge **) storage_allocate(sizeof(Edge *) * size_t(_nb_vertices), &_storage);
+    _backward_heap =
+      (index_t *) storage_allocate(sizeof(index_t) * size_t(_nb_vertices), &_storage);
+    _backward_slot =
+      (index_t *) storage_allocate(sizeof(index_t) * size_t(_nb_vertices), &_storage);
+
+    for(index_t v = 0; v < _nb_vertices; v++) {
+      _entering_edge_list_root[v] = 0;
+      _backward_heap[v] = v;
+      _backward_slot[v] = v;
+    }
+    // In the reverse order, so that the entering edges are visited in
+    // increasing order
+    for(index_t k = _nb_edges - 1; k >= 0; k--) add_entering_edge(&_edges[k]);
+  }
+}
+
+void MTPGraph::set_nb_threads(int nb_threads) {
+  _nb_threads = nb_threads;
+}
+
+void MTPGraph::set_interruption(double deadline, const atomic<bool> *cancel) {
+  _deadline = deadline;
+  _cancel = cancel;
+}
+
+int MTPGraph::should_stop() {
+  if(_cancel && _cancel->load(memory_order_relaxed)) {
+    interrupted = 1;
+    if(_stats) _stats->stop_reason = STOP_CANCELLED;
+  } else if(_deadline > 0 && now_in_seconds() > _deadline) {
+    interrupted = 1;
+    if(_stats) _stats->stop_reason = STOP_DEADLINE;
+  }
+  return interrupted;
+}
+
+void MTPGraph::set_checkpoint(const char *filename, double period, atomic<bool> *request) {
+  _checkpoint_file = filename;
+  _checkpoint_period = period;
+  _checkpoint_request = request;
+}
+
+void MTPGraph::set_resume(const char *filename) {
+  _resume_file = filename;
+}
+
+int MTPGraph::set_initial_paths(int nb_paths, const index_t *first, const index_t *nodes) {
+  index_t nb_edges = 0, n, from, to;
+  int error = 0;
+  Edge *e;
+
+  delete[] _initial_edges;
+  _initial_edges = 0;
+  _nb_initial_edges = 0;
+  _nb_initial_paths = 0;
+
+  if(nb_paths <= 0) return 0;
+
+  index_t *edges = new index_t[first[nb_paths] - first[0]];
+
+  for(int p = 0; p < nb_paths && !error; p++) {
+    if(first[p + 1] - first[p] < 2 ||
+       nodes[first[p]] != _source - _vertices ||
+       nodes[first[p + 1] - 1] != _sink - _vertices) {
+      error = 1;
+    }
+    for(n = first[p]; n + 1 < first[p + 1] && !error; n++) {
+      from = nodes[n];
+      to = nodes[n + 1];
+      if(from < 0 || from >= _nb_vertices || to < 0 || to >= _nb_vertices) {
+        error = 1;
+      } else {
+        e = _vertices[from].leaving_edge_list_root;
+        while(e && e->terminal_vertex != &_vertices[to]) e = e->next_leaving_edge;
+        if(e) edges[nb_edges++] = e - _edges;
+        else error = 1;
+      }
+    }
+  }
+
+  // No edge twice
+  if(!error) {
+    sort(edges, edges + nb_edges);
+    for(n = 1; n < nb_edges; n++) if(edges[n] == edges[n - 1]) error = 1;
+  }
+
+  if(error) {
+    delete[] edges;
+    return -1;
+  }
+
+  _nb_initial_paths = nb_paths;
+  _nb_initial_edges = nb_edges;
+  _initial_edges = edges;
+  return 0;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+// Relative decrease of a distance under which Bellman-Ford does not
+// update it, so that rounding errors do not make cycles of length
+// zero look negative
+static const scalar_t BELLMAN_FORD_TOLERANCE = 1e-6f;
+
+static int relax(Edge *e) {
+  Vertex *v = e->origin_vertex, *tv = e->terminal_vertex;
+  if(v->distance_from_source == FLT_MAX) return 0;
+  scalar_t d = v->distance_from_source + e->length;
+  scalar_t current = tv->distance_from_source;
+  if(current < FLT_MAX && d >= current - BELLMAN_FORD_TOLERANCE * (1 + fabs(current))) return 0;
+  tv->distance_from_source = d;
+  tv->pred_edge_toward_source = e;
+  return 1;
+}
+
+// The vertices of the predecessor graph, while it is searched for
+// cycles
+static const index_t WALK_UNKNOWN = -1, WALK_ROOTED = -2, WALK_STALE = -3;
+
+int MTPGraph::bellman_ford(Vertex *start) {
+  index_t *walk = new index_t[_nb_vertices];
+  Vertex **cycles = new Vertex *[_nb_vertices];
+  scalar_t initial = start ? FLT_MAX : 0;
+  index_t nb_cycles;
+  int nb_cancelled = 0, changed = 1;
+  Vertex *v, *w;
+
+  for(index_t k = 0; k < _nb_vertices; k++) {
+    _vertices[k].distance_from_source = initial;
+    _vertices[k].pred_edge_toward_source = 0;
+  }
+  if(start) start->distance_from_source = 0;
+
+  while(changed) {
+    changed = 0;
+    for(index_t k = 0; k < _nb_edges; k++) changed |= relax(&_edges[k]);
+    for(index_t k = _nb_edges - 1; k >= 0; k--) changed |= relax(&_edges[k]);
+
+    if(!changed) break;
+
+    // A cycle of the predecessor graph has a negative length. Every
+    // vertex has a single predecessor, so the cycles are disjoint,
+    // and we find them all by following the predecessors from every
+    // vertex, marking the walk with the vertex it started from, until
+    // a vertex which is not on it or one of its own. The vertices of
+    // a walk are then marked as rooted if it ended without a cycle,
+    // and as stale otherwise.
+    nb_cycles = 0;
+    for(index_t k = 0; k < _nb_vertices; k++) walk[k] = WALK_UNKNOWN;
+    for(index_t k = 0; k < _nb_vertices; k++) {
+      if(walk[k] != WALK_UNKNOWN) continue;
+      v = &_vertices[k];
+      while(v && walk[v - _vertices] == WALK_UNKNOWN) {
+        walk[v - _vertices] = k;
+        v = v->pred_edge_toward_source ? v->pred_edge_toward_source->origin_vertex : 0;
+      }
+      index_t end = WALK_ROOTED;
+      if(v && walk[v - _vertices] == k) {
+        cycles[nb_cycles++] = v;
+        end = WALK_STALE;
+      } else if(v) {
+        end = walk[v - _vertices];
+      }
+      w = &_vertices[k];
+      while(w && walk[w - _vertices] == k) {
+        walk[w - _vertices] = end;
+        w = w->pred_edge_toward_source ? w->pred_edge_toward_source->origin_vertex : 0;
+      }
+    }
+
+    // We cancel all the cycles, and start again from the distances of
+    // the vertices whose predecessors do not go through one, which
+    // are still those of paths of the residual graph
+    if(nb_cycles > 0) {
+      for(index_t c = 0; c < nb_cycles; c++) cancel_cycle(cycles[c]);
+      nb_cancelled += int(nb_cycles);
+      for(index_t k = 0; k < _nb_vertices; k++) {
+        if(walk[k] == WALK_STALE) {
+          _vertices[k].distance_from_source = initial;
+          _vertices[k].pred_edge_toward_source = 0;
+        }
+      }
+      if(start) start->distance_from_source = 0;
+    }
+  }
+
+  delete[] cycles;
+  delete[] walk;
+  return nb_cancelled;
+}
+
+void MTPGraph::cancel_cycle(Vertex *v) {
+  Vertex *w = v;
+  Edge *e;
+  do {
+    e = w->pred_edge_toward_source;
+    w = e->origin_vertex;
+    invert_edge(e);
+    e->occupied = 1 - e->occupied;
+  } while(w != v);
+  if(_stats) _stats->nb_cancelled_cycles++;
+}
+
+int MTPGraph::start_from_initial_paths(int max_nb_paths, scalar_t min_gain, int exact_nb_paths) {
+  int nb_paths = _nb_initial_paths, too_many;
+  Vertex *v;
+  Edge *e;
+
+  for(index_t k = 0; k < _nb_initial_edges; k++) {
+    e = &_edges[_initial_edges[k]];
+    invert_edge(e);
+    e->occupied = 1;
+  }
+
+  // The flow is then the best one of that value
+  bellman_ford(0);
+
+  // The best path to remove is the shortest one from the sink back to
+  // the source, and the decrease of the total length the last path
+  // brought is its length. Since that decrease only grows as paths are
+  // removed, we can stop at the first one we keep.
+  while(nb_paths > 0) {
+    too_many = max_nb_paths > 0 && nb_paths > max_nb_paths;
+    if(exact_nb_paths && !too_many) break;
+    bellman_ford(_sink);
+    if(!_source->pred_edge_toward_source) break;
+    if(!too_many && _source->distance_from_source > min_gain) break;
+    v = _source;
+    while(v != _sink) {
+      e = v->pred_edge_toward_source;
+      v = e->origin_vertex;
+      invert_edge(e);
+      e->occupied = 1 - e->occupied;
+    }
+    nb_paths--;
+    if(_stats) _stats->nb_removed_paths++;
+  }
+
+  // The distances from the source, which make the lengths non-negative
+  // for the Dijkstra to come
+  bellman_ford(_source);
+
+  // The occupied edges are inverted
+  total_length = 0;
+  for(index_t k = 0; k < _nb_edges; k++) {
+    if(_edges[k].occupied) total_length -= _edges[k].length;
+  }
+
+  return nb_paths;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+static const char CHECKPOINT_MAGIC[8] = { 'M', 'T', 'P', 'C', 'K', 'P', 'T', '1' };
+
+template<class T>
+static void write_value(ostream *os, T x) {
+  os->write((const char *) &x, sizeof(x));
+}
+
+template<class T>
+static T read_value(istream *is) {
+  T x = 0;
+  is->read((char *) &x, sizeof(x));
+  return x;
+}
+
+static void hash_bytes(uint64_t *h, const void *data, size_t size) {
+  // FNV-1a
+  for(size_t k = 0; k < size; k++) {
+    *h = (*h ^ ((const unsigned char *) data)[k]) * 1099511628211ULL;
+  }
+}
+
+uint64_t MTPGraph::edge_hash() {
+  uint64_t h = 14695981039346656037ULL;
+  for(index_t k = 0; k < _nb_edges; k++) {
+    Edge *e = &_edges[k];
+    index_t from = e->origin_vertex - _vertices, to = e->terminal_vertex - _vertices;
+    scalar_t length = e->length;
+    if(e->occupied) { swap(from, to); length = - length; }
+    hash_bytes(&h, &from, sizeof(from));
+    hash_bytes(&h, &to, sizeof(to));
+    hash_bytes(&h, &length, sizeof(length));
+  }
+  return h;
+}
+
+void MTPGraph::write_checkpoint(int nb_augmentations, scalar_t sink_potential, int repair) {
+  char *tmp_name = new char[strlen(_checkpoint_file) + 5];
+  strcpy(tmp_name, _checkpoint_file);
+  strcat(tmp_name, ".tmp");
+
+  ofstream out(tmp_name, ios::binary);
+  out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+  write_value<index_t>(&out, _nb_vertices);
+  write_value<index_t>(&out, _nb_edges);
+  write_value<uint64_t>(&out, edge_hash());
+  write_value<char>(&out, char(_incremental));
+  write_value<char>(&out, char(_bidirectional));
+  write_value<int>(&out, nb_augmentations);
+  write_value<int>(&out, repair);
+  write_value<scalar_t>(&out, sink_potential);
+  write_value<scalar_t>(&out, total_length);
+
+  for(index_t k = 0; k < _nb_edges; k++) {
+    Edge *e = &_edges[k];
+    write_value<char>(&out, char(e->occupied));
+    write_value<scalar_t>(&out, e->positivized_length);
+    write_value<index_t>(&out, e->next_leaving_edge ? e->next_leaving_edge - _edges : -1);
+  }
+
+  for(index_t k = 0; k < _nb_vertices; k++) {
+    Vertex *v = &_vertices[k];
+    write_value<scalar_t>(&out, v->distance_from_source);
+    write_value<index_t>(&out, v->pred_edge_toward_source ? v->pred_edge_toward_source - _edges : -1);
+    write_value<index_t>(&out, v->leaving_edge_list_root ? v->leaving_edge_list_root - _edges : -1);
+    write_value<index_t>(&out, _heap[k] - _vertices);
+  }
+
+  if(_incremental) {
+    out.write(_in_region, _nb_vertices);
+  }
+
+  if(_bidirectional) {
+    for(index_t k = 0; k < _nb_edges; k++) {
+      write_value<index_t>(&out, _next_entering_edge[k] ? _next_entering_edge[k] - _edges : -1);
+    }
+    for(index_t k = 0; k < _nb_vertices; k++) {
+      write_value<index_t>(&out, _entering_edge_list_root[k] ? _entering_edge_list_root[k] - _edges : -1);
+      write_value<index_t>(&out, _backward_heap[k]);
+    }
+  }
+
+  out.close();
+
+  // A failed checkpoint is not a reason to stop the solve
+  if(!out || rename(tmp_name, _checkpoint_file) != 0) {
+    cerr << "Can not write the checkpoint " << _checkpoint_file << "." << endl;
+    remove(tmp_name);
+  }
+  delete[] tmp_name;
+}
+
+// Reads an edge or vertex index, -1 for none, and aborts if it is
+// out of [-1, nb[
+static index_t read_index(istream *is, index_t nb) {
+  index_t k = read_value<index_t>(is);
+  if(k < -1 || k >= nb) {
+    cerr << "Inconsistent checkpoint." << endl;
+    abort();
+  }
+  return k;
+}
+
+void MTPGraph::read_checkpoint(int *nb_augmentations, scalar_t *sink_potential, int *repair) {
+  char magic[sizeof(CHECKPOINT_MAGIC)];
+  index_t k, n;
+  Edge *e;
+
+  ifstream in(_resume_file, ios::binary);
+  if(in.fail()) {
+    cerr << "Can not open the checkpoint " << _resume_file << "." << endl;
+    abort();
+  }
+
+  in.read(magic, sizeof(magic));
+  if(!in || memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0) {
+    cerr << _resume_file << " is not a checkpoint." << endl;
+    abort();
+  }
+
+  // The edges are all in their original direction at this point
+  if(read_value<index_t>(&in) != _nb_vertices ||
+     read_value<index_t>(&in) != _nb_edges ||
+     read_value<uint64_t>(&in) != edge_hash()) {
+    cerr << "The checkpoint " << _resume_file << " is for another graph or other scores." << endl;
+    abort();
+  }
+
+  if(read_value<char>(&in) != char(_incremental) ||
+     read_value<char>(&in) != char(_bidirectional)) {
+    cerr << "The checkpoint " << _resume_file
+         << " was written with other incremental or bidirectional settings." << endl;
+    abort();
+  }
+
+  *nb_augmentations = read_value<int>(&in);
+  *repair = read_value<int>(&in);
+  *sink_potential = read_value<scalar_t>(&in);
+  total_length = read_value<scalar_t>(&in);
+
+  // The edge lists are restored as they were, instead of with the
+  // inversions, since the order of their edges depends on the order
+  // of the inversions
+  for(k = 0; k < _nb_edges; k++) {
+    e = &_edges[k];
+    e->occupied = read_value<char>(&in);
+    if(e->occupied) {
+      e->length = - e->length;
+      swap(e->origin_vertex, e->terminal_vertex);
+    }
+    e->positivized_length = read_value<scalar_t>(&in);
+    n = read_index(&in, _nb_edges);
+    e->next_leaving_edge = n >= 0 ? &_edges[n] : 0;
+    e->pred_leaving_edge = 0;
+  }
+
+  for(k = 0; k < _nb_vertices; k++) {
+    Vertex *v = &_vertices[k];
+    v->distance_from_source = read_value<scalar_t>(&in);
+    n = read_index(&in, _nb_edges);
+    v->pred_edge_toward_source = n >= 0 ? &_edges[n] : 0;
+    n = read_index(&in, _nb_edges);
+    v->leaving_edge_list_root = n >= 0 ? &_edges[n] : 0;
+    n = read_index(&in, _nb_vertices);
+    if(n < 0) {
+      cerr << "Inconsistent checkpoint." << endl;
+      abort();
+    }
+    _heap[k] = &_vertices[n];
+    _vertices[n].heap_slot = &_heap[k];
+  }
+
+  for(k = 0; k < _nb_edges; k++) {
+    e = &_edges[k];
+    if(e->next_leaving_edge) e->next_leaving_edge->pred_leaving_edge = e;
+  }
+
+  if(_incremental) {
+    in.read(_in_region, _nb_vertices);
+  }
+
+  if(_bidirectional) {
+    for(k = 0; k < _nb_edges; k++) {
+      n = read_index(&in, _nb_edges);
+      _next_entering_edge[k] = n >= 0 ? &_edges[n] : 0;
+      _pred_entering_edge[k] = 0;
+    }
+    for(k = 0; k < _nb_edges; k++) {
+      if(_next_entering_edge[k]) _pred_entering_edge[_next_entering_edge[k] - _edges] = &_edges[k];
+    }
+    for(k = 0; k < _nb_vertices; k++) {
+      n = read_index(&in, _nb_edges);
+      _entering_edge_list_root[k] = n >= 0 ? &_edges[n] : 0;
+      n = read_index(&in, _nb_vertices);
+      if(n < 0) {
+        cerr << "Inconsistent checkpoint." << endl;
+        abort();
+      }
+      _backward_heap[k] = n;
+      _backward_slot[n] = k;
+    }
+  }
+
+  if(!in) {
+    cerr << "The checkpoint " << _resume_file << " is truncated." << endl;
+    abort();
+  }
+}
+
 //////////////////////////////////////////////////////////////////////
 
 void MTPGraph::print(ostream *os) {
-  for(int k = 0; k < _nb_edges; k++) {
+  for(index_t k = 0; k < _nb_edges; k++) {
     Edge *e = &_edges[k];
     (*os) << e->origin_vertex - _vertices
           << " -> "
@@ -199,7 +837,7 @@ void MTPGraph::print_dot(ostream *os) {
   (*os) << "        edge [color=gray,arrowhead=open]" << endl;
   (*os) << "        " << _source - _vertices << " [peripheries=2];" << endl;
   (*os) << "        " << _sink - _vertices << " [peripheries=2];" << endl;
-  for(int k = 0; k < _nb_edges; k++) {
+  for(index_t k = 0; k < _nb_edges; k++) {
     Edge *e = &_edges[k];
     (*os) << "        "
           << e->origin_vertex - _vertices
@@ -216,33 +854,119 @@ void MTPGraph::print_dot(ostream *os) {
 
 //////////////////////////////////////////////////////////////////////
 
+void MTPGraph::add_entering_edge(Edge *e) {
+  index_t k = e - _edges, v = e->terminal_vertex - _vertices;
+  _next_entering_edge[k] = _entering_edge_list_root[v];
+  _pred_entering_edge[k] = 0;
+  if(_entering_edge_list_root[v]) {
+    _pred_entering_edge[_entering_edge_list_root[v] - _edges] = e;
+  }
+  _entering_edge_list_root[v] = e;
+}
+
+void MTPGraph::del_entering_edge(Edge *e) {
+  index_t k = e - _edges, v = e->terminal_vertex - _vertices;
+  if(e == _entering_edge_list_root[v]) {
+    _entering_edge_list_root[v] = _next_entering_edge[k];
+  }
+  if(_pred_entering_edge[k]) {
+    _next_entering_edge[_pred_entering_edge[k] - _edges] = _next_entering_edge[k];
+  }
+  if(_next_entering_edge[k]) {
+    _pred_entering_edge[_next_entering_edge[k] - _edges] = _pred_entering_edge[k];
+  }
+}
+
+void MTPGraph::invert_edge(Edge *e) {
+  if(_entering_edge_list_root) del_entering_edge(e);
+  e->invert();
+  if(_entering_edge_list_root) add_entering_edge(e);
+}
+
+int MTPGraph::decrease_distance_to_sink(index_t v) {
+  index_t h = _backward_slot[v], p;
+  scalar_t d = _distance_to_sink[v];
+  int nb_swaps = 0;
+  while(h > 0) {
+    p = ((h + 1) >> 1) - 1;
+    if(_distance_to_sink[_backward_heap[p]] <= d) break;
+    _backward_heap[h] = _backward_heap[p];
+    _backward_slot[_backward_heap[h]] = h;
+    h = p;
+    nb_swaps++;
+  }
+  _backward_heap[h] = v;
+  _backward_slot[v] = h;
+  return nb_swaps;
+}
+
+int MTPGraph::increase_distance_to_sink(index_t v, index_t heap_size) {
+  index_t h = _backward_slot[v], c;
+  scalar_t d = _distance_to_sink[v];
+  int nb_swaps = 0;
+  while(1) {
+    c = 2 * h + 1;
+    if(c >= heap_size) break;
+    if(c + 1 < heap_size &&
+       _distance_to_sink[_backward_heap[c + 1]] < _distance_to_sink[_backward_heap[c]]) c++;
+    if(_distance_to_sink[_backward_heap[c]] >= d) break;
+    _backward_heap[h] = _backward_heap[c];
+    _backward_slot[_backward_heap[h]] = h;
+    h = c;
+    nb_swaps++;
+  }
+  _backward_heap[h] = v;
+  _backward_slot[v] = h;
+  return nb_swaps;
+}
+
+//////////////////////////////////////////////////////////////////////
+
 void MTPGraph::update_positivized_lengths() {
-  for(int k = 0; k < _nb_edges; k++) {
+  for(index_t k = 0; k < _nb_edges; k++) {
     Edge *e = &_edges[k];
     e->positivized_length +=
       e->origin_vertex->distance_from_source - e->terminal_vertex->distance_from_source;
   }
 }
 
-void MTPGraph::force_positivized_lengths() {
-#ifdef VERBOSE
+scalar_t MTPGraph::force_positivized_lengths() {
   scalar_t residual_error = 0.0;
   scalar_t max_error = 0.0;
-#endif
-  for(int k = 0; k < _nb_edges; k++) {
+  for(index_t k = 0; k < _nb_edges; k++) {
     Edge *e = &_edges[k];
 
     if(e->positivized_length < 0) {
-#ifdef VERBOSE
       residual_error -= e->positivized_length;
       max_error = max(max_error, - e->positivized_length);
-#endif
       e->positivized_length = 0.0;
     }
   }
 #ifdef VERBOSE
   cerr << __FILE__ << ": residual_error " << residual_error << " max_error " << max_error << endl;
 #endif
+  if(_stats) {
+    _stats->residual_clamp_total += residual_error;
+    _stats->residual_clamp_max = max(_stats->residual_clamp_max, max_error);
+  }
+  return residual_error;
+}
+
+// Number of vertices of the DP order to prefetch at once with a
+// file-backed storage
+static const index_t DP_WINDOW = 65536;
+
+void MTPGraph::prefetch_dp_window(index_t first, index_t nb) {
+  if(first >= _nb_vertices) return;
+  index_t end = min(first + nb, _nb_vertices);
+  // The DP order follows the time, so these vertices are within a
+  // short range of addresses when they are numbered in time order
+  Vertex *v_min = _dp_order[first], *v_max = _dp_order[first];
+  for(index_t k = first + 1; k < end; k++) {
+    v_min = min(v_min, _dp_order[k]);
+    v_max = max(v_max, _dp_order[k]);
+  }
+  storage_will_need(v_min, size_t(v_max + 1 - v_min) * sizeof(Vertex), &_storage);
 }
 
 void MTPGraph::dp_compute_distances() {
@@ -250,14 +974,18 @@ void MTPGraph::dp_compute_distances() {
   Edge *e;
   scalar_t d;
 
-  for(int k = 0; k < _nb_vertices; k++) {
+  for(index_t k = 0; k < _nb_vertices; k++) {
     _vertices[k].distance_from_source = FLT_MAX;
     _vertices[k].pred_edge_toward_source = 0;
   }
 
   _source->distance_from_source = 0;
 
-  for(int k = 0; k < _nb_vertices; k++) {
+  for(index_t k = 0; k < _nb_vertices; k++) {
+    // Bring in the next window while we visit this one
+    if(_storage.directory && k % DP_WINDOW == 0) {
+      prefetch_dp_window(k + DP_WINDOW, DP_WINDOW);
+    }
     v = _dp_order[k];
     for(e = v->leaving_edge_list_root; e; e = e->next_leaving_edge) {
       d = v->distance_from_source + e->positivized_length;
@@ -270,77 +998,626 @@ void MTPGraph::dp_compute_distances() {
   }
 }
 
+// Number of consecutive vertices of the DP order that
+// label_correcting_distances updates together. It does not depend on
+// the number of threads, so that neither does the result.
+static const index_t LABEL_CORRECTING_BLOCK_SIZE = 256;
+
+// Makes the threads of label_correcting_distances wait for each other
+// between the steps of an update
+class LabelCorrectingBarrier {
+  mutex _mutex;
+  condition_variable _condition;
+  int _nb_threads, _nb_waiting;
+  long _generation;
+public:
+  LabelCorrectingBarrier(int nb_threads) {
+    _nb_threads = nb_threads;
+    _nb_waiting = 0;
+    _generation = 0;
+  }
+
+  void wait() {
+    unique_lock<mutex> lock(_mutex);
+    long generation = _generation;
+    if(++_nb_waiting == _nb_threads) {
+      _nb_waiting = 0;
+      _generation++;
+      _condition.notify_all();
+    } else {
+      _condition.wait(lock, [this, generation] { return _generation != generation; });
+    }
+  }
+};
+
+// The state of label_correcting_distances, shared by the threads. An
+// update computes the distances of its candidates from the current
+// ones, stores them in next_distances at the position of the
+// candidate, and they are applied once all are done.
+struct LabelCorrectingUpdate {
+  Vertex *vertices;
+  index_t *first_entering;
+  Edge **entering;
+  scalar_t *distances, *next_distances;
+  index_t nb_candidates, *candidates;
+  char *improved;
+  int nb_threads, done;
+  LabelCorrectingBarrier *barrier;
+};
+
+// Updates the candidates in [first, last[ from the edges entering them
+static void label_correcting_update(LabelCorrectingUpdate *update, index_t first, index_t last) {
+  scalar_t d, best;
+  Edge *e;
+  for(index_t c = first; c < last; c++) {
+    index_t v = update->candidates[c];
+    best = update->distances[v];
+    e = 0;
+    for(index_t k = update->first_entering[v]; k < update->first_entering[v + 1]; k++) {
+      index_t u = update->entering[k]->origin_vertex - update->vertices;
+      if(update->distances[u] < FLT_MAX) {
+        d = update->distances[u] + update->entering[k]->positivized_length;
+        // The same tolerance as Bellman-Ford, for the cycles of length
+        // zero
+        if(best == FLT_MAX || d < best - BELLMAN_FORD_TOLERANCE * (1 + fabs(best))) {
+          best = d;
+          e = update->entering[k];
+        }
+      }
+    }
+    update->next_distances[c] = best;
+    update->improved[c] = e != 0;
+    if(e) update->vertices[v].pred_edge_toward_source = e;
+  }
+}
+
+// The share of thread t of every update, until the last one
+static void label_correcting_worker(LabelCorrectingUpdate *update, int t) {
+  for(;;) {
+    update->barrier->wait();
+    if(update->done) return;
+    label_correcting_update(update,
+                            update->nb_candidates * t / update->nb_threads,
+                            update->nb_candidates * (t + 1) / update->nb_threads);
+    update->barrier->wait();
+  }
+}
+
+Vertex *MTPGraph::label_correcting_distances() {
+  LabelCorrectingUpdate update;
+  Vertex *v, *cycle = 0;
+  Edge *e;
+  index_t *mark, nb_pending = 0, nb_changes = 0;
+  char *pending;
+
+  int n = _nb_threads;
+  if(n <= 0) n = int(thread::hardware_concurrency());
+  if(n < 1) n = 1;
+  if(index_t(n) > LABEL_CORRECTING_BLOCK_SIZE) n = int(LABEL_CORRECTING_BLOCK_SIZE);
+
+  // The edges entering every vertex, in increasing order
+  update.vertices = _vertices;
+  update.first_entering = new index_t[_nb_vertices + 1];
+  update.entering = new Edge *[_nb_edges];
+  for(index_t k = 0; k <= _nb_vertices; k++) update.first_entering[k] = 0;
+  for(index_t k = 0; k < _nb_edges; k++) {
+    update.first_entering[_edges[k].terminal_vertex - _vertices + 1]++;
+  }
+  for(index_t k = 0; k < _nb_vertices; k++) {
+    update.first_entering[k + 1] += update.first_entering[k];
+  }
+  for(index_t k = 0; k < _nb_edges; k++) {
+    update.entering[update.first_entering[_edges[k].terminal_vertex - _vertices]++] = &_edges[k];
+  }
+  for(index_t k = _nb_vertices; k > 0; k--) update.first_entering[k] = update.first_entering[k - 1];
+  update.first_entering[0] = 0;
+
+  update.distances = new scalar_t[_nb_vertices];
+  update.next_distances = new scalar_t[LABEL_CORRECTING_BLOCK_SIZE];
+  update.candidates = new index_t[LABEL_CORRECTING_BLOCK_SIZE];
+  update.improved = new char[LABEL_CORRECTING_BLOCK_SIZE];
+  update.nb_threads = n;
+  update.done = 0;
+  update.barrier = new LabelCorrectingBarrier(n);
+
+  // The vertices with an entering edge whose origin changed since
+  // they were last updated
+  pending = new char[_nb_vertices];
+  mark = new index_t[_nb_vertices];
+
+  for(index_t k = 0; k < _nb_vertices; k++) {
+    update.distances[k] = FLT_MAX;
+    pending[k] = 0;
+    _vertices[k].pred_edge_toward_source = 0;
+  }
+  update.distances[_source - _vertices] = 0;
+  for(e = _source->leaving_edge_list_root; e; e = e->next_leaving_edge) {
+    index_t w = e->terminal_vertex - _vertices;
+    if(!pending[w]) { pending[w] = 1; nb_pending++; }
+  }
+
+  // The threads live as long as the computation, and wait on the
+  // barrier for the candidates of every update
+  thread *threads = new thread[n];
+  for(int t = 1; t < n; t++) threads[t] = thread(label_correcting_worker, &update, t);
+
+  // The vertices are visited in the DP order by blocks, each one
+  // updated until none of its vertices is pending, so that the
+  // distances go through the acyclic parts of the graph in a single
+  // sweep, as with the DP, and the sweeps are repeated until no
+  // vertex is pending.
+  while(nb_pending > 0 && !cycle) {
+    for(index_t first = 0; first < _nb_vertices && !cycle; first += LABEL_CORRECTING_BLOCK_SIZE) {
+      index_t last = min(first + LABEL_CORRECTING_BLOCK_SIZE, _nb_vertices);
+      for(;;) {
+        update.nb_candidates = 0;
+        for(index_t k = first; k < last; k++) {
+          index_t w = _dp_order[k] - _vertices;
+          if(pending[w]) {
+            pending[w] = 0;
+            nb_pending--;
+            update.candidates[update.nb_candidates++] = w;
+          }
+        }
+
+        if(update.nb_candidates == 0 || cycle) break;
+
+        update.barrier->wait();
+        label_correcting_update(&update, 0, update.nb_candidates / n);
+        update.barrier->wait();
+
+        for(index_t c = 0; c < update.nb_candidates; c++) {
+          if(update.improved[c]) {
+            index_t w = update.candidates[c];
+            update.distances[w] = update.next_distances[c];
+            nb_changes++;
+            for(e = _vertices[w].leaving_edge_list_root; e; e = e->next_leaving_edge) {
+              index_t x = e->terminal_vertex - _vertices;
+              if(!pending[x]) { pending[x] = 1; nb_pending++; }
+            }
+          }
+        }
+
+        // Without cycle of negative length, there are fewer changes
+        // than the square of the number of vertices, and until then a
+        // cycle of the predecessor graph has a negative length. We
+        // look for one as bellman_ford does, every time there were
+        // as many changes as vertices.
+        if(nb_changes >= _nb_vertices) {
+          nb_changes = 0;
+          for(index_t k = 0; k < _nb_vertices; k++) mark[k] = -1;
+          for(index_t k = 0; k < _nb_vertices && !cycle; k++) {
+            v = &_vertices[k];
+            while(v && mark[v - _vertices] < 0) {
+              mark[v - _vertices] = k;
+              v = v->pred_edge_toward_source ? v->pred_edge_toward_source->origin_vertex : 0;
+            }
+            if(v && mark[v - _vertices] == k) cycle = v;
+          }
+        }
+      }
+    }
+  }
+
+  update.done = 1;
+  update.barrier->wait();
+  for(int t = 1; t < n; t++) threads[t].join();
+
+  for(index_t k = 0; k < _nb_vertices; k++) {
+    _vertices[k].distance_from_source = update.distances[k];
+  }
+
+  delete[] threads;
+  delete[] mark;
+  delete[] pending;
+  delete update.barrier;
+  delete[] update.improved;
+  delete[] update.candidates;
+  delete[] update.next_distances;
+  delete[] update.distances;
+  delete[] update.entering;
+  delete[] update.first_entering;
+
+  return cycle;
+}
+
+index_t MTPGraph::repair_region() {
+  Vertex *v;
+  Edge *e;
+  index_t k, n;
+
+  // The vertices are in _heap in the reverse order Dijkstra settled
+  // them, so a vertex comes after its predecessor in the tree if we
+  // go backward. The ones which keep their tree are moved to the end,
+  // in the same order.
+
+  n = _nb_vertices;
+  for(k = _nb_vertices - 1; k >= 0; k--) {
+    v = _heap[k];
+    e = v->pred_edge_toward_source;
+    char *in_region = _in_region + (v - _vertices);
+    if(!*in_region && e && _in_region[e->origin_vertex - _vertices]) *in_region = 1;
+    if(*in_region) {
+      v->distance_from_source = FLT_MAX;
+      v->pred_edge_toward_source = 0;
+    } else {
+      // The unreachable vertices stay at FLT_MAX
+      if(e) v->distance_from_source = e->origin_vertex->distance_from_source + e->positivized_length;
+      else if(v == _source) v->distance_from_source = 0;
+      n--;
+      _heap[n] = v;
+      v->heap_slot = &_heap[n];
+    }
+  }
+
+  // The region goes in front, where its vertices form a heap since
+  // they are all at FLT_MAX
+  k = 0;
+  for(index_t i = 0; i < _nb_vertices; i++) {
+    if(_in_region[i]) {
+      _heap[k] = &_vertices[i];
+      _vertices[i].heap_slot = &_heap[k];
+      _in_region[i] = 0;
+      k++;
+    }
+  }
+
+  ASSERT(k == n);
+  return n;
+}
+
 // This method does not change the edge occupation. It only sets
 // properly, for every vertex, the fields distance_from_source and
 // pred_edge_toward_source.
 
-void MTPGraph::find_shortest_path() {
-  int heap_size;
+void MTPGraph::find_shortest_path(ShortestPathStats *stats, scalar_t bound, int repair) {
+  index_t heap_size;
+  int sink_settled = 0;
   Vertex *v, *tv, **last_slot;
   Edge *e;
   scalar_t d;
+  // Counted whether stats is null or not, it costs nothing
+  long long nb_pushes = 0, nb_pops = 0, nb_sift_steps = 0, nb_relaxations = 0;
+  long long nb_settled = 0;
+
+  if(repair) {
+    heap_size = repair_region();
+    // Start from the edges entering the region
+    Vertex **heap_bottom = _heap + heap_size;
+    for(index_t k = 0; k < _nb_edges; k++) {
+      e = &_edges[k];
+      v = e->origin_vertex;
+      tv = e->terminal_vertex;
+      if(tv->heap_slot < heap_bottom && v->heap_slot >= heap_bottom &&
+         v->distance_from_source < FLT_MAX) {
+        d = v->distance_from_source + e->positivized_length;
+        if(d < tv->distance_from_source) {
+          tv->distance_from_source = d;
+          tv->pred_edge_toward_source = e;
+          nb_sift_steps += tv->decrease_distance_in_heap(_heap);
+          nb_pushes++;
+        }
+      }
+    }
+  } else {
+    for(index_t k = 0; k < _nb_vertices; k++) {
+      _vertices[k].distance_from_source = FLT_MAX;
+      _vertices[k].pred_edge_toward_source = 0;
+    }
 
-  for(int k = 0; k < _nb_vertices; k++) {
-    _vertices[k].distance_from_source = FLT_MAX;
-    _vertices[k].pred_edge_toward_source = 0;
+    heap_size = _nb_vertices;
+    _source->distance_from_source = 0;
+    nb_sift_steps += _source->decrease_distance_in_heap(_heap);
+    nb_pushes++;
   }
 
-  heap_size = _nb_vertices;
-  _source->distance_from_source = 0;
-  _source->decrease_distance_in_heap(_heap);
-
   while(heap_size > 1) {
     // Get the closest to the source
     v = _heap[0];
 
+    // If the sink is not reached yet, it will be farther than that
+    if(!sink_settled && v->distance_from_source > bound) {
+      _sink->pred_edge_toward_source = 0;
+      break;
+    }
+
+    // Reading the clock is not free, so we check only once in a while
+    if((nb_pops & 4095) == 4095 && should_stop()) {
+      _sink->pred_edge_toward_source = 0;
+      break;
+    }
+    if(v == _sink) sink_settled = 1;
+
     // Remove it from the heap (swap it with the last_slot in the heap, and
     // update the distance of that one)
     heap_size--;
     last_slot = _heap + heap_size;
     swap(*_heap, *last_slot); swap((*_heap)->heap_slot, (*last_slot)->heap_slot);
-    (*_heap)->increase_distance_in_heap(_heap, last_slot);
+    nb_sift_steps += (*_heap)->increase_distance_in_heap(_heap, last_slot);
+    nb_pops++;
+    if(v->distance_from_source < FLT_MAX) nb_settled++;
 
     // Now update the neighbors of the node currently closest to the
     // source
     for(e = v->leaving_edge_list_root; e; e = e->next_leaving_edge) {
       d = v->distance_from_source + e->positivized_length;
       tv = e->terminal_vertex;
-      if(d < tv->distance_from_source) {
-        ASSERT(tv->heap_slot < last_slot);
+      nb_relaxations++;
+      // The vertices out of the heap are settled, or out of the
+      // region of a repair
+      if(d < tv->distance_from_source && tv->heap_slot < last_slot) {
         tv->distance_from_source = d;
         tv->pred_edge_toward_source = e;
-        tv->decrease_distance_in_heap(_heap);
+        nb_sift_steps += tv->decrease_distance_in_heap(_heap);
+        nb_pushes++;
       }
     }
   }
+
+  if(stats) {
+    stats->heap_pushes = nb_pushes;
+    stats->heap_pops = nb_pops;
+    stats->sift_steps = nb_sift_steps;
+    stats->relaxations = nb_relaxations;
+    stats->settled_vertices = nb_settled;
+  }
 }
 
-void MTPGraph::find_best_paths(scalar_t *lengths) {
-  scalar_t shortest_path_length;
+void MTPGraph::find_shortest_path_bidirectional(ShortestPathStats *stats, scalar_t bound) {
+  index_t heap_size = _nb_vertices, backward_size = _nb_vertices, w, u;
+  int forward_turn = 1;
+  Vertex *v, *tv, *x, **last_slot;
+  Edge *e, *meeting_edge = 0;
+  scalar_t d, mu = FLT_MAX, forward_top, backward_top;
+  long long nb_pushes = 0, nb_pops = 0, nb_sift_steps = 0, nb_relaxations = 0;
+  long long nb_settled = 0;
+
+  // Both heaps contain all the vertices, in whatever order the
+  // previous search left them, which is fine since they are all at
+  // FLT_MAX
+  for(index_t k = 0; k < _nb_vertices; k++) {
+    _vertices[k].distance_from_source = FLT_MAX;
+    _vertices[k].pred_edge_toward_source = 0;
+    _distance_to_sink[k] = FLT_MAX;
+    _edge_toward_sink[k] = 0;
+  }
+
+  _source->distance_from_source = 0;
+  nb_sift_steps += _source->decrease_distance_in_heap(_heap);
+  _distance_to_sink[_sink - _vertices] = 0;
+  nb_sift_steps += decrease_distance_to_sink(_sink - _vertices);
+  nb_pushes += 2;
+
+  while(1) {
+    forward_top = heap_size > 0 ? _heap[0]->distance_from_source : FLT_MAX;
+    backward_top = backward_size > 0 ? _distance_to_sink[_backward_heap[0]] : FLT_MAX;
+
+    // The paths not found yet are at least that long. The sum may
+    // overflow to infinity, which compares fine.
+    if(forward_top + backward_top >= mu) break;
+
+    if(forward_top + backward_top > bound) {
+      mu = FLT_MAX;
+      break;
+    }
+
+    if((nb_pops & 4095) == 4095 && should_stop()) {
+      mu = FLT_MAX;
+      break;
+    }
+
+    nb_pops++;
+
+    if(forward_turn) {
+      v = _heap[0];
+      heap_size--;
+      last_slot = _heap + heap_size;
+      swap(*_heap, *last_slot); swap((*_heap)->heap_slot, (*last_slot)->heap_slot);
+      nb_sift_steps += (*_heap)->increase_distance_in_heap(_heap, last_slot);
+      if(v->distance_from_source < FLT_MAX) nb_settled++;
+
+      for(e = v->leaving_edge_list_root; e; e = e->next_leaving_edge) {
+        d = v->distance_from_source + e->positivized_length;
+        tv = e->terminal_vertex;
+        w = tv - _vertices;
+        nb_relaxations++;
+        if(d < tv->distance_from_source && tv->heap_slot < last_slot) {
+          tv->distance_from_source = d;
+          tv->pred_edge_toward_source = e;
+          nb_sift_steps += tv->decrease_distance_in_heap(_heap);
+          nb_pushes++;
+        }
+        // The two searches meet on that edge
+        if(_backward_slot[w] >= backward_size && d + _distance_to_sink[w] < mu) {
+          mu = d + _distance_to_sink[w];
+          meeting_edge = e;
+        }
+      }
+    } else {
+      w = _backward_heap[0];
+      backward_size--;
+      _backward_heap[0] = _backward_heap[backward_size];
+      _backward_slot[_backward_heap[0]] = 0;
+      _backward_heap[backward_size] = w;
+      _backward_slot[w] = backward_size;
+      if(backward_size > 0) {
+        nb_sift_steps += increase_distance_to_sink(_backward_heap[0], backward_size);
+      }
+      if(_distance_to_sink[w] < FLT_MAX) nb_settled++;
+
+      for(e = _entering_edge_list_root[w]; e; e = _next_entering_edge[e - _edges]) {
+        d = _distance_to_sink[w] + e->positivized_length;
+        x = e->origin_vertex;
+        u = x - _vertices;
+        nb_relaxations++;
+        if(d < _distance_to_sink[u] && _backward_slot[u] < backward_size) {
+          _distance_to_sink[u] = d;
+          _edge_toward_sink[u] = e;
+          nb_sift_steps += decrease_distance_to_sink(u);
+          nb_pushes++;
+        }
+        if(x->heap_slot >= _heap + heap_size && x->distance_from_source + d < mu) {
+          mu = x->distance_from_source + d;
+          meeting_edge = e;
+        }
+      }
+    }
+
+    forward_turn = !forward_turn;
+  }
+
+  if(mu < FLT_MAX) {
+    // The path goes along the forward tree to the last vertex settled
+    // forward, and then along the backward one. Taking the last one
+    // avoids a cycle when a vertex of the backward part is before the
+    // meeting edge in the forward tree, which may happen with edges
+    // of length zero.
+    Vertex *last = 0;
+    for(tv = meeting_edge->terminal_vertex; ; tv = _edge_toward_sink[w]->terminal_vertex) {
+      w = tv - _vertices;
+      if(tv->heap_slot >= _heap + heap_size) last = tv;
+      if(tv == _sink) break;
+    }
+    if(!last) {
+      last = meeting_edge->terminal_vertex;
+      last->pred_edge_toward_source = meeting_edge;
+    }
+    for(tv = last; tv != _sink; tv = e->terminal_vertex) {
+      e = _edge_toward_sink[tv - _vertices];
+      e->terminal_vertex->pred_edge_toward_source = e;
+    }
+
+    for(index_t k = 0; k < _nb_vertices; k++) {
+      v = &_vertices[k];
+      if(v->heap_slot < _heap + heap_size) {
+        d = _backward_slot[k] >= backward_size ? _distance_to_sink[k] : backward_top;
+        v->distance_from_source = max(forward_top, mu - d);
+      }
+    }
+  } else {
+    _sink->pred_edge_toward_source = 0;
+  }
+
+  if(stats) {
+    stats->heap_pushes = nb_pushes;
+    stats->heap_pops = nb_pops;
+    stats->sift_steps = nb_sift_steps;
+    stats->relaxations = nb_relaxations;
+    stats->settled_vertices = nb_settled;
+  }
+}
+
+void MTPGraph::set_length(index_t e, scalar_t length) {
+  _edges[e].length = length;
+}
+
+void MTPGraph::find_best_paths(scalar_t *lengths,
+                               int max_nb_paths, scalar_t min_gain, int exact_nb_paths) {
+  scalar_t shortest_path_length, residual_clamp, sink_potential, bound;
   Vertex *v;
   Edge *e;
+  int path_nb_edges, augment, nb_augmentations = 0, repair = 0;
+  double next_checkpoint;
+  ShortestPathStats *path_stats;
 
-  for(int e = 0; e < _nb_edges; e++) {
-    _edges[e].length = lengths[e];
+  for(index_t e = 0; e < _nb_edges; e++) {
+    if(lengths) _edges[e].length = lengths[e];
     _edges[e].occupied = 0;
     _edges[e].positivized_length = _edges[e].length;
   }
 
-  // Compute the distance of all the nodes from the source by just
-  // visiting them in the proper DAG ordering we computed when
-  // building the graph
-  dp_compute_distances();
+  interrupted = 0;
+
+  if(_resume_file) {
+    read_checkpoint(&nb_augmentations, &sink_potential, &repair);
+    _resume_file = 0;
+  } else if(_nb_initial_paths > 0) {
+    if(_stats) {
+      _stats->nb_initial_paths += _nb_initial_paths;
+      _stats->begin_phase(PHASE_INITIAL_PATHS);
+    }
+    nb_augmentations = start_from_initial_paths(max_nb_paths, min_gain, exact_nb_paths);
+    if(_stats) _stats->end_phase(PHASE_INITIAL_PATHS, 0);
+    sink_potential = 0;
+  } else {
+    // Compute the distance of all the nodes from the source by just
+    // visiting them in the proper DAG ordering we computed when
+    // building the graph, or by label correcting if it has cycles
+    if(_stats) _stats->begin_phase(PHASE_DP_DISTANCES);
+    if(_acyclic) {
+      dp_compute_distances();
+    } else if(label_correcting_distances()) {
+      cerr << __FILE__ << ": The graph has a cycle of negative length." << endl;
+      abort();
+    }
+    if(_stats) _stats->end_phase(PHASE_DP_DISTANCES, 0);
+
+    // The sum of the distances of the sink used to positivize the
+    // lengths. Since the source is always at distance 0, the length
+    // of a path according to the original edge lengths is its
+    // positivized one plus that.
+    sink_potential = 0;
+    total_length = 0;
+  }
+
+  next_checkpoint = now_in_seconds() + _checkpoint_period;
 
   do {
+    if(_checkpoint_file &&
+       ((_checkpoint_request && _checkpoint_request->exchange(false)) ||
+        (_checkpoint_period > 0 && now_in_seconds() >= next_checkpoint))) {
+      write_checkpoint(nb_augmentations, sink_potential, repair);
+      next_checkpoint = now_in_seconds() + _checkpoint_period;
+    }
+
+    if(max_nb_paths > 0 && nb_augmentations >= max_nb_paths) {
+      if(_stats) _stats->stop_reason = STOP_MAX_PATHS;
+      break;
+    }
+
+    if(should_stop()) break;
+
+    if(_stats) _stats->begin_phase(PHASE_POSITIVIZATION);
+    sink_potential += _sink->distance_from_source;
     // Use the current distance from the source to make all edge
     // lengths positive
     update_positivized_lengths();
     // Fix numerical errors
-    force_positivized_lengths();
+    residual_clamp = force_positivized_lengths();
+
+    path_stats = 0;
+    if(_stats) {
+      _stats->end_phase(PHASE_POSITIVIZATION, 0);
+      path_stats = _stats->new_shortest_path();
+      path_stats->residual_clamp = residual_clamp;
+      _stats->begin_phase(PHASE_SHORTEST_PATH);
+    }
 
-    find_shortest_path();
+    // Unless we want a given number of paths whatever their lengths,
+    // Dijkstra can stop as soon as the paths to the sink are too long
+    // to be of any use
+    if(exact_nb_paths) bound = FLT_MAX;
+    else bound = - min_gain - sink_potential;
+
+    if(_bidirectional) find_shortest_path_bidirectional(path_stats, bound);
+    else find_shortest_path(path_stats, bound, repair);
+
+    // If interrupted during the computation, the distances are not
+    // valid, and we keep the paths found so far
+
+    if(_stats) {
+      path_stats->duration = _stats->end_phase(PHASE_SHORTEST_PATH, path_stats->counters);
+      _stats->heap_pushes += path_stats->heap_pushes;
+      _stats->heap_pops += path_stats->heap_pops;
+      _stats->sift_steps += path_stats->sift_steps;
+      _stats->relaxations += path_stats->relaxations;
+      _stats->settled_vertices += path_stats->settled_vertices;
+      _stats->begin_phase(PHASE_AUGMENTATION);
+    }
 
     shortest_path_length = 0.0;
+    path_nb_edges = 0;
+    augment = 0;
 
     // Do we reach the sink?
     if(_sink->pred_edge_toward_source) {
@@ -350,32 +1627,58 @@ void MTPGraph::find_best_paths(scalar_t *lengths) {
       while(v->pred_edge_toward_source) {
         shortest_path_length += v->pred_edge_toward_source->length;
         v = v->pred_edge_toward_source->origin_vertex;
+        path_nb_edges++;
       }
-      // If that length is negative
-      if(shortest_path_length < 0.0) {
+      // If that length is negative enough, or if we want more paths
+      // anyway
+      augment = exact_nb_paths || shortest_path_length < - min_gain;
+      if(augment) {
 #ifdef VERBOSE
         cerr << __FILE__ << ": Found a path of length " << shortest_path_length << endl;
 #endif
-        // Invert all the edges along the best path
+        // Invert all the edges along the best path. Dijkstra went
+        // through the whole graph, so the next one can repair the tree
+        // below that path.
         v = _sink;
+        repair = _incremental && !_bidirectional;
+        if(repair) _in_region[_sink - _vertices] = 1;
         while(v->pred_edge_toward_source) {
           e = v->pred_edge_toward_source;
           v = e->origin_vertex;
-          e->invert();
+          if(repair && v != _source) _in_region[v - _vertices] = 1;
+          invert_edge(e);
           // This is the only place where we change the occupations of
           // edges
           e->occupied = 1 - e->occupied;
         }
+        nb_augmentations++;
+        total_length += shortest_path_length;
+      } else if(_stats) {
+        _stats->stop_reason = shortest_path_length < 0.0 ? STOP_MIN_GAIN : STOP_NO_IMPROVING_PATH;
+      }
+    } else if(_stats && !interrupted) {
+      if(exact_nb_paths) _stats->stop_reason = STOP_NO_PATH;
+      else if(min_gain > 0) _stats->stop_reason = STOP_MIN_GAIN;
+      else _stats->stop_reason = STOP_NO_IMPROVING_PATH;
+    }
+
+    if(_stats) {
+      path_stats->path_length = shortest_path_length;
+      path_stats->path_nb_edges = path_nb_edges;
+      if(augment) {
+        path_stats->augmented = 1;
+        _stats->nb_augmentations++;
       }
+      _stats->end_phase(PHASE_AUGMENTATION, 0);
     }
 
-  } while(shortest_path_length < 0.0);
+  } while(augment);
 
   // Put back the graph in its original state (i.e. invert edges which
   // have been inverted in the process)
-  for(int k = 0; k < _nb_edges; k++) {
+  for(index_t k = 0; k < _nb_edges; k++) {
     e = &_edges[k];
-    if(e->occupied) { e->invert(); }
+    if(e->occupied) { invert_edge(e); }
   }
 }
 
@@ -384,19 +1687,24 @@ int MTPGraph::retrieve_one_path(Edge *e, Path *path, int *used_edges) {
   int l = 0, nb_occupied_next;
 
   if(path) {
-    path->nodes[l++] = int(e->origin_vertex - _vertices);
+    path->nodes[l++] = e->origin_vertex - _vertices;
     path->length = e->length;
   } else l++;
 
   while(e->terminal_vertex != _sink) {
     if(path) {
-      path->nodes[l++] = int(e->terminal_vertex - _vertices);
+      path->nodes[l++] = e->terminal_vertex - _vertices;
       path->length += e->length;
     } else l++;
 
+    // Without path, the edges taken are reserved, and the second call
+    // takes the reserved ones instead of the free ones. They are met
+    // in the same order, so that it follows the same edges even if
+    // the path goes through a vertex more than once, which it can in a
+    // graph with cycles.
     nb_occupied_next = 0;
     for(f = e->terminal_vertex->leaving_edge_list_root; f; f = f->next_leaving_edge) {
-      if(f->occupied && !used_edges[f - _edges]) {
+      if(f->occupied && used_edges[f - _edges] == (path ? 2 : 0)) {
         nb_occupied_next++; next = f;
       }
     }
@@ -408,13 +1716,13 @@ int MTPGraph::retrieve_one_path(Edge *e, Path *path, int *used_edges) {
     }
 #endif
 
-    if(path) { used_edges[next - _edges] = 1; }
+    used_edges[next - _edges] = path ? 1 : 2;
 
     e = next;
   }
 
   if(path) {
-    path->nodes[l++] = int(e->terminal_vertex - _vertices);
+    path->nodes[l++] = e->terminal_vertex - _vertices;
     path->length += e->length;
   } else l++;
 
@@ -426,7 +1734,7 @@ int MTPGraph::retrieve_one_path(Edge *e, Path *path, int *used_edges) {
 void MTPGraph::compute_dp_ordering() {
   Vertex *v;
   Edge *e;
-  int ntv;
+  index_t ntv;
 
   // This method orders the nodes by putting first the ones with no
   // predecessors, then going on adding nodes whose predecessors have
@@ -437,19 +1745,19 @@ void MTPGraph::compute_dp_ordering() {
 
   Vertex **already_processed = _dp_order, **front = _dp_order, **new_front = _dp_order;
 
-  for(int k = 0; k < _nb_vertices; k++) {
+  for(index_t k = 0; k < _nb_vertices; k++) {
     nb_predecessors[k] = 0;
   }
 
-  for(int k = 0; k < _nb_vertices; k++) {
+  for(index_t k = 0; k < _nb_vertices; k++) {
     v = &_vertices[k];
     for(e = v->leaving_edge_list_root; e; e = e->next_leaving_edge) {
-      ntv = int(e->terminal_vertex - _vertices);
+      ntv = e->terminal_vertex - _vertices;
       nb_predecessors[ntv]++;
     }
   }
 
-  for(int k = 0; k < _nb_vertices; k++) {
+  for(index_t k = 0; k < _nb_vertices; k++) {
     if(nb_predecessors[k] == 0) {
       *(front++) = _vertices + k;
     }
@@ -465,7 +1773,7 @@ void MTPGraph::compute_dp_ordering() {
     while(already_processed < front) {
       v = *(already_processed++);
       for(e = v->leaving_edge_list_root; e; e = e->next_leaving_edge) {
-        ntv = int(e->terminal_vertex - _vertices);
+        ntv = e->terminal_vertex - _vertices;
         nb_predecessors[ntv]--;
         ASSERT(nb_predecessors[ntv] >= 0);
         if(nb_predecessors[ntv] == 0) {
@@ -476,9 +1784,13 @@ void MTPGraph::compute_dp_ordering() {
     front = new_front;
   }
 
-  if(already_processed < _dp_order + _nb_vertices) {
-    cerr << __FILE__ << ": The graph is not a DAG." << endl;
-    abort();
+  // The vertices left are on a cycle or downstream of one
+  _acyclic = already_processed == _dp_order + _nb_vertices;
+  if(!_acyclic) {
+    for(index_t k = 0; k < _nb_vertices; k++) {
+      if(nb_predecessors[k] > 0) *(front++) = _vertices + k;
+    }
+    ASSERT(front == _dp_order + _nb_vertices);
   }
 
   delete[] nb_predecessors;
@@ -491,6 +1803,8 @@ void MTPGraph::retrieve_disjoint_paths() {
   int p, l;
   int *used_edges;
 
+  if(_stats) _stats->begin_phase(PHASE_RETRIEVAL);
+
   for(int p = 0; p < nb_paths; p++) delete paths[p];
   delete[] paths;
 
@@ -501,7 +1815,7 @@ void MTPGraph::retrieve_disjoint_paths() {
 
   paths = new Path *[nb_paths];
   used_edges = new int[_nb_edges];
-  for(int e = 0; e < _nb_edges; e++) {
+  for(index_t e = 0; e < _nb_edges; e++) {
     used_edges[e] = 0;
   }
 
@@ -517,4 +1831,6 @@ void MTPGraph::retrieve_disjoint_paths() {
   }
 
   delete[] used_edges;
+
+  if(_stats) _stats->end_phase(PHASE_RETRIEVAL, 0);
 }
@@ -26,11 +26,14 @@
 #define MTP_GRAPH_H
 
 #include <iostream>
+#include <atomic>
 
 using namespace std;
 
 #include "misc.h"
 #include "path.h"
+#include "mtp_stats.h"
+#include "storage.h"
 
 class Vertex;
 class Edge;
@@ -45,9 +48,9 @@ class MTPGraph {
 
   // It may happen that numerical errors in update_positivized_lengths
   // make the resulting lengths negative, albeit very small. The
-  // following method forces all negative lengths to zero, and prints
-  // the total correction when compiled in VERBOSE mode.
-  void force_positivized_lengths();
+  // following method forces all negative lengths to zero, returns the
+  // total correction, and prints it when compiled in VERBOSE mode.
+  scalar_t force_positivized_lengths();
 
   // Visit the vertices according to _dp_order and update their
   // distance from the source
@@ -55,17 +58,87 @@ class MTPGraph {
 
   // Set in every vertex pred_edge_toward_source correspondingly to
   // the path of shortest length. The current implementation is
-  // Dijkstra with a Binary Heap (and not with Fibonnaci heap (yet))
-  void find_shortest_path();
+  // Dijkstra with a Binary Heap (and not with Fibonnaci heap (yet)).
+  // If stats is non-null, the heap and relaxation counts are added to
+  // it. If the distance of the sink is greater than bound, it stops
+  // as soon as it knows it, and leaves the sink without
+  // pred_edge_toward_source. With repair, it only recomputes the
+  // region of the previous shortest path tree below the vertices
+  // flagged in _in_region, see repair_region.
+  void find_shortest_path(ShortestPathStats *stats, scalar_t bound, int repair);
+
+  // Non-zero if find_best_paths repairs the shortest path tree
+  // instead of recomputing it, see set_incremental
+  int _incremental;
+
+  // Flags the vertices whose distance from the source has to be
+  // recomputed, null if not _incremental
+  char *_in_region;
+
+  // Prepares the repair of the shortest path tree of the previous
+  // find_shortest_path, after the path it found was inverted and the
+  // lengths positivized with its distances, and returns the size of
+  // the region. The vertices below the flagged ones in the tree are
+  // flagged too, and put first in _heap at distance FLT_MAX. The
+  // others keep their tree and get their new distance along it, and
+  // stay in _heap in the order they were settled, which is the only
+  // thing we need to find the subtrees.
+  index_t repair_region();
+
+  // Non-zero if find_best_paths uses find_shortest_path_bidirectional,
+  // see set_bidirectional
+  int _bidirectional;
+
+  // The same as find_shortest_path, with a search forward from the
+  // source and one backward from the sink, on the same positivized
+  // lengths. It stops when the sum of the distances at the top of the
+  // two heaps reaches the length of the best path found through an
+  // edge from a vertex settled forward to one settled backward. It
+  // then sets the distances from the source to potentials which keep
+  // the positivized lengths non-negative, and are exact along the
+  // path: the distance for the vertices settled forward, and for the
+  // others, the largest of the forward distance at the top of the
+  // heap and of the path length minus their distance to the sink.
+  void find_shortest_path_bidirectional(ShortestPathStats *stats, scalar_t bound);
+
+  // The edges entering every vertex, as a list linked through
+  // _next_entering_edge and _pred_entering_edge, indexed by edge. Null
+  // if not _bidirectional.
+  Edge **_entering_edge_list_root, **_next_entering_edge, **_pred_entering_edge;
+  void add_entering_edge(Edge *e);
+  void del_entering_edge(Edge *e);
+
+  // Inverts e, and updates the entering lists if there are some
+  void invert_edge(Edge *e);
+
+  // The backward search: the distance of every vertex to the sink,
+  // the edge toward the sink, and a binary heap of vertex indices,
+  // where vertex v is at _backward_slot[v]
+  scalar_t *_distance_to_sink;
+  Edge **_edge_toward_sink;
+  index_t *_backward_heap, *_backward_slot;
+  // These two return the number of swaps they did
+  int decrease_distance_to_sink(index_t v);
+  int increase_distance_to_sink(index_t v, index_t heap_size);
 
   // Follows the path starting on edge e and returns the number of
-  // nodes to reach the sink. If path is non-null, stores in it the
-  // nodes met along the path, and computes path->length properly.
+  // nodes to reach the sink. If path is null, it reserves the edges
+  // it takes in used_edges, and it has to be called again on the same
+  // edge with a path of that size, to store in it the nodes met along
+  // the path, compute path->length properly, and mark the edges used.
   int retrieve_one_path(Edge *e, Path *path, int *used_edges);
 
-  int _nb_vertices, _nb_edges;
+  index_t _nb_vertices, _nb_edges;
   Vertex *_source, *_sink;
 
+  // Where to count what the solver does, null if we do not
+  MTPStats *_stats;
+
+  // Where and how the arrays below are allocated, see storage.h. The
+  // directory is a copy in _storage_directory, null when in memory.
+  StoragePolicy _storage;
+  char *_storage_directory;
+
   Edge *_edges;
   Vertex *_vertices;
 
@@ -73,25 +146,227 @@ class MTPGraph {
   Vertex **_heap;
 
   // Updating the distances from the source in that order will work in
-  // the original graph (which has to be a DAG)
+  // the original graph if it is a DAG. If it is not, the vertices
+  // which are not on a cycle or downstream of one come first, and the
+  // others after them in index order.
   Vertex **_dp_order;
+  int _acyclic;
 
-  // Fills _dp_order
+  // Fills _dp_order, and sets _acyclic
   void compute_dp_ordering();
+
+  // See set_nb_threads
+  int _nb_threads;
+
+  // The distances from the source in the original graph when it has
+  // cycles. The vertices are visited in the DP order by blocks, and
+  // those with an entering edge whose origin changed are updated until
+  // there are none in the block, split between _nb_threads threads,
+  // which wait on a barrier between the updates. The sweeps go on
+  // until no vertex changes, and the result does not depend on the
+  // number of threads. It sets distance_from_source and
+  // pred_edge_toward_source, FLT_MAX and null for the vertices it does
+  // not reach, and returns null, or a vertex of a cycle of negative
+  // length, in which case the distances are meaningless.
+  Vertex *label_correcting_distances();
+
+  // Allocates the vertices and edges, without connecting them
+  void allocate(index_t nb_vertices, index_t nb_edges,
+                index_t source, index_t sink, MTPStats *stats,
+                const StoragePolicy *storage);
+
+  // With a file-backed storage, asks the kernel to bring in the
+  // vertices at [first, first + nb[ in _dp_order
+  void prefetch_dp_window(index_t first, index_t nb);
+
+  // When to give up, see set_interruption
+  double _deadline;
+  const atomic<bool> *_cancel;
+
+  // Returns 1 if the deadline has passed or the solve was cancelled,
+  // and sets interrupted accordingly
+  int should_stop();
+
+  // The edges of the paths given to set_initial_paths
+  int _nb_initial_paths;
+  index_t _nb_initial_edges;
+  index_t *_initial_edges;
+
+  // Bellman-Ford on the current edges, from start, or from all the
+  // vertices at distance zero if start is null. It sets
+  // distance_from_source and pred_edge_toward_source, FLT_MAX and
+  // null for the vertices it does not reach. The cycles of negative
+  // length it meets in the predecessor graph are cancelled as it goes,
+  // all those of a pass at once, and it returns how many. It
+  // alternates passes over the edges in increasing and decreasing
+  // order, which follow the time axis forward and backward.
+  int bellman_ford(Vertex *start);
+
+  // Moves one unit of flow around the cycle of the predecessor graph
+  // which goes through v
+  void cancel_cycle(Vertex *v);
+
+  // Occupies the edges of the initial paths, cancels the negative
+  // cycles, removes paths while it decreases the total length, and
+  // sets the distances from the source, for find_best_paths to go on
+  // from there. Returns the number of paths.
+  int start_from_initial_paths(int max_nb_paths, scalar_t min_gain, int exact_nb_paths);
+
+  // Where and when to write checkpoints, and where to resume from,
+  // see set_checkpoint and set_resume
+  const char *_checkpoint_file, *_resume_file;
+  double _checkpoint_period;
+  atomic<bool> *_checkpoint_request;
+
+  // A hash of the edges and of their lengths in their original
+  // direction, to check that a checkpoint is for this graph
+  uint64_t edge_hash();
+
+  // Save and restore the state of find_best_paths between two
+  // shortest paths: the direction and occupation of the edges, their
+  // positivized lengths, the distances and shortest path tree of the
+  // last Dijkstra, the order of the edge lists and of the heaps,
+  // which decide between paths of equal length, and the counters of
+  // the loop
+  void write_checkpoint(int nb_augmentations, scalar_t sink_potential, int repair);
+  void read_checkpoint(int *nb_augmentations, scalar_t *sink_potential, int *repair);
 public:
 
+  // Set by find_best_paths. interrupted is non-zero if it stopped
+  // because of the deadline or the cancellation, and total_length is
+  // the total length of the paths found
+  int interrupted;
+  scalar_t total_length;
+
   // These variables are filled when retrieve_disjoint_paths is called
   int nb_paths;
   Path **paths;
 
-  MTPGraph(int nb_vertices, int nb_edges, int *vertex_from, int *vertex_to,
-           int source, int sink);
+  // If stats is non-null, it is filled from the construction on, as
+  // with set_stats. The vertices and edges are allocated according to
+  // storage, which is copied, and in memory with new if it is null:
+  // in a memory map of a file with a directory, in huge pages, or on
+  // a given NUMA node, see storage.h. They are faster to visit if they
+  // are numbered in time order, the pages of the DP and Dijkstra being
+  // then mostly contiguous.
+  MTPGraph(index_t nb_vertices, index_t nb_edges,
+           index_t *vertex_from, index_t *vertex_to,
+           index_t source, index_t sink, MTPStats *stats = 0,
+           const StoragePolicy *storage = 0);
+
+  // The same, with the edges set afterwards by the caller with
+  // set_edge, and the construction ended with end_construction. This
+  // spares the vertex_from and vertex_to arrays, and lets the caller
+  // set the edges concurrently.
+  MTPGraph(index_t nb_vertices, index_t nb_edges,
+           index_t source, index_t sink, MTPStats *stats = 0,
+           const StoragePolicy *storage = 0);
+
+  // A graph with the same vertices, edges, lengths and storage
+  // policy as graph, and the same order of the edge lists, of the
+  // heap and of the DP, so that it finds the same paths. The paths,
+  // the initial ones and the options set with the set_ methods are
+  // not copied. graph must not be in find_best_paths.
+  MTPGraph(MTPGraph *graph, MTPStats *stats = 0);
+
+  // Edge e goes from vertex from to vertex to. It can be called
+  // concurrently for edges leaving different vertices. The edges
+  // leaving a vertex are visited in the reverse order of the calls,
+  // so the results are the same as with the arrays if, for every
+  // vertex, they are set in increasing order.
+  void set_edge(index_t e, index_t from, index_t to);
+
+  // Once all the edges are set. If in_topological_order is non-zero,
+  // the caller guarantees that every edge goes to a vertex of larger
+  // index, and the order of the DP is the one of the indices instead
+  // of a topological sort. The graph may have cycles, even of one
+  // edge, in which case the first distances from the source are
+  // computed by label correcting instead of DP, which is slower. It
+  // must have no cycle of negative length reachable from the source.
+  void end_construction(int in_topological_order);
 
   ~MTPGraph();
 
+  // Sets the MTPStats to fill from now on, or disable the statistics
+  // if null. The MTPGraph does not own it.
+  void set_stats(MTPStats *stats);
+
+  // Makes find_best_paths stop when now_in_seconds() passes deadline,
+  // or when *cancel becomes true, with the paths found so far. They
+  // are checked between two paths and regularly during the shortest
+  // path computations. A zero deadline or a null cancel disables the
+  // corresponding check.
+  void set_interruption(double deadline, const atomic<bool> *cancel);
+
+  // Makes find_best_paths write its state to filename every period
+  // seconds if period is not zero, and as soon as *request becomes
+  // true if request is not null, which is then set back to false. It
+  // is only done between two shortest path computations, so a
+  // request waits for the current one to end. The file is written
+  // under another name and renamed, so an interruption while writing
+  // leaves the previous checkpoint intact. A null filename disables
+  // it. The string is not copied.
+  void set_checkpoint(const char *filename, double period, atomic<bool> *request);
+
+  // Makes the next find_best_paths start from the state saved in
+  // filename instead of from scratch, and find the same paths as the
+  // run which wrote it would have. The graph, the lengths and the
+  // incremental and bidirectional settings have to be the same as
+  // for that run. The string is not copied.
+  void set_resume(const char *filename);
+
+  // Makes find_best_paths start from the given paths instead of from
+  // none. Path k goes through the vertices nodes[first[k]] to
+  // nodes[first[k+1]-1], from the source to the sink. find_best_paths
+  // then cancels the cycles of negative length of the residual graph,
+  // which makes them the best family of that many paths, removes
+  // paths while there are more than max_nb_paths or the last one does
+  // not decrease the total length by more than min_gain, and then
+  // adds paths as usual. The result is the same as without them, up
+  // to the choice among families of equal length, and it takes only a
+  // few cycles and paths if they are close to it. Returns -1 and keeps
+  // no path if a path goes through a pair of vertices without an edge,
+  // or through an edge of another path, 0 otherwise. The paths are
+  // copied, and kept until the next call, with nb_paths zero to remove
+  // them.
+  int set_initial_paths(int nb_paths, const index_t *first, const index_t *nodes);
+
+  // With incremental non-zero, after a path has been added,
+  // find_best_paths recomputes only the distances of the vertices
+  // downstream of it in the shortest path tree, with Dijkstra started
+  // from the edges entering that region. The result is the same, up to
+  // the choice among paths of equal length.
+  void set_incremental(int incremental);
+
+  // With bidirectional non-zero, find_best_paths computes the shortest
+  // paths with a search from the source and one from the sink, which
+  // meet in the middle of the time axis instead of sweeping it. It
+  // needs the lists of the edges entering every vertex, and a second
+  // heap, which take 36 more bytes per vertex and 16 per edge. It can
+  // not repair the shortest path tree, and takes precedence over
+  // set_incremental. It has to be called after the construction.
+  void set_bidirectional(int bidirectional);
+
+  // Number of threads for the first distances from the source of a
+  // graph with cycles, one per core if zero, which is the default.
+  // They take 21 more bytes per vertex and 8 per edge while they run.
+  void set_nb_threads(int nb_threads);
+
+  // The length of edge e, zero until set. This spares a copy of the
+  // lengths when few of them change between two find_best_paths.
+  void set_length(index_t e, scalar_t length);
+
   // Compute the family of paths with minimum total length, set the
-  // edge occupied fields accordingly.
-  void find_best_paths(scalar_t *lengths);
+  // edge occupied fields accordingly. If lengths is null, the edges
+  // keep the lengths they have. If max_nb_paths is not zero, it
+  // returns at most that many paths, the best family of that size.
+  // It stops adding paths as soon as the next one would decrease the
+  // total length by less than min_gain. With exact_nb_paths, it adds
+  // paths until it gets max_nb_paths of them, even if that increases
+  // the total length, or there is no path left.
+  void find_best_paths(scalar_t *lengths,
+                       int max_nb_paths = 0, scalar_t min_gain = 0.0,
+                       int exact_nb_paths = 0);
 
   // Retrieve the paths corresponding to the occupied edges, and save
   // the result in the nb_paths and paths fields. If the paths are not
@@ -102,6 +377,15 @@ public:
 
   void print(ostream *os);
   void print_dot(ostream *os);
+
+  // The memory taken by one vertex, not counting its slots in the heap
+  // and the DP order, and by one edge, to size a graph before building
+  // it
+  static size_t vertex_bytes();
+  static size_t edge_bytes();
+  // The same for the additional structures of set_bidirectional
+  static size_t bidirectional_vertex_bytes();
+  static size_t bidirectional_edge_bytes();
 };
 
 #endif
@@ -0,0 +1,293 @@
+/*
+ *  mtp is the ``Multi Tracked Paths'', an implementation of the
+ *  k-shortest paths algorithm for multi-target tracking.
+ *
+ *  Copyright (c) 2012 Idiap Research Institute, http://www.idiap.ch/
+ *  Written by Francois Fleuret <francois.fleuret@idiap.ch>
+ *
+ *  This file is part of mtp.
+ *
+ *  mtp is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  mtp is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ *  License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with selector.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <algorithm>
+
+#include "mtp_greedy.h"
+
+MTPGreedy::MTPGreedy() {
+  _nodes_size = 0;
+  _nb_nodes = 0;
+  _node_location = 0;
+  _node_previous = 0;
+  _locations_size = 0;
+  _nb_active = 0;
+  _active_node = 0;
+  _next_node = 0;
+  _active_gap = 0;
+  _next_gap = 0;
+  _taken = 0;
+  _finished_size = 0;
+  _nb_finished = 0;
+  _finished_node = 0;
+  _finished_time = 0;
+  _nb_trajectories = 0;
+  _trajectory_entrance_time = 0;
+  _trajectory_duration = 0;
+  _trajectory_first = 0;
+  _trajectory_locations = 0;
+  _trajectory_score = 0;
+  max_gap = 5;
+}
+
+MTPGreedy::~MTPGreedy() {
+  delete[] _node_location;
+  delete[] _node_previous;
+  delete[] _active_node;
+  delete[] _next_node;
+  delete[] _active_gap;
+  delete[] _next_gap;
+  delete[] _taken;
+  delete[] _finished_node;
+  delete[] _finished_time;
+  delete[] _trajectory_entrance_time;
+  delete[] _trajectory_duration;
+  delete[] _trajectory_first;
+  delete[] _trajectory_locations;
+  delete[] _trajectory_score;
+}
+
+index_t MTPGreedy::add_node(int location, index_t previous) {
+  if(_nb_nodes == _nodes_size) {
+    _nodes_size = 2 * _nodes_size + 1024;
+    int *tmp_location = new int[_nodes_size];
+    index_t *tmp_previous = new index_t[_nodes_size];
+    for(index_t n = 0; n < _nb_nodes; n++) {
+      tmp_location[n] = _node_location[n];
+      tmp_previous[n] = _node_previous[n];
+    }
+    delete[] _node_location;
+    delete[] _node_previous;
+    _node_location = tmp_location;
+    _node_previous = tmp_previous;
+  }
+  _node_location[_nb_nodes] = location;
+  _node_previous[_nb_nodes] = previous;
+  return _nb_nodes++;
+}
+
+void MTPGreedy::finish(index_t node, int t) {
+  if(_nb_finished == _finished_size) {
+    _finished_size = 2 * _finished_size + 64;
+    index_t *tmp_node = new index_t[_finished_size];
+    int *tmp_time = new int[_finished_size];
+    for(int k = 0; k < _nb_finished; k++) {
+      tmp_node[k] = _finished_node[k];
+      tmp_time[k] = _finished_time[k];
+    }
+    delete[] _finished_node;
+    delete[] _finished_time;
+    _finished_node = tmp_node;
+    _finished_time = tmp_time;
+  }
+  _finished_node[_nb_finished] = node;
+  _finished_time[_nb_finished] = t;
+  _nb_finished++;
+}
+
+void MTPGreedy::track(MTPTracker *tracker) {
+  int nb_locations = tracker->nb_locations;
+
+  tracker->compute_motion_lists();
+  int *motion_first = tracker->_motion_first, *motion_to = tracker->_motion_to;
+
+  if(nb_locations > _locations_size) {
+    delete[] _active_node;
+    delete[] _next_node;
+    delete[] _active_gap;
+    delete[] _next_gap;
+    delete[] _taken;
+    _locations_size = nb_locations;
+    _active_node = new index_t[_locations_size];
+    _next_node = new index_t[_locations_size];
+    _active_gap = new int[_locations_size];
+    _next_gap = new int[_locations_size];
+    _taken = new int[_locations_size];
+  }
+
+  for(int l = 0; l < nb_locations; l++) _taken[l] = -1;
+  _nb_nodes = 0;
+  _nb_active = 0;
+  _nb_finished = 0;
+
+  for(int t = 0; t < tracker->nb_time_steps; t++) {
+    int nb_next = 0;
+
+    // Extend the trajectories, the oldest first, to their best free
+    // detection, or without one, to where they are if they can stay
+    // there, since they would otherwise drift away from the target
+    for(int a = 0; a < _nb_active; a++) {
+      index_t n = _active_node[a];
+      int l = _node_location[n], best = -1, stay = 0;
+      scalar_t best_score = 0;
+      for(int k = motion_first[l]; k < motion_first[l + 1]; k++) {
+        int m = motion_to[k];
+        if(_taken[m] < t) {
+          scalar_t s = tracker->detection_score(t, m);
+          if(best < 0 || s > best_score) {
+            best = m;
+            best_score = s;
+          }
+          if(m == l) stay = 1;
+        }
+      }
+      if(best >= 0 && best_score <= 0 && stay) best = l;
+      if(best >= 0 &&
+         (best_score > 0 || (!tracker->exits[t - 1][l] && _active_gap[a] < max_gap))) {
+        _taken[best] = t;
+        _next_node[nb_next] = add_node(best, n);
+        _next_gap[nb_next] = best_score > 0 ? 0 : _active_gap[a] + 1;
+        nb_next++;
+      } else {
+        finish(n, t - 1);
+      }
+    }
+
+    // Start new ones on the free detections on entrances
+    for(int l = 0; l < nb_locations; l++) {
+      if(_taken[l] < t && tracker->entrances[t][l] && tracker->detection_score(t, l) > 0) {
+        _taken[l] = t;
+        _next_node[nb_next] = add_node(l, -1);
+        _next_gap[nb_next] = 0;
+        nb_next++;
+      }
+    }
+
+    swap(_active_node, _next_node);
+    swap(_active_gap, _next_gap);
+    _nb_active = nb_next;
+  }
+
+  for(int a = 0; a < _nb_active; a++) finish(_active_node[a], tracker->nb_time_steps - 1);
+  _nb_active = 0;
+
+  read_out(tracker);
+}
+
+void MTPGreedy::read_out(MTPTracker *tracker) {
+  delete[] _trajectory_entrance_time;
+  delete[] _trajectory_duration;
+  delete[] _trajectory_first;
+  delete[] _trajectory_locations;
+  delete[] _trajectory_score;
+  _trajectory_entrance_time = new int[_nb_finished];
+  _trajectory_duration = new int[_nb_finished];
+  _trajectory_first = new index_t[_nb_finished];
+  _trajectory_locations = new int[_nb_nodes];
+  _trajectory_score = new scalar_t[_nb_finished];
+
+  _nb_trajectories = 0;
+  index_t first = 0;
+
+  for(int f = 0; f < _nb_finished; f++) {
+    int duration = 0;
+    for(index_t n = _finished_node[f]; n >= 0; n = _node_previous[n]) duration++;
+    int *locations = _trajectory_locations + first;
+    int u = duration;
+    for(index_t n = _finished_node[f]; n >= 0; n = _node_previous[n]) {
+      locations[--u] = _node_location[n];
+    }
+    int entrance_time = _finished_time[f] - duration + 1;
+
+    // Cut after the best-scoring exit
+    scalar_t score = 0, best_score = 0;
+    int best_duration = 0;
+    for(u = 0; u < duration; u++) {
+      score += tracker->detection_score(entrance_time + u, locations[u]);
+      if(tracker->exits[entrance_time + u][locations[u]] &&
+         (best_duration == 0 || score > best_score)) {
+        best_score = score;
+        best_duration = u + 1;
+      }
+    }
+
+    if(best_duration > 0 && best_score > tracker->min_trajectory_gain) {
+      int k = _nb_trajectories++;
+      _trajectory_entrance_time[k] = entrance_time;
+      _trajectory_duration[k] = best_duration;
+      _trajectory_first[k] = first;
+      _trajectory_score[k] = best_score;
+      first += best_duration;
+    }
+  }
+
+  // Keep the max_nb_trajectories best ones, in the same order
+  if(tracker->max_nb_trajectories > 0 && _nb_trajectories > tracker->max_nb_trajectories) {
+    int *order = new int[_nb_trajectories];
+    for(int k = 0; k < _nb_trajectories; k++) order[k] = k;
+    scalar_t *scores = _trajectory_score;
+    nth_element(order, order + tracker->max_nb_trajectories - 1, order + _nb_trajectories,
+                [scores](int a, int b) { return scores[a] > scores[b]; });
+    sort(order, order + tracker->max_nb_trajectories);
+    for(int k = 0; k < tracker->max_nb_trajectories; k++) {
+      int j = order[k];
+      _trajectory_entrance_time[k] = _trajectory_entrance_time[j];
+      _trajectory_duration[k] = _trajectory_duration[j];
+      _trajectory_first[k] = _trajectory_first[j];
+      _trajectory_score[k] = _trajectory_score[j];
+    }
+    _nb_trajectories = tracker->max_nb_trajectories;
+    delete[] order;
+  }
+}
+
+scalar_t MTPGreedy::total_score() {
+  scalar_t total = 0;
+  for(int k = 0; k < _nb_trajectories; k++) total += _trajectory_score[k];
+  return total;
+}
+
+int MTPGreedy::nb_trajectories() {
+  return _nb_trajectories;
+}
+
+scalar_t MTPGreedy::trajectory_score(int k) {
+  return _trajectory_score[k];
+}
+
+int MTPGreedy::trajectory_entrance_time(int k) {
+  return _trajectory_entrance_time[k];
+}
+
+int MTPGreedy::trajectory_duration(int k) {
+  return _trajectory_duration[k];
+}
+
+int MTPGreedy::trajectory_location(int k, int time_from_entry) {
+  return _trajectory_locations[_trajectory_first[k] + time_from_entry];
+}
+
+void MTPGreedy::write_trajectories(ostream *os) {
+  (*os) << nb_trajectories() << endl;
+  for(int t = 0; t < nb_trajectories(); t++) {
+    (*os) << t
+         << " " << trajectory_entrance_time(t)
+         << " " << trajectory_duration(t)
+         << " " << trajectory_score(t);
+    for(int u = 0; u < trajectory_duration(t); u++) {
+      (*os) << " " << trajectory_location(t, u);
+    }
+    (*os) << endl;
+  }
+}
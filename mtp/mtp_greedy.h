@@ -0,0 +1,115 @@
+/*
+ *  mtp is the ``Multi Tracked Paths'', an implementation of the
+ *  k-shortest paths algorithm for multi-target tracking.
+ *
+ *  Copyright (c) 2012 Idiap Research Institute, http://www.idiap.ch/
+ *  Written by Francois Fleuret <francois.fleuret@idiap.ch>
+ *
+ *  This file is part of mtp.
+ *
+ *  mtp is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  mtp is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ *  License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with selector.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef MTP_GREEDY_H
+#define MTP_GREEDY_H
+
+#include <iostream>
+
+using namespace std;
+
+#include "misc.h"
+#include "mtp_tracker.h"
+
+// A fast but not optimal alternative to MTPTracker::track, for when
+// the trajectories are needed within milliseconds. It takes the same
+// inputs, the topology, scores, max_nb_trajectories and
+// min_trajectory_gain of an MTPTracker, and has the same read-out.
+//
+// The frames are processed one after another. A location of positive
+// score is a detection, and every trajectory being followed is
+// extended to the best free detection among the motions allowed from
+// its current location, the oldest trajectories first. A trajectory
+// without detection ends if it is on an exit, and otherwise goes on
+// to the best free location for at most max_gap frames, to get
+// through missed detections. The free detections on entrances start
+// new trajectories. In the end, every trajectory is cut after its
+// best-scoring exit, and kept if its score is above
+// min_trajectory_gain.
+//
+// The assignment of a frame transition costs a constant per
+// trajectory and allowed motion, on top of the pass over the scores
+// of the frame to find the detections.
+
+class MTPGreedy {
+  // The trajectories being built are linked lists of nodes going
+  // back in time, with -1 before the first one
+  index_t _nodes_size, _nb_nodes;
+  int *_node_location;
+  index_t *_node_previous;
+
+  // The trajectories being followed: their last node, and for how
+  // many frames they had no detection. They are on distinct
+  // locations, so there are at most nb_locations of them, and their
+  // next ones are built in _next_node and _next_gap.
+  int _locations_size, _nb_active;
+  index_t *_active_node, *_next_node;
+  int *_active_gap, *_next_gap;
+
+  // The last time step at which every location was taken, so that
+  // nothing has to be cleared between frames
+  int *_taken;
+
+  // The last nodes of the finished trajectories, and their last time
+  // step
+  int _finished_size, _nb_finished;
+  index_t *_finished_node;
+  int *_finished_time;
+
+  index_t add_node(int location, index_t previous);
+  void finish(index_t node, int t);
+  // Cuts and filters the finished trajectories, and stores them for
+  // the read-out
+  void read_out(MTPTracker *tracker);
+
+  int _nb_trajectories;
+  int *_trajectory_entrance_time, *_trajectory_duration;
+  index_t *_trajectory_first;
+  int *_trajectory_locations;
+  scalar_t *_trajectory_score;
+
+public:
+  // Number of frames a trajectory can go without detection
+  int max_gap;
+
+  MTPGreedy();
+  ~MTPGreedy();
+
+  // Computes the trajectories from the inputs of tracker, which has
+  // to stay valid only during the call
+  void track(MTPTracker *tracker);
+
+  // Read-out of the trajectories, as in MTPTracker
+
+  scalar_t total_score();
+  int nb_trajectories();
+  scalar_t trajectory_score(int k);
+  int trajectory_entrance_time(int k);
+  int trajectory_duration(int k);
+  int trajectory_location(int k, int time_from_entry);
+
+  void write_trajectories(ostream *os);
+};
+
+#endif
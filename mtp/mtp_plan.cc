@@ -0,0 +1,199 @@
+/*
+ *  mtp is the ``Multi Tracked Paths'', an implementation of the
+ *  k-shortest paths algorithm for multi-target tracking.
+ *
+ *  Copyright (c) 2012 Idiap Research Institute, http://www.idiap.ch/
+ *  Written by Francois Fleuret <francois.fleuret@idiap.ch>
+ *
+ *  This file is part of mtp.
+ *
+ *  mtp is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  mtp is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ *  License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with selector.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "mtp_plan.h"
+#include "mtp_tracker.h"
+
+#include <cmath>
+
+MTPPlan::MTPPlan() {
+  nb_pairs = 0;
+  nb_vertices = 0;
+  nb_edges = 0;
+  upper_bound = 0;
+  for(int s = 0; s < NB_STRUCTURES; s++) {
+    structure_bytes[s] = 0;
+    structure_in_storage[s] = 0;
+  }
+  memory_bytes = 0;
+  storage_bytes = 0;
+
+  // Measured with calibrate on the machine used to develop mtp
+  seconds_per_build_edge = 1.5e-8;
+  seconds_per_dp_edge = 1.5e-8;
+  seconds_per_path_edge = 1.5e-8;
+  seconds_per_heap_operation = 3e-8;
+  incremental_ratio = 0.3;
+
+  expected_nb_trajectories = 0;
+  build_seconds = 0;
+  dp_seconds = 0;
+  shortest_path_seconds = 0;
+  total_seconds = 0;
+
+  memory_budget = 0;
+  nb_recommendations = 0;
+}
+
+void MTPPlan::calibrate() {
+  const int nb_locations = 1000, nb_time_steps = 200;
+
+  // A corridor where the targets can move by one location per time
+  // step, with pseudo-random scores
+  int *motion_first = new int[nb_locations + 1];
+  int *motion_to = new int[3 * nb_locations];
+  int k = 0;
+  for(int l = 0; l < nb_locations; l++) {
+    motion_first[l] = k;
+    for(int m = l - 1; m <= l + 1; m++) {
+      if(m >= 0 && m < nb_locations) motion_to[k++] = m;
+    }
+  }
+  motion_first[nb_locations] = k;
+
+  MTPTracker *tracker = new MTPTracker();
+  tracker->memory_budget = 0;
+  tracker->allocate(nb_time_steps, nb_locations, motion_first, motion_to);
+  delete[] motion_first;
+  delete[] motion_to;
+
+  unsigned int seed = 1;
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int l = 0; l < nb_locations; l++) {
+      seed = seed * 1103515245 + 12345;
+      tracker->detection_scores[t][l] = scalar_t((seed >> 16) % 1000) / 1000 - 0.6f;
+    }
+  }
+  for(int l = 0; l < nb_locations; l++) {
+    tracker->entrances[0][l] = 1;
+    tracker->exits[nb_time_steps - 1][l] = 1;
+  }
+
+  tracker->max_nb_trajectories = 4;
+  tracker->enable_stats(1);
+  tracker->build_graph();
+  tracker->track();
+
+  MTPStats *stats = tracker->stats();
+  double e = double(stats->nb_edges), v = double(stats->nb_vertices);
+  seconds_per_build_edge = stats->phase_durations[PHASE_BUILD_GRAPH] / e;
+  seconds_per_dp_edge =
+    (stats->phase_durations[PHASE_DP_ORDERING] + stats->phase_durations[PHASE_DP_DISTANCES]) / e;
+  if(stats->phase_counts[PHASE_POSITIVIZATION] > 0) {
+    seconds_per_path_edge = stats->phase_durations[PHASE_POSITIVIZATION] /
+      (stats->phase_counts[PHASE_POSITIVIZATION] * e);
+  }
+  if(stats->phase_counts[PHASE_SHORTEST_PATH] > 0) {
+    seconds_per_heap_operation = stats->phase_durations[PHASE_SHORTEST_PATH] /
+      (stats->phase_counts[PHASE_SHORTEST_PATH] * (e + v * log2(v)));
+  }
+
+  delete tracker;
+}
+
+const char *MTPPlan::structure_name(int structure) {
+  switch(structure) {
+  case STRUCTURE_TOPOLOGY: return "topology";
+  case STRUCTURE_SCORES: return "scores";
+  case STRUCTURE_PAIRS: return "pairs";
+  case STRUCTURE_VERTICES: return "vertices";
+  case STRUCTURE_EDGES: return "edges";
+  case STRUCTURE_HEAP: return "heap";
+  case STRUCTURE_DP_ORDER: return "dp_order";
+  case STRUCTURE_REGION: return "region";
+  case STRUCTURE_BUILD: return "build";
+  case STRUCTURE_PATHS: return "paths";
+  default: return "unknown";
+  }
+}
+
+void MTPPlan::print(ostream *os) {
+  (*os) << "pairs " << nb_pairs
+        << " vertices " << nb_vertices
+        << " edges " << nb_edges;
+  if(upper_bound) (*os) << " (at most)";
+  (*os) << endl;
+  for(int s = 0; s < NB_STRUCTURES; s++) {
+    if(structure_bytes[s] > 0) {
+      (*os) << structure_name(s) << " " << structure_bytes[s] << " bytes";
+      if(structure_in_storage[s]) (*os) << " in storage";
+      (*os) << endl;
+    }
+  }
+  (*os) << "memory " << memory_bytes << " bytes";
+  if(storage_bytes > 0) (*os) << " storage " << storage_bytes << " bytes";
+  if(memory_budget > 0) {
+    (*os) << " budget " << memory_budget << " bytes";
+    if(memory_bytes > memory_budget) (*os) << " EXCEEDED";
+  }
+  (*os) << endl;
+  (*os) << "build " << build_seconds << "s"
+        << " dp " << dp_seconds << "s"
+        << " shortest paths " << shortest_path_seconds << "s"
+        << " total " << total_seconds << "s"
+        << " for " << expected_nb_trajectories << " trajectories" << endl;
+  for(int r = 0; r < nb_recommendations; r++) {
+    (*os) << "recommended " << recommendations[r];
+    if(recommended_memory_bytes[r] > 0) {
+      (*os) << " memory " << recommended_memory_bytes[r] << " bytes";
+    } else {
+      (*os) << " memory depends on the scores";
+    }
+    (*os) << endl;
+  }
+}
+
+void MTPPlan::write_json(ostream *os) {
+  (*os) << "{" << endl;
+  (*os) << "  \"nb_pairs\": " << nb_pairs << "," << endl;
+  (*os) << "  \"nb_vertices\": " << nb_vertices << "," << endl;
+  (*os) << "  \"nb_edges\": " << nb_edges << "," << endl;
+  (*os) << "  \"upper_bound\": " << (upper_bound ? "true" : "false") << "," << endl;
+  (*os) << "  \"structures\": {";
+  for(int s = 0; s < NB_STRUCTURES; s++) {
+    if(s > 0) (*os) << ",";
+    (*os) << endl << "    \"" << structure_name(s) << "\": {"
+          << "\"bytes\": " << structure_bytes[s]
+          << ", \"in_storage\": " << (structure_in_storage[s] ? "true" : "false") << "}";
+  }
+  (*os) << endl << "  }," << endl;
+  (*os) << "  \"memory_bytes\": " << memory_bytes << "," << endl;
+  (*os) << "  \"storage_bytes\": " << storage_bytes << "," << endl;
+  (*os) << "  \"memory_budget\": " << memory_budget << "," << endl;
+  (*os) << "  \"expected_nb_trajectories\": " << expected_nb_trajectories << "," << endl;
+  (*os) << "  \"build_seconds\": " << build_seconds << "," << endl;
+  (*os) << "  \"dp_seconds\": " << dp_seconds << "," << endl;
+  (*os) << "  \"shortest_path_seconds\": " << shortest_path_seconds << "," << endl;
+  (*os) << "  \"total_seconds\": " << total_seconds << "," << endl;
+  (*os) << "  \"recommendations\": [";
+  for(int r = 0; r < nb_recommendations; r++) {
+    if(r > 0) (*os) << ",";
+    (*os) << endl << "    {\"options\": \"" << recommendations[r] << "\""
+          << ", \"memory_bytes\": ";
+    if(recommended_memory_bytes[r] > 0) (*os) << recommended_memory_bytes[r];
+    else (*os) << "null";
+    (*os) << "}";
+  }
+  (*os) << endl << "  ]" << endl;
+  (*os) << "}" << endl;
+}
@@ -0,0 +1,105 @@
+/*
+ *  mtp is the ``Multi Tracked Paths'', an implementation of the
+ *  k-shortest paths algorithm for multi-target tracking.
+ *
+ *  Copyright (c) 2012 Idiap Research Institute, http://www.idiap.ch/
+ *  Written by Francois Fleuret <francois.fleuret@idiap.ch>
+ *
+ *  This file is part of mtp.
+ *
+ *  mtp is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  mtp is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ *  License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with selector.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MTP_PLAN_H
+#define MTP_PLAN_H
+
+#include <iostream>
+
+using namespace std;
+
+#include "misc.h"
+
+// The data structures of a tracking, whose sizes MTPPlan predicts
+
+enum {
+  STRUCTURE_TOPOLOGY,
+  STRUCTURE_SCORES,
+  STRUCTURE_PAIRS,
+  STRUCTURE_VERTICES,
+  STRUCTURE_EDGES,
+  STRUCTURE_HEAP,
+  STRUCTURE_DP_ORDER,
+  STRUCTURE_REGION,
+  STRUCTURE_BUILD,
+  STRUCTURE_PATHS,
+  NB_STRUCTURES
+};
+
+#define MAX_NB_RECOMMENDATIONS 8
+
+// What a tracking is going to cost, computed by MTPTracker::plan
+// from the topology alone, before the graph is built.
+
+class MTPPlan {
+public:
+  // The size of the graph. They are upper bounds if upper_bound is
+  // non-zero, when the graph depends on a coarse solution.
+  index_t nb_pairs, nb_vertices, nb_edges;
+  int upper_bound;
+
+  // The bytes of every structure, and whether they are in the
+  // file-backed storage instead of in memory. The build and paths
+  // ones are temporary, but counted anyway.
+  size_t structure_bytes[NB_STRUCTURES];
+  int structure_in_storage[NB_STRUCTURES];
+  size_t memory_bytes, storage_bytes;
+
+  // The cost model: the time of building the graph, of the DP, and of
+  // every shortest path computation is proportional to nb_edges, but
+  // for the heap operations of Dijkstra, proportional to nb_vertices
+  // times its logarithm. An incremental one costs incremental_ratio
+  // times a full one.
+  double seconds_per_build_edge;
+  double seconds_per_dp_edge;
+  double seconds_per_path_edge;
+  double seconds_per_heap_operation;
+  double incremental_ratio;
+
+  // The predicted times, for expected_nb_trajectories trajectories
+  int expected_nb_trajectories;
+  double build_seconds, dp_seconds, shortest_path_seconds, total_seconds;
+
+  // The budget the memory_bytes was compared to, 0 for none
+  size_t memory_budget;
+
+  // If memory_bytes is over the budget, the options which would
+  // reduce it, cumulatively, and the resulting memory_bytes, 0 if it
+  // can not be predicted
+  int nb_recommendations;
+  const char *recommendations[MAX_NB_RECOMMENDATIONS];
+  size_t recommended_memory_bytes[MAX_NB_RECOMMENDATIONS];
+
+  // The coefficients of the cost model are measured on the machine
+  // where this was compiled, calibrate measures them on this one by
+  // tracking a synthetic sequence, which takes a fraction of a second
+  MTPPlan();
+  void calibrate();
+
+  static const char *structure_name(int structure);
+
+  void print(ostream *os);
+  void write_json(ostream *os);
+};
+
+#endif
@@ -0,0 +1,225 @@
+/*
+ *  mtp is the ``Multi Tracked Paths'', an implementation of the
+ *  k-shortest paths algorithm for multi-target tracking.
+ *
+ *  Copyright (c) 2012 Idiap Research Institute, http://www.idiap.ch/
+ *  Written by Francois Fleuret <francois.fleuret@idiap.ch>
+ *
+ *  This file is part of mtp.
+ *
+ *  mtp is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  mtp is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ *  License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with selector.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+#include "mtp_tracker.h"
+#include "mtp_greedy.h"
+
+// Durations below that are too noisy to be compared
+static const double MIN_COMPARED_DURATION = 0.01;
+
+struct Options {
+  int greedy;
+  // -1 to keep the recorded setting
+  int incremental;
+  int bidirectional;
+  int nb_repeats;
+  double tolerance;
+  double slowdown;
+  int verbose;
+} options;
+
+struct Totals {
+  int nb_records;
+  int nb_mismatches;
+  int nb_slower;
+  int nb_faster;
+  double duration, recorded_duration;
+} totals;
+
+void usage(ostream *os) {
+  (*os) << "mtp_replay [-h|--help] [-v|--verbose] [--engine ksp|greedy] [--incremental on|off]" << endl;
+  (*os) << "           [--bidirectional on|off] [--repeats <n>] [--tolerance <relative error>]" << endl;
+  (*os) << "           [--slowdown <factor>] <replay file> [<replay file> ...]" << endl;
+  (*os) << endl;
+  (*os) << "Tracks again every record of the replay files written with mtp --capture," << endl;
+  (*os) << "and compares the total score and the duration of the tracking with the" << endl;
+  (*os) << "recorded ones. A score which differs by more than --tolerance (1e-4 by" << endl;
+  (*os) << "default) relatively is a mismatch, and a duration more than --slowdown" << endl;
+  (*os) << "(1.5 by default) times the recorded one a regression. With --repeats," << endl;
+  (*os) << "the duration is the best of that many trackings. The exit status is" << endl;
+  (*os) << "non-zero if there is a mismatch or a regression." << endl;
+  (*os) << endl;
+  (*os) << "With --engine greedy, the records are tracked by MTPGreedy, and the" << endl;
+  (*os) << "mismatches show where it is not optimal. --incremental and" << endl;
+  (*os) << "--bidirectional override the recorded settings. With --verbose, the" << endl;
+  (*os) << "recorded and new durations of the phases are printed too." << endl;
+}
+
+void replay(MTPTracker *tracker, ReplayRecord *record, const char *filename, int k) {
+  MTPGreedy greedy;
+  scalar_t score = 0;
+  int nb_trajectories = 0;
+  double duration = 0;
+
+  if(options.incremental >= 0) tracker->incremental_shortest_paths = options.incremental;
+  if(options.bidirectional >= 0) tracker->bidirectional_shortest_paths = options.bidirectional;
+  if(options.verbose) tracker->enable_stats(1);
+
+  for(int r = 0; r < options.nb_repeats; r++) {
+    if(options.verbose) tracker->stats()->reset();
+    double start_time = now_in_seconds();
+    if(options.greedy) {
+      greedy.track(tracker);
+    } else {
+      // As for the capture, the duration is that of track alone
+      tracker->build_graph();
+      start_time = now_in_seconds();
+      tracker->track();
+    }
+    double d = now_in_seconds() - start_time;
+    if(r == 0 || d < duration) duration = d;
+  }
+
+  if(options.greedy) {
+    score = greedy.total_score();
+    nb_trajectories = greedy.nb_trajectories();
+  } else {
+    score = tracker->total_score();
+    nb_trajectories = tracker->nb_trajectories();
+  }
+
+  const char *status = "ok";
+  scalar_t error = scalar_t(fabs(score - record->total_score));
+  if(error > options.tolerance * (1 + fabs(record->total_score))) {
+    status = "MISMATCH";
+    totals.nb_mismatches++;
+  } else if(duration > MIN_COMPARED_DURATION || record->duration > MIN_COMPARED_DURATION) {
+    if(duration > options.slowdown * record->duration) {
+      status = "SLOWER";
+      totals.nb_slower++;
+    } else if(record->duration > options.slowdown * duration) {
+      status = "faster";
+      totals.nb_faster++;
+    }
+  }
+
+  totals.nb_records++;
+  totals.duration += duration;
+  totals.recorded_duration += record->duration;
+
+  cout << filename << ":" << k
+       << " T " << tracker->nb_time_steps
+       << " L " << tracker->nb_locations
+       << " trajectories " << nb_trajectories << " (" << record->nb_trajectories << ")"
+       << " score " << score << " (" << record->total_score << ")"
+       << " time " << duration << "s (" << record->duration << "s) "
+       << status << endl;
+
+  if(options.verbose) {
+    for(int p = 0; p < NB_PHASES; p++) {
+      double d = options.greedy ? 0 : tracker->stats()->phase_durations[p];
+      if(d > 0 || record->phase_durations[p] > 0) {
+        cout << "  " << MTPStats::phase_name(p) << " " << d << "s ("
+             << record->phase_durations[p] << "s)" << endl;
+      }
+    }
+  }
+}
+
+int parse_on_off(const char *s) {
+  if(strcmp(s, "on") == 0) return 1;
+  if(strcmp(s, "off") == 0) return 0;
+  usage(&cerr);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv) {
+  int nb_files = 0;
+
+  options.greedy = 0;
+  options.incremental = -1;
+  options.bidirectional = -1;
+  options.nb_repeats = 1;
+  options.tolerance = 1e-4;
+  options.slowdown = 1.5;
+  options.verbose = 0;
+
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+      usage(&cout);
+      exit(EXIT_SUCCESS);
+    } else if(strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verbose") == 0) {
+      options.verbose = 1;
+    } else if(i + 1 < argc && strcmp(argv[i], "--engine") == 0) {
+      i++;
+      if(strcmp(argv[i], "greedy") == 0) options.greedy = 1;
+      else if(strcmp(argv[i], "ksp") == 0) options.greedy = 0;
+      else { usage(&cerr); exit(EXIT_FAILURE); }
+    } else if(i + 1 < argc && strcmp(argv[i], "--incremental") == 0) {
+      options.incremental = parse_on_off(argv[++i]);
+    } else if(i + 1 < argc && strcmp(argv[i], "--bidirectional") == 0) {
+      options.bidirectional = parse_on_off(argv[++i]);
+    } else if(i + 1 < argc && strcmp(argv[i], "--repeats") == 0) {
+      options.nb_repeats = atoi(argv[++i]);
+    } else if(i + 1 < argc && strcmp(argv[i], "--tolerance") == 0) {
+      options.tolerance = atof(argv[++i]);
+    } else if(i + 1 < argc && strcmp(argv[i], "--slowdown") == 0) {
+      options.slowdown = atof(argv[++i]);
+    } else if(argv[i][0] == '-') {
+      usage(&cerr);
+      exit(EXIT_FAILURE);
+    } else {
+      argv[1 + nb_files++] = argv[i];
+    }
+  }
+
+  if(nb_files == 0 || options.nb_repeats < 1) {
+    usage(&cerr);
+    exit(EXIT_FAILURE);
+  }
+
+  for(int f = 0; f < nb_files; f++) {
+    ifstream in(argv[1 + f], ios::binary);
+    if(in.fail()) {
+      cerr << "Can not open " << argv[1 + f] << "." << endl;
+      exit(EXIT_FAILURE);
+    }
+    ReplayRecord record;
+    for(int k = 0; ; k++) {
+      MTPTracker *tracker = new MTPTracker();
+      if(tracker->read_replay(&in, &record) < 0) {
+        delete tracker;
+        break;
+      }
+      replay(tracker, &record, argv[1 + f], k);
+      delete tracker;
+    }
+  }
+
+  cout << totals.nb_records << " records, "
+       << totals.nb_mismatches << " mismatches, "
+       << totals.nb_slower << " slower, "
+       << totals.nb_faster << " faster, "
+       << totals.duration << "s instead of " << totals.recorded_duration << "s." << endl;
+
+  if(totals.nb_mismatches > 0 || totals.nb_slower > 0) exit(EXIT_FAILURE);
+  exit(EXIT_SUCCESS);
+}
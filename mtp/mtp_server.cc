@@ -0,0 +1,638 @@
+/*
+ *  mtp is the ``Multi Tracked Paths'', an implementation of the
+ *  k-shortest paths algorithm for multi-target tracking.
+ *
+ *  Copyright (c) 2012 Idiap Research Institute, http://www.idiap.ch/
+ *  Written by Francois Fleuret <francois.fleuret@idiap.ch>
+ *
+ *  This file is part of mtp.
+ *
+ *  mtp is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  mtp is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ *  License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with selector.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "mtp_server.h"
+
+#ifndef _WIN32
+
+#include <thread>
+#include <new>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// A topology as received, and the trackers built for it which are not
+// in use
+
+class MTPTopology {
+public:
+  uint64_t key;
+  unsigned char *description;
+  size_t description_size;
+
+  // Pointers into description
+  int nb_time_steps, nb_locations;
+  const int *motion_first, *motion_to;
+  const unsigned char *entrances, *exits;
+
+  MTPTracker **idle_trackers;
+  int nb_idle_trackers;
+  int nb_busy;
+
+  MTPTopology(unsigned char *d, size_t s, int nb_workers) {
+    description = d;
+    description_size = s;
+    const int *header = (const int *) description;
+    nb_time_steps = header[0];
+    nb_locations = header[1];
+    motion_first = header + 3;
+    motion_to = motion_first + nb_locations + 1;
+    entrances = (const unsigned char *) (motion_to + header[2]);
+    exits = entrances + size_t(nb_time_steps) * size_t(nb_locations);
+    // A tracker is created only when all the existing ones are in
+    // use, hence there are never more than nb_workers
+    idle_trackers = new MTPTracker *[nb_workers];
+    nb_idle_trackers = 0;
+    nb_busy = 0;
+  }
+
+  ~MTPTopology() {
+    for(int k = 0; k < nb_idle_trackers; k++) delete idle_trackers[k];
+    delete[] idle_trackers;
+    delete[] description;
+  }
+};
+
+// FNV-1a
+
+static uint64_t hash_bytes(const unsigned char *bytes, size_t size) {
+  uint64_t h = 14695981039346656037ULL;
+  for(size_t k = 0; k < size; k++) {
+    h ^= bytes[k];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static int read_fully(int fd, void *buffer, size_t size) {
+  unsigned char *b = (unsigned char *) buffer;
+  while(size > 0) {
+    ssize_t n = read(fd, b, size);
+    if(n <= 0) return -1;
+    b += n;
+    size -= size_t(n);
+  }
+  return 0;
+}
+
+static int write_fully(int fd, const void *buffer, size_t size) {
+  const unsigned char *b = (const unsigned char *) buffer;
+  while(size > 0) {
+    ssize_t n = write(fd, b, size);
+    if(n <= 0) return -1;
+    b += n;
+    size -= size_t(n);
+  }
+  return 0;
+}
+
+// Gathers the small writes of a reply
+
+class ReplyBuffer {
+  int _fd, _size;
+  unsigned char _buffer[65536];
+public:
+  int error;
+
+  ReplyBuffer(int fd) { _fd = fd; _size = 0; error = 0; }
+
+  void flush() {
+    if(_size > 0 && !error && write_fully(_fd, _buffer, size_t(_size)) < 0) error = 1;
+    _size = 0;
+  }
+
+  void add(const void *data, int size) {
+    if(_size + size > int(sizeof(_buffer))) flush();
+    memcpy(_buffer + _size, data, size_t(size));
+    _size += size;
+  }
+};
+
+static int set_socket_address(struct sockaddr_un *address, const char *socket_path) {
+  memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  if(strlen(socket_path) >= sizeof(address->sun_path)) return -1;
+  strcpy(address->sun_path, socket_path);
+  return 0;
+}
+
+MTPServer::MTPServer() {
+  _topologies = 0;
+  _nb_topologies = 0;
+  _max_nb_topologies = 0;
+  _pending_connections = 0;
+  _nb_pending_connections = 0;
+  time_budget = 0;
+  nb_workers = 0;
+  cache_size = 16;
+  verbose = 0;
+}
+
+MTPServer::~MTPServer() {
+  for(int k = 0; k < _nb_topologies; k++) {
+    delete _topologies[k];
+  }
+  delete[] _topologies;
+  delete[] _pending_connections;
+}
+
+MTPTopology *MTPServer::acquire(uint64_t key, MTPTracker **tracker) {
+  MTPTopology *topology = 0;
+  *tracker = 0;
+
+  {
+    lock_guard<mutex> lock(_cache_mutex);
+    for(int k = 0; k < _nb_topologies; k++) {
+      if(_topologies[k]->key == key) {
+        topology = _topologies[k];
+        // Move it to the end, as the most recently used
+        for(int j = k; j < _nb_topologies - 1; j++) _topologies[j] = _topologies[j + 1];
+        _topologies[_nb_topologies - 1] = topology;
+        topology->nb_busy++;
+        if(topology->nb_idle_trackers > 0) {
+          *tracker = topology->idle_trackers[--topology->nb_idle_trackers];
+        }
+        break;
+      }
+    }
+  }
+
+  // Since it is busy, the topology can not be evicted, and we can
+  // build the tracker without holding the lock
+  if(topology && !*tracker) {
+    MTPTracker *t = new MTPTracker();
+    t->copy_options(&options);
+    // The tracker aborts on a grid which does not fit the locations
+    if(((options.coarse_cell_size > 1 || options.vertex_order != MTPTracker::ORDER_LOCATION) &&
+        topology->nb_locations % options.grid_width != 0) ||
+       t->allocate(topology->nb_time_steps, topology->nb_locations,
+                   topology->motion_first, topology->motion_to) < 0) {
+      delete t;
+      lock_guard<mutex> lock(_cache_mutex);
+      topology->nb_busy--;
+      return topology;
+    }
+    for(int u = 0; u < topology->nb_time_steps; u++) {
+      for(int l = 0; l < topology->nb_locations; l++) {
+        t->entrances[u][l] = topology->entrances[u * topology->nb_locations + l];
+        t->exits[u][l] = topology->exits[u * topology->nb_locations + l];
+      }
+    }
+    // The gating depends on the scores, and build_graph has then to
+    // be done for every request
+    if(!t->gating && t->build_graph() < 0) {
+      delete t;
+      lock_guard<mutex> lock(_cache_mutex);
+      topology->nb_busy--;
+      return topology;
+    }
+    *tracker = t;
+  }
+
+  return topology;
+}
+
+void MTPServer::release(MTPTopology *topology, MTPTracker *tracker) {
+  lock_guard<mutex> lock(_cache_mutex);
+  topology->idle_trackers[topology->nb_idle_trackers++] = tracker;
+  topology->nb_busy--;
+}
+
+int MTPServer::insert(unsigned char *description, size_t description_size, uint64_t *key) {
+  *key = hash_bytes(description, description_size);
+
+  lock_guard<mutex> lock(_cache_mutex);
+
+  for(int k = 0; k < _nb_topologies; k++) {
+    if(_topologies[k]->key == *key) {
+      int same = _topologies[k]->description_size == description_size &&
+        memcmp(_topologies[k]->description, description, description_size) == 0;
+      delete[] description;
+      // A collision of the hash is too unlikely to be worth handling,
+      // but must not be taken for the cached topology
+      if(!same && verbose) cout << "Collision on topology " << *key << "." << endl;
+      return same ? 0 : -1;
+    }
+  }
+
+  // Evict the least recently used topologies not in use
+  int k = 0;
+  while(_nb_topologies >= cache_size && k < _nb_topologies) {
+    if(_topologies[k]->nb_busy == 0) {
+      if(verbose) cout << "Evicting topology " << _topologies[k]->key << "." << endl;
+      delete _topologies[k];
+      for(int j = k; j < _nb_topologies - 1; j++) _topologies[j] = _topologies[j + 1];
+      _nb_topologies--;
+    } else {
+      k++;
+    }
+  }
+
+  // At most nb_workers topologies are in use, so this is never full
+  ASSERT(_nb_topologies < _max_nb_topologies);
+  MTPTopology *topology = new MTPTopology(description, description_size, nb_workers);
+  topology->key = *key;
+  _topologies[_nb_topologies++] = topology;
+
+  if(verbose) cout << "Cached topology " << *key << "." << endl;
+
+  return 0;
+}
+
+void MTPServer::handle_connection(int fd) {
+  int type, header[3], status, nb_trajectories, interrupted;
+  uint64_t key;
+  double budget;
+  scalar_t total_score, score;
+
+  while(1) {
+    // The client is done
+    if(read_fully(fd, &type, sizeof(type)) < 0) {
+      close(fd);
+      return;
+    }
+
+    ReplyBuffer reply(fd);
+
+    if(type == MTP_MESSAGE_TOPOLOGY) {
+      if(read_fully(fd, header, sizeof(header)) < 0) break;
+      int nb_time_steps = header[0], nb_locations = header[1], nb_motions = header[2];
+      if(nb_time_steps <= 0 || nb_locations <= 0 || nb_motions < 0 ||
+         (long long) nb_time_steps * nb_locations > INT_MAX / 2 ||
+         (long long) nb_motions > (long long) nb_locations * nb_locations) {
+        break;
+      }
+
+      size_t description_size = sizeof(header)
+        + sizeof(int) * size_t(nb_locations + 1 + nb_motions)
+        + 2 * size_t(nb_time_steps) * size_t(nb_locations);
+      if(options.memory_budget > 0 && description_size > options.memory_budget) break;
+      // A client must not be able to kill the server
+      unsigned char *description = new (nothrow) unsigned char[description_size];
+      if(!description) break;
+      memcpy(description, header, sizeof(header));
+      if(read_fully(fd, description + sizeof(header), description_size - sizeof(header)) < 0) {
+        delete[] description;
+        break;
+      }
+
+      const int *motion_first = (const int *) (description + sizeof(header));
+      const int *motion_to = motion_first + nb_locations + 1;
+      int valid = motion_first[0] == 0 && motion_first[nb_locations] == nb_motions;
+      for(int l = 0; valid && l < nb_locations; l++) {
+        valid = motion_first[l] <= motion_first[l + 1];
+      }
+      for(int k = 0; valid && k < nb_motions; k++) {
+        valid = motion_to[k] >= 0 && motion_to[k] < nb_locations;
+      }
+      if(!valid) {
+        delete[] description;
+        break;
+      }
+
+      status = insert(description, description_size, &key) < 0 ? MTP_STATUS_ERROR : MTP_STATUS_OK;
+      reply.add(&status, sizeof(status));
+      reply.add(&key, sizeof(key));
+      reply.flush();
+      if(status == MTP_STATUS_ERROR) {
+        close(fd);
+        return;
+      }
+    }
+
+    else if(type == MTP_MESSAGE_SOLVE) {
+      if(read_fully(fd, &key, sizeof(key)) < 0 ||
+         read_fully(fd, header, 2 * sizeof(int)) < 0 ||
+         read_fully(fd, &budget, sizeof(budget)) < 0) break;
+      int nb_time_steps = header[0], nb_locations = header[1];
+      if(nb_time_steps <= 0 || nb_locations <= 0 ||
+         (long long) nb_time_steps * nb_locations > INT_MAX / 2) {
+        break;
+      }
+
+      size_t scores_size = sizeof(scalar_t) * size_t(nb_time_steps) * size_t(nb_locations);
+      if(options.memory_budget > 0 && scores_size > options.memory_budget) break;
+      scalar_t *scores = new (nothrow) scalar_t[size_t(nb_time_steps) * size_t(nb_locations)];
+      if(!scores) break;
+      if(read_fully(fd, scores, scores_size) < 0) {
+        delete[] scores;
+        break;
+      }
+
+      double start_time = now_in_seconds();
+      MTPTracker *tracker;
+      MTPTopology *topology = acquire(key, &tracker);
+
+      nb_trajectories = 0;
+      interrupted = 0;
+      total_score = 0;
+
+      if(!topology) {
+        status = MTP_STATUS_UNKNOWN_TOPOLOGY;
+      } else if(!tracker) {
+        // Over the memory budget, and already released
+        topology = 0;
+        status = MTP_STATUS_ERROR;
+      } else if(topology->nb_time_steps != nb_time_steps ||
+                topology->nb_locations != nb_locations) {
+        release(topology, tracker);
+        topology = 0;
+        status = MTP_STATUS_ERROR;
+      } else {
+        // The tracker reads the scores where we received them
+        tracker->borrow_detection_scores(scores);
+        if((tracker->gating && tracker->build_graph() < 0) ||
+           tracker->track(budget > 0 ? budget : time_budget) < 0) {
+          status = MTP_STATUS_ERROR;
+        } else {
+          status = MTP_STATUS_OK;
+        }
+        nb_trajectories = tracker->nb_trajectories();
+        interrupted = tracker->interrupted();
+        total_score = tracker->total_score();
+        if(verbose) {
+          cout << "Solved on topology " << key << " in "
+               << now_in_seconds() - start_time << "s." << endl;
+        }
+      }
+
+      reply.add(&status, sizeof(status));
+      reply.add(&nb_trajectories, sizeof(nb_trajectories));
+      reply.add(&interrupted, sizeof(interrupted));
+      reply.add(&total_score, sizeof(total_score));
+
+      for(int k = 0; k < nb_trajectories; k++) {
+        int entrance_time = tracker->trajectory_entrance_time(k);
+        int duration = tracker->trajectory_duration(k);
+        score = tracker->trajectory_score(k);
+        reply.add(&entrance_time, sizeof(entrance_time));
+        reply.add(&duration, sizeof(duration));
+        reply.add(&score, sizeof(score));
+        for(int u = 0; u < duration; u++) {
+          int location = tracker->trajectory_location(k, u);
+          reply.add(&location, sizeof(location));
+        }
+      }
+
+      if(topology) release(topology, tracker);
+      delete[] scores;
+
+      reply.flush();
+      if(status == MTP_STATUS_ERROR) {
+        close(fd);
+        return;
+      }
+    }
+
+    else {
+      break;
+    }
+
+    if(reply.error) break;
+  }
+
+  // We get here only on a malformed message
+  status = MTP_STATUS_ERROR;
+  write_fully(fd, &status, sizeof(status));
+  close(fd);
+}
+
+void MTPServer::worker() {
+  while(1) {
+    int fd;
+    {
+      unique_lock<mutex> lock(_queue_mutex);
+      while(_nb_pending_connections == 0) _queue_condition.wait(lock);
+      fd = _pending_connections[0];
+      for(int k = 0; k < _nb_pending_connections - 1; k++) {
+        _pending_connections[k] = _pending_connections[k + 1];
+      }
+      _nb_pending_connections--;
+      // The accept loop may be waiting for room in the queue
+      _queue_condition.notify_all();
+    }
+    handle_connection(fd);
+  }
+}
+
+int MTPServer::serve(const char *socket_path) {
+  struct sockaddr_un address;
+
+  if(nb_workers <= 0) nb_workers = int(thread::hardware_concurrency());
+  if(nb_workers <= 0) nb_workers = 1;
+  if(cache_size <= 0) cache_size = 1;
+
+  _max_nb_topologies = cache_size + nb_workers;
+  _topologies = new MTPTopology *[_max_nb_topologies];
+  _pending_connections = new int[nb_workers];
+
+  if(set_socket_address(&address, socket_path) < 0) {
+    cerr << "The socket path " << socket_path << " is too long." << endl;
+    return -1;
+  }
+
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  // Remove a socket left by a previous server
+  unlink(socket_path);
+  if(listen_fd < 0 ||
+     bind(listen_fd, (struct sockaddr *) &address, sizeof(address)) < 0 ||
+     listen(listen_fd, 64) < 0) {
+    cerr << "Can not listen on " << socket_path << ": " << strerror(errno) << endl;
+    return -1;
+  }
+
+  // A client leaving in the middle of a reply should not kill us
+  signal(SIGPIPE, SIG_IGN);
+
+  for(int w = 0; w < nb_workers; w++) {
+    thread(&MTPServer::worker, this).detach();
+  }
+
+  if(verbose) {
+    cout << "Listening on " << socket_path << " with " << nb_workers << " workers." << endl;
+  }
+
+  while(1) {
+    int fd = accept(listen_fd, 0, 0);
+    if(fd < 0) continue;
+    unique_lock<mutex> lock(_queue_mutex);
+    // Wait for a worker to take the connections already there
+    while(_nb_pending_connections == nb_workers) _queue_condition.wait(lock);
+    _pending_connections[_nb_pending_connections++] = fd;
+    _queue_condition.notify_all();
+  }
+}
+
+MTPClient::MTPClient() {
+  _fd = -1;
+}
+
+MTPClient::~MTPClient() {
+  if(_fd >= 0) close(_fd);
+}
+
+int MTPClient::connect(const char *socket_path) {
+  struct sockaddr_un address;
+  // The server closes the connection on a message it rejects, maybe
+  // while we are still writing it
+  signal(SIGPIPE, SIG_IGN);
+  if(set_socket_address(&address, socket_path) < 0) return -1;
+  _fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(_fd < 0) return -1;
+  if(::connect(_fd, (struct sockaddr *) &address, sizeof(address)) < 0) {
+    close(_fd);
+    _fd = -1;
+    return -1;
+  }
+  return 0;
+}
+
+int MTPClient::send_topology(MTPTracker *tracker, uint64_t *key) {
+  int nb_time_steps = tracker->nb_time_steps, nb_locations = tracker->nb_locations;
+  int nb_motions = 0, status;
+
+  ASSERT(tracker->allowed_motions);
+
+  int *motion_first = new int[nb_locations + 1];
+  for(int l = 0; l < nb_locations; l++) {
+    motion_first[l] = nb_motions;
+    for(int m = 0; m < nb_locations; m++) {
+      if(tracker->allowed_motions[l][m]) nb_motions++;
+    }
+  }
+  motion_first[nb_locations] = nb_motions;
+
+  int *motion_to = new int[nb_motions];
+  nb_motions = 0;
+  for(int l = 0; l < nb_locations; l++) {
+    for(int m = 0; m < nb_locations; m++) {
+      if(tracker->allowed_motions[l][m]) motion_to[nb_motions++] = m;
+    }
+  }
+
+  size_t nb_flags = size_t(nb_time_steps) * size_t(nb_locations);
+  unsigned char *flags = new unsigned char[2 * nb_flags];
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int l = 0; l < nb_locations; l++) {
+      flags[size_t(t) * size_t(nb_locations) + size_t(l)] = tracker->entrances[t][l] != 0;
+      flags[nb_flags + size_t(t) * size_t(nb_locations) + size_t(l)] = tracker->exits[t][l] != 0;
+    }
+  }
+
+  int header[4] = { MTP_MESSAGE_TOPOLOGY, nb_time_steps, nb_locations, nb_motions };
+  int result = -1;
+  if(write_fully(_fd, header, sizeof(header)) == 0 &&
+     write_fully(_fd, motion_first, sizeof(int) * size_t(nb_locations + 1)) == 0 &&
+     write_fully(_fd, motion_to, sizeof(int) * size_t(nb_motions)) == 0 &&
+     write_fully(_fd, flags, 2 * nb_flags) == 0 &&
+     read_fully(_fd, &status, sizeof(status)) == 0 &&
+     status == MTP_STATUS_OK &&
+     read_fully(_fd, key, sizeof(*key)) == 0) {
+    result = 0;
+  }
+
+  delete[] flags;
+  delete[] motion_to;
+  delete[] motion_first;
+
+  return result;
+}
+
+int MTPClient::solve(uint64_t key, MTPTracker *tracker, double time_budget,
+                     ostream *os, int *status, int *interrupted) {
+  int nb_time_steps = tracker->nb_time_steps, nb_locations = tracker->nb_locations;
+  int type = MTP_MESSAGE_SOLVE, size[2] = { nb_time_steps, nb_locations };
+  int nb_trajectories, entrance_time, duration, location;
+  scalar_t total_score, score;
+
+  if(write_fully(_fd, &type, sizeof(type)) < 0 ||
+     write_fully(_fd, &key, sizeof(key)) < 0 ||
+     write_fully(_fd, size, sizeof(size)) < 0 ||
+     write_fully(_fd, &time_budget, sizeof(time_budget)) < 0) return -1;
+
+  for(int t = 0; t < nb_time_steps; t++) {
+    if(write_fully(_fd, tracker->detection_scores[t], sizeof(scalar_t) * size_t(nb_locations)) < 0) {
+      return -1;
+    }
+  }
+
+  if(read_fully(_fd, status, sizeof(*status)) < 0 ||
+     read_fully(_fd, &nb_trajectories, sizeof(nb_trajectories)) < 0 ||
+     read_fully(_fd, interrupted, sizeof(*interrupted)) < 0 ||
+     read_fully(_fd, &total_score, sizeof(total_score)) < 0) return -1;
+
+  if(*status != MTP_STATUS_OK) return 0;
+
+  (*os) << nb_trajectories << endl;
+  for(int k = 0; k < nb_trajectories; k++) {
+    if(read_fully(_fd, &entrance_time, sizeof(entrance_time)) < 0 ||
+       read_fully(_fd, &duration, sizeof(duration)) < 0 ||
+       read_fully(_fd, &score, sizeof(score)) < 0) return -1;
+    (*os) << k << " " << entrance_time << " " << duration << " " << score;
+    for(int u = 0; u < duration; u++) {
+      if(read_fully(_fd, &location, sizeof(location)) < 0) return -1;
+      (*os) << " " << location;
+    }
+    (*os) << endl;
+  }
+
+  return 0;
+}
+
+#else
+
+MTPServer::MTPServer() {
+  _topologies = 0;
+  _nb_topologies = 0;
+  _max_nb_topologies = 0;
+  _pending_connections = 0;
+  _nb_pending_connections = 0;
+  time_budget = 0;
+  nb_workers = 0;
+  cache_size = 16;
+  verbose = 0;
+}
+
+MTPServer::~MTPServer() { }
+
+int MTPServer::serve(const char *socket_path) {
+  cerr << "The tracking server needs unix sockets." << endl;
+  return -1;
+}
+
+MTPClient::MTPClient() { _fd = -1; }
+
+MTPClient::~MTPClient() { }
+
+int MTPClient::connect(const char *socket_path) { return -1; }
+
+int MTPClient::send_topology(MTPTracker *tracker, uint64_t *key) { return -1; }
+
+int MTPClient::solve(uint64_t key, MTPTracker *tracker, double time_budget,
+                     ostream *os, int *status, int *interrupted) { return -1; }
+
+#endif
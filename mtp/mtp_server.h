@@ -0,0 +1,156 @@
+/*
+ *  mtp is the ``Multi Tracked Paths'', an implementation of the
+ *  k-shortest paths algorithm for multi-target tracking.
+ *
+ *  Copyright (c) 2012 Idiap Research Institute, http://www.idiap.ch/
+ *  Written by Francois Fleuret <francois.fleuret@idiap.ch>
+ *
+ *  This file is part of mtp.
+ *
+ *  mtp is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  mtp is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ *  License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with selector.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MTP_SERVER_H
+#define MTP_SERVER_H
+
+#include <iostream>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+
+using namespace std;
+
+#include "mtp_tracker.h"
+
+// A tracking daemon listening on a unix socket, which keeps the
+// trackers built for the topologies it received, so that a request
+// costs only the tracking itself.
+//
+// All the values are in the native byte order, since the socket is
+// local. A client first sends a topology
+//
+//   int32:MTP_MESSAGE_TOPOLOGY int32:T int32:L int32:nb_motions
+//   int32:motion_first[L+1] int32:motion_to[nb_motions]
+//   uint8:entrances[T*L] uint8:exits[T*L]
+//
+// where the locations reachable from l are motion_to[motion_first[l]]
+// to motion_to[motion_first[l+1]-1], and the server replies
+//
+//   int32:status uint64:key
+//
+// with the key identifying that topology, computed from its content,
+// so that a client can reuse it across connections. Then any number
+// of
+//
+//   int32:MTP_MESSAGE_SOLVE uint64:key int32:T int32:L float64:time_budget
+//   float32:scores[T*L]
+//
+// to which the server replies
+//
+//   int32:status int32:nb_trajectories int32:interrupted float32:total_score
+//
+// followed, if status is MTP_STATUS_OK, by nb_trajectories times
+//
+//   int32:entrance_time int32:duration float32:score int32:locations[duration]
+//
+// where T and L have to be the ones of the topology. A time budget of
+// zero stands for the one of the server. If the status is
+// MTP_STATUS_UNKNOWN_TOPOLOGY, the topology was evicted from the cache
+// and has to be sent again. A malformed message, one larger than the
+// memory budget of the server, a topology whose key is already the
+// one of another, or a tracking over that budget gets
+// MTP_STATUS_ERROR, and the connection is closed.
+
+enum {
+  MTP_MESSAGE_TOPOLOGY = 1,
+  MTP_MESSAGE_SOLVE = 2
+};
+
+enum {
+  MTP_STATUS_OK = 0,
+  MTP_STATUS_UNKNOWN_TOPOLOGY = 1,
+  MTP_STATUS_ERROR = 2
+};
+
+class MTPTopology;
+
+class MTPServer {
+  // The cached topologies, the most recently used last
+  MTPTopology **_topologies;
+  int _nb_topologies, _max_nb_topologies;
+  mutex _cache_mutex;
+
+  // The connections waiting for a worker
+  int *_pending_connections;
+  int _nb_pending_connections;
+  mutex _queue_mutex;
+  condition_variable _queue_condition;
+
+  // Returns the topology of the given key, with a tracker reserved
+  // for the caller, or null if it is not in the cache. If the tracker
+  // can not be built within the memory budget, or on the grid of the
+  // options, *tracker is null, and
+  // the topology must not be released.
+  MTPTopology *acquire(uint64_t key, MTPTracker **tracker);
+  void release(MTPTopology *topology, MTPTracker *tracker);
+  // Caches the description, which it takes over, and sets *key to its
+  // key. Returns -1 and deletes it if another description has the
+  // same key.
+  int insert(unsigned char *description, size_t description_size, uint64_t *key);
+
+  void worker();
+  void handle_connection(int fd);
+public:
+  // Every tracker is configured as this one, and the time budget of
+  // the requests which do not specify one
+  MTPTracker options;
+  double time_budget;
+
+  int nb_workers;
+  // Number of topologies kept when none is in use
+  int cache_size;
+  int verbose;
+
+  MTPServer();
+  ~MTPServer();
+
+  // Listens on the given socket, and never returns unless it can not
+  // be created, in which case it returns -1
+  int serve(const char *socket_path);
+};
+
+// A client of the above, which writes the trajectories in the format
+// of MTPTracker::write_trajectories
+
+class MTPClient {
+  int _fd;
+public:
+  MTPClient();
+  ~MTPClient();
+
+  // All return 0 on success and -1 on failure
+  int connect(const char *socket_path);
+
+  // Sends the topology of the tracker and gets its key
+  int send_topology(MTPTracker *tracker, uint64_t *key);
+
+  // Sends the scores of the tracker, which has to have the same
+  // topology as the one of the key, and writes the trajectories. The
+  // status is stored in status, and interrupted is set if the time
+  // budget was exhausted.
+  int solve(uint64_t key, MTPTracker *tracker, double time_budget,
+            ostream *os, int *status, int *interrupted);
+};
+
+#endif
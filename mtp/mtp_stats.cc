@@ -0,0 +1,279 @@
+/*
+ *  mtp is the ``Multi Tracked Paths'', an implementation of the
+ *  k-shortest paths algorithm for multi-target tracking.
+ *
+ *  Copyright (c) 2012 Idiap Research Institute, http://www.idiap.ch/
+ *  Written by Francois Fleuret <francois.fleuret@idiap.ch>
+ *
+ *  This file is part of mtp.
+ *
+ *  mtp is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  mtp is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ *  License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with selector.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "mtp_stats.h"
+
+MTPStats::MTPStats() {
+  _shortest_paths_size = 0;
+  shortest_paths = 0;
+  _perf_counters = 0;
+  for(int c = 0; c < NB_COUNTERS; c++) counters_available[c] = 0;
+  reset();
+}
+
+MTPStats::~MTPStats() {
+  delete[] shortest_paths;
+  delete _perf_counters;
+}
+
+void MTPStats::reset() {
+  for(int p = 0; p < NB_PHASES; p++) {
+    phase_durations[p] = 0;
+    phase_counts[p] = 0;
+    for(int c = 0; c < NB_COUNTERS; c++) phase_counters[p][c] = 0;
+  }
+  _nb_running_phases = 0;
+  nb_vertices = 0;
+  nb_edges = 0;
+  pruning_ratio = 0;
+  nb_corridor_widenings = 0;
+  quantization_max_error = 0;
+  quantization_score_error = 0;
+  nb_initial_paths = 0;
+  nb_cancelled_cycles = 0;
+  nb_removed_paths = 0;
+  nb_augmentations = 0;
+  stop_reason = STOP_NO_IMPROVING_PATH;
+  heap_pushes = 0;
+  heap_pops = 0;
+  sift_steps = 0;
+  relaxations = 0;
+  settled_vertices = 0;
+  residual_clamp_total = 0;
+  residual_clamp_max = 0;
+  nb_shortest_paths = 0;
+}
+
+int MTPStats::enable_perf_counters(int enabled) {
+  int nb_available = 0;
+  delete _perf_counters;
+  _perf_counters = 0;
+  if(enabled) {
+    _perf_counters = new PerfCounters();
+    nb_available = _perf_counters->open();
+    if(nb_available == 0) {
+      delete _perf_counters;
+      _perf_counters = 0;
+    }
+  }
+  for(int c = 0; c < NB_COUNTERS; c++) {
+    counters_available[c] = _perf_counters && _perf_counters->available(c);
+  }
+  return nb_available;
+}
+
+void MTPStats::read_counters(long long *values) {
+  if(_perf_counters) {
+    _perf_counters->read(values);
+  } else {
+    for(int c = 0; c < NB_COUNTERS; c++) values[c] = -1;
+  }
+}
+
+void MTPStats::begin_phase(int phase) {
+  ASSERT(_nb_running_phases < NB_PHASES);
+  int k = _nb_running_phases++;
+  _running_phases[k] = phase;
+  _nested_durations[k] = 0;
+  for(int c = 0; c < NB_COUNTERS; c++) _nested_counters[k][c] = 0;
+  // Read the clock last, so that reading the counters is not measured
+  read_counters(_start_counters[k]);
+  _start_times[k] = now_in_seconds();
+}
+
+double MTPStats::end_phase(int phase, long long *counters) {
+  double end_time = now_in_seconds();
+  long long end_counters[NB_COUNTERS], delta;
+  read_counters(end_counters);
+
+  ASSERT(_nb_running_phases > 0 && _running_phases[_nb_running_phases - 1] == phase);
+  int k = --_nb_running_phases;
+
+  double duration = end_time - _start_times[k];
+  phase_durations[phase] += duration - _nested_durations[k];
+  phase_counts[phase]++;
+  if(k > 0) _nested_durations[k - 1] += duration;
+
+  for(int c = 0; c < NB_COUNTERS; c++) {
+    if(end_counters[c] >= 0 && _start_counters[k][c] >= 0) {
+      delta = end_counters[c] - _start_counters[k][c];
+      phase_counters[phase][c] += delta - _nested_counters[k][c];
+      if(k > 0) _nested_counters[k - 1][c] += delta;
+      if(counters) counters[c] = delta - _nested_counters[k][c];
+    } else if(counters) {
+      counters[c] = -1;
+    }
+  }
+
+  return duration - _nested_durations[k];
+}
+
+ShortestPathStats *MTPStats::new_shortest_path() {
+  if(nb_shortest_paths == _shortest_paths_size) {
+    _shortest_paths_size = 2 * _shortest_paths_size + 16;
+    ShortestPathStats *tmp = new ShortestPathStats[_shortest_paths_size];
+    for(int k = 0; k < nb_shortest_paths; k++) tmp[k] = shortest_paths[k];
+    delete[] shortest_paths;
+    shortest_paths = tmp;
+  }
+  ShortestPathStats *s = &shortest_paths[nb_shortest_paths++];
+  s->augmented = 0;
+  s->duration = 0;
+  s->heap_pushes = 0;
+  s->heap_pops = 0;
+  s->sift_steps = 0;
+  s->relaxations = 0;
+  s->settled_vertices = 0;
+  s->path_length = 0;
+  s->path_nb_edges = 0;
+  s->residual_clamp = 0;
+  for(int c = 0; c < NB_COUNTERS; c++) s->counters[c] = -1;
+  return s;
+}
+
+const char *MTPStats::phase_name(int phase) {
+  switch(phase) {
+  case PHASE_READ: return "read";
+  case PHASE_COARSE_SOLVE: return "coarse_solve";
+  case PHASE_BUILD_GRAPH: return "build_graph";
+  case PHASE_DP_ORDERING: return "dp_ordering";
+  case PHASE_DP_DISTANCES: return "dp_distances";
+  case PHASE_INITIAL_PATHS: return "initial_paths";
+  case PHASE_POSITIVIZATION: return "positivization";
+  case PHASE_SHORTEST_PATH: return "shortest_path";
+  case PHASE_AUGMENTATION: return "augmentation";
+  case PHASE_RETRIEVAL: return "retrieval";
+  default: return "unknown";
+  }
+}
+
+const char *MTPStats::stop_reason_name(int reason) {
+  switch(reason) {
+  case STOP_NO_IMPROVING_PATH: return "no_improving_path";
+  case STOP_MAX_PATHS: return "max_paths";
+  case STOP_MIN_GAIN: return "min_gain";
+  case STOP_NO_PATH: return "no_path";
+  case STOP_DEADLINE: return "deadline";
+  case STOP_CANCELLED: return "cancelled";
+  default: return "unknown";
+  }
+}
+
+void MTPStats::print(ostream *os) {
+  for(int p = 0; p < NB_PHASES; p++) {
+    if(phase_counts[p] > 0) {
+      (*os) << phase_name(p) << " " << phase_durations[p] << "s";
+      if(phase_counts[p] > 1) (*os) << " (" << phase_counts[p] << " times)";
+      for(int c = 0; c < NB_COUNTERS; c++) {
+        if(counters_available[c]) {
+          (*os) << " " << PerfCounters::counter_name(c) << " " << phase_counters[p][c];
+        }
+      }
+      (*os) << endl;
+    }
+  }
+  (*os) << "vertices " << nb_vertices
+        << " edges " << nb_edges
+        << " pruning ratio " << pruning_ratio << endl;
+  if(nb_corridor_widenings > 0) {
+    (*os) << "corridor widenings " << nb_corridor_widenings << endl;
+  }
+  if(quantization_max_error > 0) {
+    (*os) << "quantization max error " << quantization_max_error
+          << " score error at most " << quantization_score_error << endl;
+  }
+  if(nb_initial_paths > 0) {
+    (*os) << "initial paths " << nb_initial_paths
+          << " cancelled cycles " << nb_cancelled_cycles
+          << " removed paths " << nb_removed_paths << endl;
+  }
+  (*os) << "augmentations " << nb_augmentations
+        << " stopped by " << stop_reason_name(stop_reason) << endl;
+  (*os) << "heap pushes " << heap_pushes
+        << " pops " << heap_pops
+        << " sift steps " << sift_steps << endl;
+  (*os) << "relaxations " << relaxations
+        << " settled vertices " << settled_vertices << endl;
+  (*os) << "residual clamp total " << residual_clamp_total
+        << " max " << residual_clamp_max << endl;
+}
+
+void MTPStats::write_json_counters(ostream *os, long long *counters) {
+  for(int c = 0; c < NB_COUNTERS; c++) {
+    (*os) << ", \"" << PerfCounters::counter_name(c) << "\": ";
+    if(counters_available[c]) (*os) << counters[c];
+    else (*os) << "null";
+  }
+}
+
+void MTPStats::write_json(ostream *os) {
+  (*os) << "{" << endl;
+  (*os) << "  \"phases\": {";
+  for(int p = 0; p < NB_PHASES; p++) {
+    if(p > 0) (*os) << ",";
+    (*os) << endl << "    \"" << phase_name(p) << "\": {"
+          << "\"duration\": " << phase_durations[p]
+          << ", \"count\": " << phase_counts[p];
+    write_json_counters(os, phase_counters[p]);
+    (*os) << "}";
+  }
+  (*os) << endl << "  }," << endl;
+  (*os) << "  \"nb_vertices\": " << nb_vertices << "," << endl;
+  (*os) << "  \"nb_edges\": " << nb_edges << "," << endl;
+  (*os) << "  \"pruning_ratio\": " << pruning_ratio << "," << endl;
+  (*os) << "  \"nb_corridor_widenings\": " << nb_corridor_widenings << "," << endl;
+  (*os) << "  \"quantization_max_error\": " << quantization_max_error << "," << endl;
+  (*os) << "  \"quantization_score_error\": " << quantization_score_error << "," << endl;
+  (*os) << "  \"nb_initial_paths\": " << nb_initial_paths << "," << endl;
+  (*os) << "  \"nb_cancelled_cycles\": " << nb_cancelled_cycles << "," << endl;
+  (*os) << "  \"nb_removed_paths\": " << nb_removed_paths << "," << endl;
+  (*os) << "  \"nb_augmentations\": " << nb_augmentations << "," << endl;
+  (*os) << "  \"stop_reason\": \"" << stop_reason_name(stop_reason) << "\"," << endl;
+  (*os) << "  \"heap_pushes\": " << heap_pushes << "," << endl;
+  (*os) << "  \"heap_pops\": " << heap_pops << "," << endl;
+  (*os) << "  \"sift_steps\": " << sift_steps << "," << endl;
+  (*os) << "  \"relaxations\": " << relaxations << "," << endl;
+  (*os) << "  \"settled_vertices\": " << settled_vertices << "," << endl;
+  (*os) << "  \"residual_clamp_total\": " << residual_clamp_total << "," << endl;
+  (*os) << "  \"residual_clamp_max\": " << residual_clamp_max << "," << endl;
+  (*os) << "  \"shortest_paths\": [";
+  for(int k = 0; k < nb_shortest_paths; k++) {
+    ShortestPathStats *s = &shortest_paths[k];
+    if(k > 0) (*os) << ",";
+    (*os) << endl << "    {"
+          << "\"augmented\": " << s->augmented
+          << ", \"duration\": " << s->duration
+          << ", \"heap_pushes\": " << s->heap_pushes
+          << ", \"heap_pops\": " << s->heap_pops
+          << ", \"sift_steps\": " << s->sift_steps
+          << ", \"relaxations\": " << s->relaxations
+          << ", \"settled_vertices\": " << s->settled_vertices
+          << ", \"path_length\": " << s->path_length
+          << ", \"path_nb_edges\": " << s->path_nb_edges
+          << ", \"residual_clamp\": " << s->residual_clamp;
+    write_json_counters(os, s->counters);
+    (*os) << "}";
+  }
+  (*os) << endl << "  ]" << endl;
+  (*os) << "}" << endl;
+}
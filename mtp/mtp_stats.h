@@ -0,0 +1,172 @@
+/*
+ *  mtp is the ``Multi Tracked Paths'', an implementation of the
+ *  k-shortest paths algorithm for multi-target tracking.
+ *
+ *  Copyright (c) 2012 Idiap Research Institute, http://www.idiap.ch/
+ *  Written by Francois Fleuret <francois.fleuret@idiap.ch>
+ *
+ *  This file is part of mtp.
+ *
+ *  mtp is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  mtp is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ *  License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with selector.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MTP_STATS_H
+#define MTP_STATS_H
+
+#include <iostream>
+
+using namespace std;
+
+#include "misc.h"
+#include "perf_counters.h"
+
+// The phases of a tracking, for which MTPStats accumulates the
+// wall-clock time.
+
+enum {
+  PHASE_READ,
+  PHASE_COARSE_SOLVE,
+  PHASE_BUILD_GRAPH,
+  PHASE_DP_ORDERING,
+  PHASE_DP_DISTANCES,
+  PHASE_INITIAL_PATHS,
+  PHASE_POSITIVIZATION,
+  PHASE_SHORTEST_PATH,
+  PHASE_AUGMENTATION,
+  PHASE_RETRIEVAL,
+  NB_PHASES
+};
+
+// Why find_best_paths stopped adding paths
+
+enum {
+  STOP_NO_IMPROVING_PATH,
+  STOP_MAX_PATHS,
+  STOP_MIN_GAIN,
+  STOP_NO_PATH,
+  STOP_DEADLINE,
+  STOP_CANCELLED,
+  NB_STOP_REASONS
+};
+
+// What happened during one call to find_shortest_path, and to the
+// path it found. The last one of a find_best_paths does not augment
+// the flow, since it is the one which shows there is no path of
+// negative length left.
+
+class ShortestPathStats {
+public:
+  int augmented;
+  double duration;
+  long long heap_pushes, heap_pops, sift_steps;
+  long long relaxations, settled_vertices;
+  // Length of the path, according to the original edge lengths, and
+  // number of edges, or 0 if the sink was not reached
+  scalar_t path_length;
+  int path_nb_edges;
+  // Total of the negative positivized lengths clamped to zero just
+  // before this shortest path computation
+  scalar_t residual_clamp;
+  // The hardware counters during the computation, -1 if unavailable
+  long long counters[NB_COUNTERS];
+};
+
+// Counters of the solver. An MTPStats is filled by the MTPGraph or
+// MTPTracker it is given to, and nothing is counted when none is
+// given.
+
+class MTPStats {
+  int _shortest_paths_size;
+
+  // Null if the hardware counters are disabled
+  PerfCounters *_perf_counters;
+
+  // The stack of the phases being measured. A phase begun while
+  // another is running is not accounted in the latter.
+  int _nb_running_phases;
+  int _running_phases[NB_PHASES];
+  double _start_times[NB_PHASES], _nested_durations[NB_PHASES];
+  long long _start_counters[NB_PHASES][NB_COUNTERS];
+  long long _nested_counters[NB_PHASES][NB_COUNTERS];
+
+  void read_counters(long long *values);
+  void write_json_counters(ostream *os, long long *counters);
+public:
+  double phase_durations[NB_PHASES];
+  int phase_counts[NB_PHASES];
+
+  // Hardware counters per phase, meaningful only for the available
+  // ones
+  int counters_available[NB_COUNTERS];
+  long long phase_counters[NB_PHASES][NB_COUNTERS];
+
+  // Size of the graph, and fraction of the (t, l) pruned by the
+  // tracker before building it
+  index_t nb_vertices, nb_edges;
+  scalar_t pruning_ratio;
+
+  // Number of times the corridor of the coarse-to-fine tracking was
+  // widened
+  int nb_corridor_widenings;
+
+  // With quantized detection scores, the largest error on a score,
+  // and the resulting bound on the error on the total score of the
+  // trajectories
+  scalar_t quantization_max_error, quantization_score_error;
+
+  // The paths find_best_paths started from, see
+  // MTPGraph::set_initial_paths, the cycles of negative length it
+  // cancelled, and how many of these paths it removed
+  int nb_initial_paths, nb_cancelled_cycles, nb_removed_paths;
+
+  int nb_augmentations;
+  // Of the last find_best_paths
+  int stop_reason;
+
+  // Totals over all the shortest path computations
+  long long heap_pushes, heap_pops, sift_steps;
+  long long relaxations, settled_vertices;
+  scalar_t residual_clamp_total, residual_clamp_max;
+
+  int nb_shortest_paths;
+  ShortestPathStats *shortest_paths;
+
+  MTPStats();
+  ~MTPStats();
+
+  void reset();
+
+  // Enables or disables the hardware counters, and returns how many
+  // of them are available. They measure the thread which calls this
+  // method, and the worker threads it joins later on.
+  int enable_perf_counters(int enabled);
+
+  // Measures a phase. end_phase returns the duration of the phase,
+  // nested ones excluded, and if counters is non-null, stores there
+  // the counter values of the same period.
+  void begin_phase(int phase);
+  double end_phase(int phase, long long *counters);
+
+  // Returns a new record at the end of shortest_paths, initialized
+  // to zero
+  ShortestPathStats *new_shortest_path();
+
+  static const char *phase_name(int phase);
+  static const char *stop_reason_name(int reason);
+
+  void print(ostream *os);
+  void write_json(ostream *os);
+};
+
+#endif
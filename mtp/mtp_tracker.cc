@@ -25,29 +25,66 @@
 #include "mtp_tracker.h"
 
 #include <iostream>
+#include <float.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+#include "storage.h"
 
 using namespace std;
 
 void MTPTracker::free() {
-  delete[] _edge_lengths;
   delete _graph;
-  deallocate_array<scalar_t>(detection_scores);
+  delete[] _motion_first;
+  delete[] _motion_to;
+  delete[] _layer_first_pair;
+  delete[] _layer_first_edge;
+  delete[] _pair_location;
+  delete[] _location_order;
+  if(_detection_scores_borrowed) {
+    delete[] detection_scores;
+  } else {
+    deallocate_array<scalar_t>(detection_scores);
+  }
+  delete[] _int8_scores;
+  delete[] _fp16_scores;
+  delete[] _dequantization;
   deallocate_array<int>(allowed_motions);
   deallocate_array<int>(exits);
   deallocate_array<int>(entrances);
+  delete[] _initial_entrance_times;
+  delete[] _initial_first;
+  delete[] _initial_locations;
 }
 
-void MTPTracker::allocate(int t, int l) {
-  free();
+int MTPTracker::check_memory(size_t bytes, const char *what) {
+  if(memory_budget > 0 && bytes > memory_budget) {
+    cerr << "The " << what << " would take " << bytes
+         << " bytes of memory, more than the budget of " << memory_budget
+         << " bytes, see mtp --plan." << endl;
+    return -1;
+  }
+  return 0;
+}
 
-  nb_locations = l;
-  nb_time_steps = t;
+int MTPTracker::allocate(int t, int l) {
+  if(t < 0 || l < 0) {
+    cerr << "Invalid number of time steps " << t << " or of locations " << l << "." << endl;
+    abort();
+  }
+  // The entrances, exits, scores, and the motion matrix
+  if(check_memory(size_t(t) * size_t(l) * (2 * sizeof(int) + sizeof(scalar_t)) +
+                  size_t(l) * size_t(l) * sizeof(int), "topology") < 0) return -1;
 
-  detection_scores = allocate_array<scalar_t>(nb_time_steps, nb_locations);
-  allowed_motions = allocate_array<int>(nb_locations, nb_locations);
+  allocate_without_motions(t, l);
 
-  entrances = allocate_array<int>(nb_time_steps, nb_locations);
-  exits = allocate_array<int>(nb_time_steps, nb_locations);
+  allowed_motions = allocate_array<int>(nb_locations, nb_locations);
 
   for(int l = 0; l < nb_locations; l++) {
     for(int m = 0; m < nb_locations; m++) {
@@ -55,6 +92,50 @@ void MTPTracker::allocate(int t, int l) {
     }
   }
 
+  return 0;
+}
+
+int MTPTracker::allocate(int t, int l, const int *motion_first, const int *motion_to) {
+  if(t < 0 || l < 0) {
+    cerr << "Invalid number of time steps " << t << " or of locations " << l << "." << endl;
+    abort();
+  }
+  if(check_memory(size_t(t) * size_t(l) * (2 * sizeof(int) + sizeof(scalar_t)) +
+                  size_t(l + 1 + motion_first[l]) * sizeof(int), "topology") < 0) return -1;
+
+  allocate_without_motions(t, l);
+
+  _motion_first = new int[nb_locations + 1];
+  _motion_to = new int[motion_first[nb_locations]];
+
+  for(int l = 0; l <= nb_locations; l++) {
+    _motion_first[l] = motion_first[l];
+  }
+
+  for(int k = 0; k < motion_first[nb_locations]; k++) {
+    _motion_to[k] = motion_to[k];
+  }
+
+  return 0;
+}
+
+void MTPTracker::allocate_without_motions(int t, int l) {
+  free();
+
+  nb_locations = l;
+  nb_time_steps = t;
+
+  detection_scores = allocate_array<scalar_t>(nb_time_steps, nb_locations);
+  _detection_scores_borrowed = 0;
+  _int8_scores = 0;
+  _fp16_scores = 0;
+  _dequantization = 0;
+  _quantization_max_error = 0;
+  allowed_motions = 0;
+
+  entrances = allocate_array<int>(nb_time_steps, nb_locations);
+  exits = allocate_array<int>(nb_time_steps, nb_locations);
+
   for(int t = 0; t < nb_time_steps; t++) {
     for(int l = 0; l < nb_locations; l++) {
       detection_scores[t][l] = 0.0;
@@ -63,8 +144,152 @@ void MTPTracker::allocate(int t, int l) {
     }
   }
 
-  _edge_lengths = 0;
   _graph = 0;
+  _motion_first = 0;
+  _motion_to = 0;
+  _nb_pairs = 0;
+  _nb_entrances = 0;
+  _layer_first_pair = 0;
+  _layer_first_edge = 0;
+  _pair_location = 0;
+  _location_order = 0;
+  _nb_initial_trajectories = 0;
+  _initial_entrance_times = 0;
+  _initial_first = 0;
+  _initial_locations = 0;
+}
+
+void MTPTracker::borrow_detection_scores(scalar_t *scores) {
+  if(_detection_scores_borrowed) {
+    delete[] detection_scores;
+  } else {
+    deallocate_array<scalar_t>(detection_scores);
+  }
+  delete[] _int8_scores;
+  delete[] _fp16_scores;
+  delete[] _dequantization;
+  _int8_scores = 0;
+  _fp16_scores = 0;
+  _dequantization = 0;
+  _quantization_max_error = 0;
+
+  detection_scores = new scalar_t *[nb_time_steps];
+  for(int t = 0; t < nb_time_steps; t++) {
+    detection_scores[t] = scores + size_t(t) * size_t(nb_locations);
+  }
+  _detection_scores_borrowed = 1;
+}
+
+// Conversions between float and IEEE half-precision, rounding to the
+// nearest
+
+static unsigned short float_to_half(float f) {
+  unsigned int x, half, rest, halfway;
+  memcpy(&x, &f, sizeof(x));
+  unsigned int sign = (x >> 16) & 0x8000;
+  int exponent = int((x >> 23) & 0xff) - 127 + 15;
+  unsigned int mantissa = x & 0x7fffff;
+
+  if(exponent >= 31) return (unsigned short) (sign | 0x7c00);
+
+  if(exponent <= 0) {
+    // Subnormal
+    if(exponent < -10) return (unsigned short) sign;
+    mantissa |= 0x800000;
+    int shift = 14 - exponent;
+    half = mantissa >> shift;
+    rest = mantissa & ((1u << shift) - 1);
+    halfway = 1u << (shift - 1);
+  } else {
+    half = (unsigned int) (exponent << 10) | (mantissa >> 13);
+    rest = mantissa & 0x1fff;
+    halfway = 0x1000;
+  }
+
+  // A carry into the exponent is the proper rounding
+  if(rest > halfway || (rest == halfway && (half & 1))) half++;
+  return (unsigned short) (sign | half);
+}
+
+static float half_to_float(unsigned short h) {
+  unsigned int exponent = (h >> 10) & 0x1f, mantissa = h & 0x3ff;
+  float f;
+  if(exponent == 0) {
+    f = ldexpf(float(mantissa), -24);
+  } else if(exponent == 31) {
+    f = mantissa ? NAN : INFINITY;
+  } else {
+    unsigned int x = ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    memcpy(&f, &x, sizeof(f));
+  }
+  return (h & 0x8000) ? -f : f;
+}
+
+void MTPTracker::quantize_detection_scores(int quantization) {
+  if(quantization == QUANTIZATION_NONE || !detection_scores) return;
+
+  scalar_t min_score = FLT_MAX, max_score = - FLT_MAX;
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int l = 0; l < nb_locations; l++) {
+      if(detection_scores[t][l] < min_score) min_score = detection_scores[t][l];
+      if(detection_scores[t][l] > max_score) max_score = detection_scores[t][l];
+    }
+  }
+
+  // The codes stand for values between -1 and 1 times the scale,
+  // around the offset
+  scalar_t offset = (max_score + min_score) / 2;
+  scalar_t scale = (max_score - min_score) / 2;
+  if(scale <= 0) scale = 1;
+
+  size_t nb_scores = size_t(nb_time_steps) * size_t(nb_locations);
+
+  if(quantization == QUANTIZATION_INT8) {
+    _int8_scores = new unsigned char[nb_scores];
+    _dequantization = new scalar_t[256];
+    for(int c = 0; c < 256; c++) {
+      _dequantization[c] = offset + scale * scalar_t((signed char) c) / 127;
+    }
+  } else {
+    _fp16_scores = new unsigned short[nb_scores];
+    _dequantization = new scalar_t[65536];
+    for(int c = 0; c < 65536; c++) {
+      _dequantization[c] = offset + scale * half_to_float((unsigned short) c);
+    }
+  }
+
+  _quantization_max_error = 0;
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int l = 0; l < nb_locations; l++) {
+      size_t k = size_t(t) * size_t(nb_locations) + size_t(l);
+      scalar_t x = (detection_scores[t][l] - offset) / scale;
+      if(x < -1) x = -1;
+      if(x > 1) x = 1;
+      scalar_t decoded;
+      if(_int8_scores) {
+        _int8_scores[k] = (unsigned char) (signed char) floor(x * 127 + 0.5f);
+        decoded = _dequantization[_int8_scores[k]];
+      } else {
+        _fp16_scores[k] = float_to_half(x);
+        decoded = _dequantization[_fp16_scores[k]];
+      }
+      scalar_t error = fabs(decoded - detection_scores[t][l]);
+      if(error > _quantization_max_error) _quantization_max_error = error;
+    }
+  }
+
+  // From now on, detection_score reads the codes
+  if(_detection_scores_borrowed) {
+    delete[] detection_scores;
+  } else {
+    deallocate_array<scalar_t>(detection_scores);
+  }
+  detection_scores = 0;
+  _detection_scores_borrowed = 0;
+}
+
+scalar_t MTPTracker::quantization_max_error() {
+  return _quantization_max_error;
 }
 
 void MTPTracker::write(ostream *os) {
@@ -72,11 +297,26 @@ void MTPTracker::write(ostream *os) {
 
   (*os) << endl;
 
-  for(int l = 0; l < nb_locations; l++) {
-    for(int m = 0; m < nb_locations; m++) {
-      (*os) << allowed_motions[l][m];
-      if(m < nb_locations - 1) (*os) << " "; else (*os) << endl;
+  if(allowed_motions) {
+    for(int l = 0; l < nb_locations; l++) {
+      for(int m = 0; m < nb_locations; m++) {
+        (*os) << allowed_motions[l][m];
+        if(m < nb_locations - 1) (*os) << " "; else (*os) << endl;
+      }
     }
+  } else {
+    // The motions were given as lists
+    int *row = new int[nb_locations];
+    for(int m = 0; m < nb_locations; m++) row[m] = 0;
+    for(int l = 0; l < nb_locations; l++) {
+      for(int k = _motion_first[l]; k < _motion_first[l + 1]; k++) row[_motion_to[k]] = 1;
+      for(int m = 0; m < nb_locations; m++) {
+        (*os) << row[m];
+        if(m < nb_locations - 1) (*os) << " "; else (*os) << endl;
+      }
+      for(int k = _motion_first[l]; k < _motion_first[l + 1]; k++) row[_motion_to[k]] = 0;
+    }
+    delete[] row;
   }
 
   (*os) << endl;
@@ -101,7 +341,7 @@ void MTPTracker::write(ostream *os) {
 
   for(int t = 0; t < nb_time_steps; t++) {
     for(int l = 0; l < nb_locations; l++) {
-      (*os) << detection_scores[t][l];
+      (*os) << detection_score(t, l);
       if(l < nb_locations - 1) (*os) << " "; else (*os) << endl;
     }
   }
@@ -110,9 +350,11 @@ void MTPTracker::write(ostream *os) {
 void MTPTracker::read(istream *is) {
   int l = 0, t = 0;
 
+  if(_stats) _stats->begin_phase(PHASE_READ);
+
   (*is) >> l >> t;
 
-  allocate(t, l);
+  if(allocate(t, l) < 0) abort();
 
   for(int l = 0; l < nb_locations; l++) {
     for(int m = 0; m < nb_locations; m++) {
@@ -137,6 +379,8 @@ void MTPTracker::read(istream *is) {
       (*is) >> detection_scores[t][l];
     }
   }
+
+  if(_stats) _stats->end_phase(PHASE_READ, 0);
 }
 
 void MTPTracker::write_trajectories(ostream *os) {
@@ -153,162 +397,1831 @@ void MTPTracker::write_trajectories(ostream *os) {
   }
 }
 
+int MTPTracker::motion_allowed(int l, int m) {
+  if(allowed_motions) return allowed_motions[l][m];
+  for(int k = _motion_first[l]; k < _motion_first[l + 1]; k++) {
+    if(_motion_to[k] == m) return 1;
+  }
+  return 0;
+}
+
+int MTPTracker::set_initial_trajectories(int nb, const int *entrance_times, const int *durations,
+                                         const int *locations) {
+  delete[] _initial_entrance_times;
+  delete[] _initial_first;
+  delete[] _initial_locations;
+  _nb_initial_trajectories = 0;
+  _initial_entrance_times = 0;
+  _initial_first = 0;
+  _initial_locations = 0;
+
+  if(nb <= 0) return 0;
+
+  int error = 0, n = 0;
+  int **used = allocate_array<int>(nb_time_steps, nb_locations);
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int l = 0; l < nb_locations; l++) {
+      used[t][l] = 0;
+    }
+  }
+
+  for(int k = 0; k < nb && !error; k++) {
+    int t0 = entrance_times[k], d = durations[k];
+    if(d < 1 || t0 < 0 || t0 + d > nb_time_steps) {
+      error = 1;
+    } else {
+      for(int u = 0; u < d && !error; u++) {
+        int l = locations[n + u];
+        if(l < 0 || l >= nb_locations || used[t0 + u][l] ||
+           (u > 0 && !motion_allowed(locations[n + u - 1], l))) {
+          error = 1;
+        } else {
+          used[t0 + u][l] = 1;
+        }
+      }
+      if(!error && (!entrances[t0][locations[n]] || !exits[t0 + d - 1][locations[n + d - 1]])) {
+        error = 1;
+      }
+      n += d;
+    }
+  }
+
+  deallocate_array<int>(used);
+
+  if(error) return -1;
+
+  _nb_initial_trajectories = nb;
+  _initial_entrance_times = new int[nb];
+  _initial_first = new int[nb + 1];
+  _initial_locations = new int[n];
+  _initial_first[0] = 0;
+  for(int k = 0; k < nb; k++) {
+    _initial_entrance_times[k] = entrance_times[k];
+    _initial_first[k + 1] = _initial_first[k] + durations[k];
+  }
+  for(int i = 0; i < n; i++) _initial_locations[i] = locations[i];
+
+  return 0;
+}
+
+int MTPTracker::read_initial_trajectories(istream *is) {
+  int nb = 0, index, total = 0;
+  scalar_t score;
+
+  (*is) >> nb;
+  if(nb < 0 || is->fail()) return -1;
+
+  int *entrance_times = new int[nb];
+  int *durations = new int[nb];
+  int *locations = new int[nb * nb_time_steps + 1];
+
+  for(int k = 0; k < nb && !is->fail(); k++) {
+    (*is) >> index >> entrance_times[k] >> durations[k] >> score;
+    if(durations[k] < 0 || durations[k] > nb_time_steps) {
+      is->setstate(ios::failbit);
+    } else {
+      for(int u = 0; u < durations[k]; u++) (*is) >> locations[total++];
+    }
+  }
+
+  int result = -1;
+  if(!is->fail()) result = set_initial_trajectories(nb, entrance_times, durations, locations);
+
+  delete[] entrance_times;
+  delete[] durations;
+  delete[] locations;
+
+  return result;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+// A replay record is the magic, its size as a 64 bits integer, and
+// its content. The integers are LEB128 varints, zigzag-encoded if
+// they can be negative, and the sets of (t, l) are stored sorted, as
+// the differences between consecutive t * nb_locations + l.
+
+static const char REPLAY_MAGIC[8] = { 'M', 'T', 'P', 'R', 'P', 'L', 'Y', '1' };
+
+static void write_varint(ostream *os, unsigned long long x) {
+  while(x >= 0x80) {
+    os->put(char((x & 0x7f) | 0x80));
+    x >>= 7;
+  }
+  os->put(char(x));
+}
+
+static unsigned long long read_varint(istream *is) {
+  unsigned long long x = 0;
+  int shift = 0, c;
+  do {
+    c = is->get();
+    if(c == EOF || shift > 63) {
+      is->setstate(ios::failbit);
+      return 0;
+    }
+    x |= (unsigned long long) (c & 0x7f) << shift;
+    shift += 7;
+  } while(c & 0x80);
+  return x;
+}
+
+static void write_int(ostream *os, int x) {
+  write_varint(os, x < 0 ? 2 * (unsigned long long) (- (long long) x) - 1 : 2 * (unsigned long long) x);
+}
+
+static int read_int(istream *is) {
+  unsigned long long x = read_varint(is);
+  return x & 1 ? int(- (long long) ((x + 1) / 2)) : int(x / 2);
+}
+
+template<class T>
+static void write_raw(ostream *os, T x) {
+  os->write((const char *) &x, sizeof(x));
+}
+
+template<class T>
+static T read_raw(istream *is) {
+  T x = 0;
+  is->read((char *) &x, sizeof(x));
+  return x;
+}
+
+static void write_flags(ostream *os, int **flags, int nb_time_steps, int nb_locations) {
+  unsigned long long nb = 0, previous = 0, i;
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int l = 0; l < nb_locations; l++) {
+      if(flags[t][l]) nb++;
+    }
+  }
+  write_varint(os, nb);
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int l = 0; l < nb_locations; l++) {
+      if(flags[t][l]) {
+        i = (unsigned long long) t * nb_locations + l;
+        write_varint(os, i - previous);
+        previous = i;
+      }
+    }
+  }
+}
+
+static int read_flags(istream *is, int **flags, int nb_time_steps, int nb_locations) {
+  unsigned long long nb = read_varint(is), i = 0;
+  unsigned long long size = (unsigned long long) nb_time_steps * nb_locations;
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int l = 0; l < nb_locations; l++) {
+      flags[t][l] = 0;
+    }
+  }
+  for(unsigned long long k = 0; k < nb && !is->fail(); k++) {
+    i += read_varint(is);
+    if(i >= size) return -1;
+    flags[i / nb_locations][i % nb_locations] = 1;
+  }
+  return is->fail() ? -1 : 0;
+}
+
+void MTPTracker::write_replay(ostream *os, double duration) {
+  stringstream record;
+  unsigned long long nb = 0, previous = 0, i;
+
+  write_varint(&record, nb_time_steps);
+  write_varint(&record, nb_locations);
+
+  if(!_motion_first) compute_motion_lists();
+  write_varint(&record, _motion_first[nb_locations]);
+  for(int l = 0; l < nb_locations; l++) {
+    write_varint(&record, _motion_first[l + 1] - _motion_first[l]);
+    for(int k = _motion_first[l]; k < _motion_first[l + 1]; k++) {
+      write_varint(&record, _motion_to[k]);
+    }
+  }
+
+  write_flags(&record, entrances, nb_time_steps, nb_locations);
+  write_flags(&record, exits, nb_time_steps, nb_locations);
+
+  // Most locations are far from any detection and have the same
+  // score, which we look for among the first distinct values
+  unordered_map<scalar_t, size_t> counts;
+  scalar_t background = 0;
+  size_t background_count = 0;
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int l = 0; l < nb_locations; l++) {
+      scalar_t s = detection_score(t, l);
+      if(counts.size() < 1024 || counts.count(s)) {
+        size_t c = ++counts[s];
+        if(c > background_count) { background = s; background_count = c; }
+      }
+    }
+  }
+
+  write_raw<scalar_t>(&record, background);
+  write_varint(&record, (unsigned long long) nb_time_steps * nb_locations - background_count);
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int l = 0; l < nb_locations; l++) {
+      scalar_t s = detection_score(t, l);
+      if(s != background) {
+        i = (unsigned long long) t * nb_locations + l;
+        write_varint(&record, i - previous);
+        write_raw<scalar_t>(&record, s);
+        previous = i;
+        nb++;
+      }
+    }
+  }
+  ASSERT(nb == (unsigned long long) nb_time_steps * nb_locations - background_count);
+
+  write_int(&record, _int8_scores ? QUANTIZATION_INT8 :
+            _fp16_scores ? QUANTIZATION_FP16 : QUANTIZATION_NONE);
+  write_int(&record, prune_unreachable_vertices);
+  write_int(&record, gating);
+  write_raw<scalar_t>(&record, gating_threshold);
+  write_int(&record, gating_radius);
+  write_int(&record, grid_width);
+  write_int(&record, coarse_cell_size);
+  write_int(&record, coarse_pooling);
+  write_int(&record, corridor_radius);
+  write_int(&record, max_corridor_widenings);
+  write_int(&record, temporal_factor);
+  write_int(&record, max_nb_trajectories);
+  write_raw<scalar_t>(&record, min_trajectory_gain);
+  write_int(&record, exact_nb_trajectories);
+  write_int(&record, incremental_shortest_paths);
+  write_int(&record, bidirectional_shortest_paths);
+  write_int(&record, vertex_order);
+
+  write_raw<scalar_t>(&record, total_score());
+  write_varint(&record, nb_trajectories());
+  write_raw<double>(&record, duration);
+  // By name, so that records stay readable if phases are added
+  write_varint(&record, NB_PHASES);
+  for(int p = 0; p < NB_PHASES; p++) {
+    const char *name = MTPStats::phase_name(p);
+    write_varint(&record, strlen(name));
+    record.write(name, strlen(name));
+    write_raw<double>(&record, _stats ? _stats->phase_durations[p] : 0.0);
+  }
+
+  string content = record.str();
+  os->write(REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+  write_raw<unsigned long long>(os, content.size());
+  os->write(content.data(), content.size());
+}
+
+static void invalid_replay() {
+  cerr << "Invalid replay record." << endl;
+  abort();
+}
+
+int MTPTracker::read_replay(istream *is, ReplayRecord *record) {
+  char magic[sizeof(REPLAY_MAGIC)];
+
+  is->read(magic, sizeof(magic));
+  if(is->gcount() == 0 && is->eof()) return -1;
+  if(!(*is) || memcmp(magic, REPLAY_MAGIC, sizeof(magic)) != 0) invalid_replay();
+
+  unsigned long long size = read_raw<unsigned long long>(is);
+  if(!(*is) || size > (1ULL << 40)) invalid_replay();
+  string content(size, '\0');
+  is->read(&content[0], size);
+  if(!(*is)) invalid_replay();
+  stringstream in(content);
+
+  int t = int(read_varint(&in)), l = int(read_varint(&in));
+  unsigned long long nb_motions = read_varint(&in), i = 0;
+  if(in.fail() || t <= 0 || l <= 0 ||
+     nb_motions > (unsigned long long) l * l) invalid_replay();
+
+  int *motion_first = new int[l + 1];
+  int *motion_to = new int[nb_motions];
+  motion_first[0] = 0;
+  for(int m = 0; m < l; m++) {
+    unsigned long long n = read_varint(&in);
+    if(n > nb_motions - motion_first[m]) invalid_replay();
+    motion_first[m + 1] = motion_first[m] + int(n);
+    for(int k = motion_first[m]; k < motion_first[m + 1]; k++) {
+      motion_to[k] = int(read_varint(&in));
+      if(motion_to[k] >= l) invalid_replay();
+    }
+  }
+  if(in.fail() || (unsigned long long) motion_first[l] != nb_motions) invalid_replay();
+
+  if(allocate(t, l, motion_first, motion_to) < 0) abort();
+  delete[] motion_first;
+  delete[] motion_to;
+
+  if(read_flags(&in, entrances, nb_time_steps, nb_locations) < 0 ||
+     read_flags(&in, exits, nb_time_steps, nb_locations) < 0) invalid_replay();
+
+  scalar_t background = read_raw<scalar_t>(&in);
+  for(int u = 0; u < nb_time_steps; u++) {
+    for(int m = 0; m < nb_locations; m++) {
+      detection_scores[u][m] = background;
+    }
+  }
+  unsigned long long nb = read_varint(&in);
+  for(unsigned long long k = 0; k < nb && !in.fail(); k++) {
+    i += read_varint(&in);
+    if(i >= (unsigned long long) nb_time_steps * nb_locations) invalid_replay();
+    detection_scores[i / nb_locations][i % nb_locations] = read_raw<scalar_t>(&in);
+  }
+
+  int quantization = read_int(&in);
+  prune_unreachable_vertices = read_int(&in);
+  gating = read_int(&in);
+  gating_threshold = read_raw<scalar_t>(&in);
+  gating_radius = read_int(&in);
+  grid_width = read_int(&in);
+  coarse_cell_size = read_int(&in);
+  coarse_pooling = read_int(&in);
+  corridor_radius = read_int(&in);
+  max_corridor_widenings = read_int(&in);
+  temporal_factor = read_int(&in);
+  max_nb_trajectories = read_int(&in);
+  min_trajectory_gain = read_raw<scalar_t>(&in);
+  exact_nb_trajectories = read_int(&in);
+  incremental_shortest_paths = read_int(&in);
+  bidirectional_shortest_paths = read_int(&in);
+  vertex_order = read_int(&in);
+
+  record->total_score = read_raw<scalar_t>(&in);
+  record->nb_trajectories = int(read_varint(&in));
+  record->duration = read_raw<double>(&in);
+  // The phases this build does not know are ignored, and the ones
+  // the record does not have are left at zero
+  int nb_phases = int(read_varint(&in));
+  for(int p = 0; p < NB_PHASES; p++) record->phase_durations[p] = 0;
+  for(int q = 0; q < nb_phases && !in.fail(); q++) {
+    unsigned long long length = read_varint(&in);
+    if(length > 64) invalid_replay();
+    string name(length, '\0');
+    in.read(&name[0], length);
+    double d = read_raw<double>(&in);
+    for(int p = 0; p < NB_PHASES; p++) {
+      if(name == MTPStats::phase_name(p)) record->phase_durations[p] = d;
+    }
+  }
+
+  if(in.fail()) invalid_replay();
+
+  quantize_detection_scores(quantization);
+
+  return 0;
+}
+
 MTPTracker::MTPTracker() {
   nb_locations = 0;
   nb_time_steps = 0;
 
   detection_scores = 0;
+  _detection_scores_borrowed = 0;
+  _int8_scores = 0;
+  _fp16_scores = 0;
+  _dequantization = 0;
+  _quantization_max_error = 0;
   allowed_motions = 0;
 
   entrances = 0;
   exits = 0;
 
-  _edge_lengths = 0;
   _graph = 0;
+  _stats = 0;
+  _deadline = 0;
+  _cancel = 0;
+
+  _motion_first = 0;
+  _motion_to = 0;
+  _nb_pairs = 0;
+  _nb_entrances = 0;
+  _layer_first_pair = 0;
+  _layer_first_edge = 0;
+  _pair_location = 0;
+  _location_order = 0;
+  _nb_initial_trajectories = 0;
+  _initial_entrance_times = 0;
+  _initial_first = 0;
+  _initial_locations = 0;
+
+  prune_unreachable_vertices = 0;
+  gating = 0;
+  gating_threshold = 0;
+  gating_radius = 2;
+
+  grid_width = 0;
+  coarse_cell_size = 0;
+  coarse_pooling = POOLING_MAX;
+  corridor_radius = 0;
+  max_corridor_widenings = 4;
+  temporal_factor = 0;
+
+  max_nb_trajectories = 0;
+  min_trajectory_gain = 0;
+  exact_nb_trajectories = 0;
+  incremental_shortest_paths = 0;
+  bidirectional_shortest_paths = 0;
+  vertex_order = ORDER_LOCATION;
+  nb_build_threads = 0;
+  memory_budget = storage_physical_memory();
+  storage_directory = 0;
+  storage_pages = STORAGE_PAGES_DEFAULT;
+  storage_numa_node = -1;
+  checkpoint_file = 0;
+  checkpoint_period = 0;
+  checkpoint_request = 0;
+  resume_file = 0;
+  replay_file = 0;
+  _coarse_width = 0;
+  _coarse_height = 0;
+}
+
+void MTPTracker::copy_options(MTPTracker *tracker) {
+  prune_unreachable_vertices = tracker->prune_unreachable_vertices;
+  gating = tracker->gating;
+  gating_threshold = tracker->gating_threshold;
+  gating_radius = tracker->gating_radius;
+
+  grid_width = tracker->grid_width;
+  coarse_cell_size = tracker->coarse_cell_size;
+  coarse_pooling = tracker->coarse_pooling;
+  corridor_radius = tracker->corridor_radius;
+  max_corridor_widenings = tracker->max_corridor_widenings;
+  temporal_factor = tracker->temporal_factor;
+
+  max_nb_trajectories = tracker->max_nb_trajectories;
+  min_trajectory_gain = tracker->min_trajectory_gain;
+  exact_nb_trajectories = tracker->exact_nb_trajectories;
+  incremental_shortest_paths = tracker->incremental_shortest_paths;
+  bidirectional_shortest_paths = tracker->bidirectional_shortest_paths;
+
+  vertex_order = tracker->vertex_order;
+  nb_build_threads = tracker->nb_build_threads;
+  memory_budget = tracker->memory_budget;
+  storage_directory = tracker->storage_directory;
+  storage_pages = tracker->storage_pages;
+  storage_numa_node = tracker->storage_numa_node;
+  replay_file = tracker->replay_file;
 }
 
 MTPTracker::~MTPTracker() {
   free();
+  delete _stats;
 }
 
-int MTPTracker::early_pair_node(int t, int l) {
-  return 1 + (2 * t + 0) * nb_locations + l;
+index_t MTPTracker::early_pair_node(int t, index_t p) {
+  return 1 + _layer_first_pair[t] + p;
 }
 
-int MTPTracker::late_pair_node(int t, int l) {
-  return 1 + (2 * t + 1) * nb_locations + l;
+index_t MTPTracker::late_pair_node(int t, index_t p) {
+  return 1 + _layer_first_pair[t + 1] + p;
 }
 
-void MTPTracker::build_graph() {
-  // Delete the existing graph if there was one
-  delete[] _edge_lengths;
-  delete _graph;
+int MTPTracker::node_time(index_t n) {
+  // The nodes of time t are 1 + 2 * _layer_first_pair[t] to 2 *
+  // _layer_first_pair[t+1], we look for t by bisection
+  int a = 0, b = nb_time_steps;
+  while(b > a + 1) {
+    int c = (a + b) / 2;
+    if(1 + 2 * _layer_first_pair[c] <= n) a = c; else b = c;
+  }
+  return a;
+}
+
+int MTPTracker::node_location(index_t n) {
+  int t = node_time(n);
+  index_t i = n - 1 - 2 * _layer_first_pair[t];
+  index_t layer_size = _layer_first_pair[t + 1] - _layer_first_pair[t];
+  if(i >= layer_size) i -= layer_size;
+  return _pair_location[_layer_first_pair[t] + i];
+}
+
+void MTPTracker::compute_motion_lists() {
+  // The lists were set directly
+  if(!allowed_motions) return;
 
-  int nb_motions = 0, nb_exits = 0, nb_entrances = 0;
+  delete[] _motion_first;
+  delete[] _motion_to;
 
+  int nb_motions = 0;
   for(int l = 0; l < nb_locations; l++) {
-    for(int t = 0; t < nb_time_steps; t++) {
-      if(exits[t][l]) nb_exits++;
-      if(entrances[t][l]) nb_entrances++;
-    }
     for(int m = 0; m < nb_locations; m++) {
       if(allowed_motions[l][m]) nb_motions++;
     }
   }
 
-  int nb_vertices = 2 + 2 * nb_time_steps * nb_locations;
+  _motion_first = new int[nb_locations + 1];
+  _motion_to = new int[nb_motions];
 
-  int nb_edges =
-    // The edges from the source to the entrances and from the exits
-    // to the sink
-    nb_exits + nb_entrances +
-    // The edges for the motions, between every successive frames
-    (nb_time_steps - 1) * nb_motions +
-    // The edges inside the duplicated nodes
-    nb_locations * nb_time_steps;
-
-  int *node_from = new int[nb_edges];
-  int *node_to = new int[nb_edges];
+  int k = 0;
+  for(int l = 0; l < nb_locations; l++) {
+    _motion_first[l] = k;
+    for(int m = 0; m < nb_locations; m++) {
+      if(allowed_motions[l][m]) _motion_to[k++] = m;
+    }
+  }
+  _motion_first[nb_locations] = k;
+}
 
-  int source = 0, sink = nb_vertices - 1;
-  int e = 0;
+void MTPTracker::gate(int **kept) {
+  ASSERT(gating_radius >= 0);
 
-  _edge_lengths = new scalar_t[nb_edges];
+  int **near = allocate_array<int>(nb_time_steps, nb_locations);
+  int *distance = new int[nb_locations];
+  int *queue = new int[nb_locations];
 
-  // We put the in-node edges first, since these are the ones whose
-  // lengths we will have to change before tracking, according to the
-  // detection scores
+  // Spatial dilation: for every time step, a breadth-first search from
+  // the locations above the threshold, up to gating_radius motions
 
   for(int t = 0; t < nb_time_steps; t++) {
+    int head = 0, tail = 0;
     for(int l = 0; l < nb_locations; l++) {
-      node_from[e] = early_pair_node(t, l);
-      node_to[e] = late_pair_node(t, l);
-      e++;
+      if(detection_score(t, l) > gating_threshold) {
+        distance[l] = 0;
+        queue[tail++] = l;
+      } else {
+        distance[l] = -1;
+      }
     }
-  }
 
-  // The edges between frames, corresponding to allowed motions
-
-  for(int t = 0; t < nb_time_steps - 1; t++) {
-    for(int l = 0; l < nb_locations; l++) {
-      for(int k = 0; k < nb_locations; k++) {
-        if(allowed_motions[l][k]) {
-          node_from[e] = late_pair_node(t, l);
-          node_to[e] = early_pair_node(t+1, k);
-          _edge_lengths[e] = 0.0;
-          e++;
+    while(head < tail) {
+      int l = queue[head++];
+      if(distance[l] < gating_radius) {
+        for(int k = _motion_first[l]; k < _motion_first[l + 1]; k++) {
+          int m = _motion_to[k];
+          if(distance[m] < 0) {
+            distance[m] = distance[l] + 1;
+            queue[tail++] = m;
+          }
         }
       }
     }
-  }
-
-  // The edges from the source to the entrances, and from the exits to
-  // the sink
 
-  for(int t = 0; t < nb_time_steps; t++) {
     for(int l = 0; l < nb_locations; l++) {
-      if(entrances[t][l]) {
-        node_from[e] = source;
-        node_to[e] = early_pair_node(t, l);
-        _edge_lengths[e] = 0.0;
-        e++;
-      }
-      if(exits[t][l]) {
-        node_from[e] = late_pair_node(t, l);
-        node_to[e] = sink;
-        _edge_lengths[e] = 0.0;
-        e++;
-      }
+      near[t][l] = distance[l] >= 0;
     }
   }
 
-  // We are done, build the graph
+  // Temporal dilation: count the near ones in a sliding window of
+  // gating_radius time steps on each side
 
-  _graph = new MTPGraph(nb_vertices, nb_edges,
-                        node_from, node_to,
-                        source, sink);
+  for(int l = 0; l < nb_locations; l++) {
+    int nb_near = 0;
+    for(int t = 0; t < gating_radius && t < nb_time_steps; t++) {
+      nb_near += near[t][l];
+    }
+    for(int t = 0; t < nb_time_steps; t++) {
+      if(t + gating_radius < nb_time_steps) nb_near += near[t + gating_radius][l];
+      if(t - gating_radius - 1 >= 0) nb_near -= near[t - gating_radius - 1][l];
+      if(nb_near == 0) kept[t][l] = 0;
+    }
+  }
 
-  delete[] node_from;
-  delete[] node_to;
+  delete[] queue;
+  delete[] distance;
+  deallocate_array<int>(near);
 }
 
-void MTPTracker::print_graph_dot(ostream *os) {
-  int e = 0;
+void MTPTracker::prune_unreachable(int **kept) {
+  int **reachable = allocate_array<int>(nb_time_steps, nb_locations);
+
+  // Forward, the (t, l) reachable from an entrance
+
   for(int t = 0; t < nb_time_steps; t++) {
     for(int l = 0; l < nb_locations; l++) {
-      _edge_lengths[e++] = - detection_scores[t][l];
+      reachable[t][l] = kept[t][l] && entrances[t][l];
+    }
+    if(t > 0) {
+      for(int l = 0; l < nb_locations; l++) {
+        if(reachable[t - 1][l]) {
+          for(int k = _motion_first[l]; k < _motion_first[l + 1]; k++) {
+            int m = _motion_to[k];
+            if(kept[t][m]) reachable[t][m] = 1;
+          }
+        }
+      }
     }
   }
-  _graph->print_dot(os);
-}
 
-void MTPTracker::track() {
-  ASSERT(_graph);
+  // Backward, keep the reachable ones from which an exit is
+  // reachable
 
-  int e = 0;
-  for(int t = 0; t < nb_time_steps; t++) {
+  for(int t = nb_time_steps - 1; t >= 0; t--) {
     for(int l = 0; l < nb_locations; l++) {
-      _edge_lengths[e++] = - detection_scores[t][l];
+      if(reachable[t][l] && !exits[t][l]) {
+        int reaches_exit = 0;
+        if(t < nb_time_steps - 1) {
+          for(int k = _motion_first[l]; !reaches_exit && k < _motion_first[l + 1]; k++) {
+            reaches_exit = kept[t + 1][_motion_to[k]];
+          }
+        }
+        if(!reaches_exit) kept[t][l] = 0;
+      } else if(!reachable[t][l]) {
+        kept[t][l] = 0;
+      }
     }
   }
 
-  _graph->find_best_paths(_edge_lengths);
-  _graph->retrieve_disjoint_paths();
+  deallocate_array<int>(reachable);
+}
 
-#ifdef VERBOSE
-  for(int p = 0; p < _graph->nb_paths; p++) {
-    Path *path = _graph->paths[p];
-    cout << "PATH " << p << " [length " << path->nb_nodes << "] " << path->nodes[0];
+// The index of (x, y) along the Hilbert curve covering a n x n
+// square, n being a power of two
+
+static unsigned long long hilbert_index(unsigned int n, unsigned int x, unsigned int y) {
+  unsigned long long d = 0;
+  for(unsigned int s = n / 2; s > 0; s /= 2) {
+    unsigned int rx = (x & s) > 0, ry = (y & s) > 0;
+    d += (unsigned long long) s * s * ((3 * rx) ^ ry);
+    // Rotate the quadrant so that the curve in it starts and ends
+    // where the one of the whole square does
+    if(ry == 0) {
+      if(rx == 1) {
+        x = s - 1 - (x & (s - 1));
+        y = s - 1 - (y & (s - 1));
+      }
+      swap(x, y);
+    }
+    x &= s - 1;
+    y &= s - 1;
+  }
+  return d;
+}
+
+// The index of (x, y) along the Z-order curve, interleaving their
+// bits
+
+static unsigned long long morton_index(unsigned int x, unsigned int y) {
+  unsigned long long d = 0;
+  for(int b = 0; b < 32; b++) {
+    d |= (unsigned long long) ((x >> b) & 1) << (2 * b);
+    d |= (unsigned long long) ((y >> b) & 1) << (2 * b + 1);
+  }
+  return d;
+}
+
+void MTPTracker::compute_location_order() {
+  delete[] _location_order;
+  _location_order = 0;
+
+  if(vertex_order == ORDER_LOCATION) return;
+
+  if(grid_width <= 0 || nb_locations % grid_width != 0) {
+    cerr << "The number of locations " << nb_locations
+         << " is not a multiple of the grid width " << grid_width << "." << endl;
+    abort();
+  }
+
+  int grid_height = nb_locations / grid_width;
+  unsigned int n = 1;
+  while(n < (unsigned int) grid_width || n < (unsigned int) grid_height) n *= 2;
+
+  // The index along the curve in the high bits, the location in the
+  // low ones, so that sorting the keys sorts the locations
+  unsigned long long *keys = new unsigned long long[nb_locations];
+  for(int l = 0; l < nb_locations; l++) {
+    unsigned int x = (unsigned int) (l % grid_width), y = (unsigned int) (l / grid_width);
+    unsigned long long d;
+    if(vertex_order == ORDER_HILBERT) d = hilbert_index(n, x, y);
+    else d = morton_index(x, y);
+    keys[l] = (d << 32) | (unsigned long long) l;
+  }
+  sort(keys, keys + nb_locations);
+
+  _location_order = new int[nb_locations];
+  for(int k = 0; k < nb_locations; k++) {
+    _location_order[k] = int(keys[k] & 0xffffffffULL);
+  }
+
+  delete[] keys;
+}
+
+void MTPTracker::set_layer_edges(int first_t, int nb_t,
+                                 index_t *layer_first_entrance,
+                                 index_t *entrance_edges, index_t *entrance_nodes) {
+  // pair_index[t % 2][l] is the pair of (t, l), or -1 if it was pruned
+  index_t **pair_index = allocate_array<index_t>(2, nb_locations);
+  index_t sink = 1 + 2 * _nb_pairs;
+
+  // The edges of time t are first the ones inside the node pairs,
+  // whose lengths we will have to change before tracking according to
+  // the detection scores, then the ones of the motions to t+1, and
+  // finally the ones from the source to the entrances and from the
+  // exits to the sink. Since all the edges from the source leave the
+  // same vertex, we leave them to build_masked_graph.
+
+  for(int t = first_t; t < first_t + nb_t; t++) {
+    index_t e = _layer_first_edge[t];
+    index_t n = layer_first_entrance[t];
+
+    for(index_t p = _layer_first_pair[t]; p < _layer_first_pair[t + 1]; p++) {
+      _graph->set_edge(e++, early_pair_node(t, p), late_pair_node(t, p));
+    }
+
+    if(t < nb_time_steps - 1) {
+      for(int l = 0; l < nb_locations; l++) {
+        pair_index[t % 2][l] = -1;
+        pair_index[(t + 1) % 2][l] = -1;
+      }
+      for(index_t p = _layer_first_pair[t]; p < _layer_first_pair[t + 2]; p++) {
+        pair_index[p < _layer_first_pair[t + 1] ? t % 2 : (t + 1) % 2][_pair_location[p]] = p;
+      }
+      for(index_t p = _layer_first_pair[t]; p < _layer_first_pair[t + 1]; p++) {
+        int l = _pair_location[p];
+        for(int k = _motion_first[l]; k < _motion_first[l + 1]; k++) {
+          index_t q = pair_index[(t + 1) % 2][_motion_to[k]];
+          if(q >= 0) _graph->set_edge(e++, late_pair_node(t, p), early_pair_node(t + 1, q));
+        }
+      }
+    }
+
+    for(index_t p = _layer_first_pair[t]; p < _layer_first_pair[t + 1]; p++) {
+      int l = _pair_location[p];
+      if(entrances[t][l]) {
+        entrance_edges[n] = e++;
+        entrance_nodes[n++] = early_pair_node(t, p);
+      }
+      if(exits[t][l]) _graph->set_edge(e++, late_pair_node(t, p), sink);
+    }
+
+    ASSERT(e == _layer_first_edge[t + 1]);
+  }
+
+  deallocate_array<index_t>(pair_index);
+}
+
+int MTPTracker::build_masked_graph(int **kept) {
+  delete[] _layer_first_pair;
+  delete[] _layer_first_edge;
+  delete[] _pair_location;
+
+  _layer_first_pair = new index_t[nb_time_steps + 1];
+  _nb_pairs = 0;
+  for(int t = 0; t < nb_time_steps; t++) {
+    _layer_first_pair[t] = _nb_pairs;
+    for(int l = 0; l < nb_locations; l++) {
+      if(!kept || kept[t][l]) _nb_pairs++;
+    }
+  }
+  _layer_first_pair[nb_time_steps] = _nb_pairs;
+
+  _pair_location = new int[_nb_pairs];
+  // pair_index[t % 2][l] is the pair of (t, l), or -1 if it was pruned
+  index_t **pair_index = allocate_array<index_t>(2, nb_locations);
+
+  // The number of edges and of entrances of every time step, first
+  // counted in _layer_first_edge[t+1] and layer_first_entrance[t+1]
+  _layer_first_edge = new index_t[nb_time_steps + 1];
+  _layer_first_edge[0] = 0;
+  index_t *layer_first_entrance = new index_t[nb_time_steps + 1];
+  layer_first_entrance[0] = 0;
+
+  for(int t = 0; t < nb_time_steps; t++) {
+    index_t p = _layer_first_pair[t];
+    _layer_first_edge[t + 1] = _layer_first_pair[t + 1] - _layer_first_pair[t];
+    layer_first_entrance[t + 1] = 0;
+    for(int i = 0; i < nb_locations; i++) {
+      int l = _location_order ? _location_order[i] : i;
+      if(!kept || kept[t][l]) {
+        _pair_location[p] = l;
+        pair_index[t % 2][l] = p++;
+        if(exits[t][l]) _layer_first_edge[t + 1]++;
+        if(entrances[t][l]) {
+          _layer_first_edge[t + 1]++;
+          layer_first_entrance[t + 1]++;
+        }
+      } else {
+        pair_index[t % 2][l] = -1;
+      }
+    }
+    if(t > 0) {
+      for(int l = 0; l < nb_locations; l++) {
+        if(pair_index[(t - 1) % 2][l] >= 0) {
+          for(int k = _motion_first[l]; k < _motion_first[l + 1]; k++) {
+            if(pair_index[t % 2][_motion_to[k]] >= 0) _layer_first_edge[t]++;
+          }
+        }
+      }
+    }
+  }
+
+  deallocate_array<index_t>(pair_index);
+
+  for(int t = 0; t < nb_time_steps; t++) {
+    _layer_first_edge[t + 1] += _layer_first_edge[t];
+    layer_first_entrance[t + 1] += layer_first_entrance[t];
+  }
+
+  index_t nb_vertices = 2 + 2 * _nb_pairs;
+  index_t nb_edges = _layer_first_edge[nb_time_steps];
+  index_t nb_entrances = layer_first_entrance[nb_time_steps];
+  index_t source = 0, sink = nb_vertices - 1;
+
+  _nb_entrances = nb_entrances;
+
+  if(memory_budget > 0) {
+    MTPPlan plan;
+    plan_sizes(&plan, _nb_pairs, nb_edges, nb_entrances, 0, storage_directory != 0);
+    // The scores are already there, and accounted by allocate
+    if(check_memory(plan.memory_bytes, "graph") < 0) {
+      delete[] layer_first_entrance;
+      return -1;
+    }
+  }
+
+  // The edges are set directly in the graph, every time step
+  // leaving its own vertices, so that blocks of time steps can be
+  // done concurrently
+
+  StoragePolicy storage;
+  storage.directory = storage_directory;
+  storage.pages = storage_pages;
+  storage.numa_node = storage_numa_node;
+  _graph = new MTPGraph(nb_vertices, nb_edges, source, sink, _stats, &storage);
+
+  index_t *entrance_edges = new index_t[nb_entrances];
+  index_t *entrance_nodes = new index_t[nb_entrances];
+
+  int n = nb_build_threads;
+  if(n <= 0) n = int(thread::hardware_concurrency());
+  if(n > nb_time_steps) n = nb_time_steps;
+  if(n <= 1) {
+    set_layer_edges(0, nb_time_steps, layer_first_entrance, entrance_edges, entrance_nodes);
+  } else {
+    thread *threads = new thread[n];
+    for(int k = 0; k < n; k++) {
+      int first = (nb_time_steps * k) / n, last = (nb_time_steps * (k + 1)) / n;
+      threads[k] = thread(&MTPTracker::set_layer_edges, this, first, last - first,
+                          layer_first_entrance, entrance_edges, entrance_nodes);
+    }
+    for(int k = 0; k < n; k++) threads[k].join();
+    delete[] threads;
+  }
+
+  for(index_t k = 0; k < nb_entrances; k++) {
+    _graph->set_edge(entrance_edges[k], source, entrance_nodes[k]);
+  }
+
+  delete[] entrance_edges;
+  delete[] entrance_nodes;
+  delete[] layer_first_entrance;
+
+  // The vertices are numbered by time, so that every edge goes to a
+  // vertex of larger index, and there is no need to sort them
+  _graph->end_construction(1);
+
+  if(_stats) {
+    _stats->nb_vertices = nb_vertices;
+    _stats->nb_edges = nb_edges;
+    _stats->pruning_ratio = pruning_ratio();
+  }
+
+  return 0;
+}
+
+int MTPTracker::build_graph() {
+  int result = 0;
+
+  // Delete the existing graph if there was one
+  delete _graph;
+  _graph = 0;
+
+  // A replay record holds the durations of the phases
+  if(replay_file) enable_stats(1);
+
+  if(_stats) _stats->begin_phase(PHASE_BUILD_GRAPH);
+
+  compute_motion_lists();
+  compute_location_order();
+
+  if(coarse_cell_size > 1 || temporal_factor > 1) {
+    // The graph depends on the coarse solution, track will build it
+  } else if(gating || prune_unreachable_vertices) {
+    int **kept = allocate_array<int>(nb_time_steps, nb_locations);
+    for(int t = 0; t < nb_time_steps; t++) {
+      for(int l = 0; l < nb_locations; l++) {
+        kept[t][l] = 1;
+      }
+    }
+    if(gating) gate(kept);
+    prune_unreachable(kept);
+    result = build_masked_graph(kept);
+    deallocate_array<int>(kept);
+  } else {
+    result = build_masked_graph(0);
+  }
+
+  // The DP ordering done by the MTPGraph constructor is a nested
+  // phase, accounted for separately
+  if(_stats) _stats->end_phase(PHASE_BUILD_GRAPH, 0);
+
+  return result;
+}
+
+scalar_t MTPTracker::pruning_ratio() {
+  if(nb_time_steps == 0 || nb_locations == 0) return 0;
+  return 1 - scalar_t(double(_nb_pairs) / (double(nb_time_steps) * double(nb_locations)));
+}
+
+void MTPTracker::count_graph(int **kept, index_t *nb_pairs, index_t *nb_edges,
+                             index_t *nb_entrances) {
+  *nb_pairs = 0;
+  *nb_edges = 0;
+  *nb_entrances = 0;
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int l = 0; l < nb_locations; l++) {
+      if(!kept || kept[t][l]) {
+        (*nb_pairs)++;
+        if(entrances[t][l]) (*nb_entrances)++;
+        if(exits[t][l]) (*nb_edges)++;
+        if(t < nb_time_steps - 1) {
+          for(int k = _motion_first[l]; k < _motion_first[l + 1]; k++) {
+            if(!kept || kept[t + 1][_motion_to[k]]) (*nb_edges)++;
+          }
+        }
+      }
+    }
+  }
+  *nb_edges += *nb_pairs + *nb_entrances;
+}
+
+void MTPTracker::plan_sizes(MTPPlan *plan, index_t nb_pairs, index_t nb_edges,
+                            index_t nb_entrances, size_t score_bytes, int in_storage) {
+  size_t nb_scores = size_t(nb_time_steps) * size_t(nb_locations);
+  size_t nb_motions = _motion_first ? size_t(_motion_first[nb_locations]) : 0;
+  size_t v = size_t(2 + 2 * nb_pairs), e = size_t(nb_edges);
+  size_t *bytes = plan->structure_bytes;
+
+  plan->nb_pairs = nb_pairs;
+  plan->nb_vertices = index_t(v);
+  plan->nb_edges = nb_edges;
+
+  bytes[STRUCTURE_TOPOLOGY] = 2 * nb_scores * sizeof(int) +
+    (size_t(nb_locations) + 1 + nb_motions) * sizeof(int);
+  if(allowed_motions) {
+    bytes[STRUCTURE_TOPOLOGY] += size_t(nb_locations) * size_t(nb_locations) * sizeof(int);
+  }
+  bytes[STRUCTURE_SCORES] = score_bytes;
+  bytes[STRUCTURE_PAIRS] = size_t(nb_pairs) * sizeof(int) +
+    2 * size_t(nb_time_steps + 1) * sizeof(index_t);
+  if(vertex_order != ORDER_LOCATION) bytes[STRUCTURE_PAIRS] += size_t(nb_locations) * sizeof(int);
+
+  bytes[STRUCTURE_VERTICES] = v * MTPGraph::vertex_bytes();
+  bytes[STRUCTURE_EDGES] = e * MTPGraph::edge_bytes();
+  bytes[STRUCTURE_HEAP] = v * sizeof(void *);
+  bytes[STRUCTURE_DP_ORDER] = v * sizeof(void *);
+  bytes[STRUCTURE_REGION] = incremental_shortest_paths ? v : 0;
+  if(bidirectional_shortest_paths) {
+    // The entering lists go with the edges, the backward search with
+    // the heap
+    bytes[STRUCTURE_EDGES] += e * MTPGraph::bidirectional_edge_bytes() + v * sizeof(Edge *);
+    bytes[STRUCTURE_HEAP] += v * (MTPGraph::bidirectional_vertex_bytes() - sizeof(Edge *));
+  }
+
+  // The masks of the pruning, the pair indices of every thread, and
+  // the edges from the source
+  int nb_threads = nb_build_threads;
+  if(nb_threads <= 0) nb_threads = int(thread::hardware_concurrency());
+  if(nb_threads < 1) nb_threads = 1;
+  bytes[STRUCTURE_BUILD] = size_t(nb_threads) * 2 * size_t(nb_locations) * sizeof(index_t) +
+    2 * size_t(nb_entrances) * sizeof(index_t);
+  if(gating || prune_unreachable_vertices) bytes[STRUCTURE_BUILD] += 3 * nb_scores * sizeof(int);
+
+  // The trajectories are vertex-disjoint and go through at most two
+  // vertices per time step, and the retrieval flags the used edges
+  size_t nb_paths = size_t(nb_entrances);
+  if(max_nb_trajectories > 0 && size_t(max_nb_trajectories) < nb_paths) {
+    nb_paths = size_t(max_nb_trajectories);
+  }
+  size_t nb_nodes = min(nb_paths * size_t(2 * nb_time_steps + 2), v + 2 * nb_paths);
+  bytes[STRUCTURE_PATHS] = nb_paths * (sizeof(Path) + sizeof(Path *)) +
+    nb_nodes * sizeof(index_t) + e * sizeof(int);
+
+  plan->memory_bytes = 0;
+  plan->storage_bytes = 0;
+  for(int s = 0; s < NB_STRUCTURES; s++) {
+    plan->structure_in_storage[s] = in_storage &&
+      (s == STRUCTURE_VERTICES || s == STRUCTURE_EDGES || s == STRUCTURE_HEAP ||
+       s == STRUCTURE_DP_ORDER || s == STRUCTURE_REGION);
+    if(plan->structure_in_storage[s]) plan->storage_bytes += bytes[s];
+    else plan->memory_bytes += bytes[s];
+  }
+}
+
+void MTPTracker::plan(MTPPlan *plan) {
+  compute_motion_lists();
+
+  size_t nb_scores = size_t(nb_time_steps) * size_t(nb_locations);
+  size_t score_bytes;
+  if(_int8_scores) score_bytes = nb_scores + 256 * sizeof(scalar_t);
+  else if(_fp16_scores) score_bytes = nb_scores * 2 + 65536 * sizeof(scalar_t);
+  else score_bytes = nb_scores * sizeof(scalar_t);
+
+  // The same mask as build_graph. The coarse-to-fine graphs depend
+  // on the coarse solution, and plan counts the full one.
+  int **kept = 0;
+  if(prune_unreachable_vertices || gating) {
+    kept = allocate_array<int>(nb_time_steps, nb_locations);
+    for(int t = 0; t < nb_time_steps; t++) {
+      for(int l = 0; l < nb_locations; l++) kept[t][l] = 1;
+    }
+    if(gating) gate(kept);
+    prune_unreachable(kept);
+  }
+
+  index_t nb_pairs, nb_edges, nb_entrances;
+  count_graph(kept, &nb_pairs, &nb_edges, &nb_entrances);
+  deallocate_array<int>(kept);
+
+  plan_sizes(plan, nb_pairs, nb_edges, nb_entrances, score_bytes, storage_directory != 0);
+  plan->upper_bound = coarse_cell_size > 1 || temporal_factor > 1;
+  plan->memory_budget = memory_budget;
+
+  // The number of trajectories, if not bounded, is estimated as the
+  // average number of positive scores per time step
+  int nb_trajectories = max_nb_trajectories;
+  if(nb_trajectories <= 0 && nb_time_steps > 0) {
+    double nb_positives = 0;
+    for(int t = 0; t < nb_time_steps; t++) {
+      for(int l = 0; l < nb_locations; l++) {
+        if(detection_score(t, l) > 0) nb_positives++;
+      }
+    }
+    nb_trajectories = int(ceil(nb_positives / nb_time_steps));
+  }
+  if(nb_trajectories < 1) nb_trajectories = 1;
+  plan->expected_nb_trajectories = nb_trajectories;
+
+  double v = double(plan->nb_vertices), e = double(plan->nb_edges);
+  double full_path = plan->seconds_per_path_edge * e +
+    plan->seconds_per_heap_operation * (e + v * log2(v));
+  plan->build_seconds = plan->seconds_per_build_edge * e;
+  plan->dp_seconds = plan->seconds_per_dp_edge * e;
+  // One more shortest path to find there is none left
+  plan->shortest_path_seconds = full_path +
+    nb_trajectories * full_path *
+    (incremental_shortest_paths && !bidirectional_shortest_paths ? plan->incremental_ratio : 1.0);
+  plan->total_seconds = plan->build_seconds + plan->dp_seconds + plan->shortest_path_seconds;
+
+  // What would fit in the budget, each recommendation adding to the
+  // previous ones
+
+  plan->nb_recommendations = 0;
+  if(memory_budget == 0 || plan->memory_bytes <= memory_budget) return;
+
+  MTPPlan reduced;
+  size_t memory_bytes = plan->memory_bytes, mask_bytes = 0;
+  int in_storage = storage_directory != 0;
+
+  if(!prune_unreachable_vertices && !gating) {
+    kept = allocate_array<int>(nb_time_steps, nb_locations);
+    for(int t = 0; t < nb_time_steps; t++) {
+      for(int l = 0; l < nb_locations; l++) kept[t][l] = 1;
+    }
+    prune_unreachable(kept);
+    index_t nb_pruned_pairs;
+    count_graph(kept, &nb_pruned_pairs, &nb_edges, &nb_entrances);
+    deallocate_array<int>(kept);
+    if(nb_pruned_pairs < nb_pairs) {
+      nb_pairs = nb_pruned_pairs;
+      mask_bytes = 3 * nb_scores * sizeof(int);
+      plan_sizes(&reduced, nb_pairs, nb_edges, nb_entrances, score_bytes, in_storage);
+      memory_bytes = reduced.memory_bytes + mask_bytes;
+      plan->recommendations[plan->nb_recommendations] = "--prune";
+      plan->recommended_memory_bytes[plan->nb_recommendations++] = memory_bytes;
+    }
+  }
+
+  if(memory_bytes > memory_budget && detection_scores && !_detection_scores_borrowed) {
+    memory_bytes -= score_bytes;
+    score_bytes = nb_scores + 256 * sizeof(scalar_t);
+    memory_bytes += score_bytes;
+    plan->recommendations[plan->nb_recommendations] = "--quantize int8";
+    plan->recommended_memory_bytes[plan->nb_recommendations++] = memory_bytes;
+  }
+
+  if(memory_bytes > memory_budget && !in_storage) {
+    in_storage = 1;
+    plan_sizes(&reduced, nb_pairs, nb_edges, nb_entrances, score_bytes, in_storage);
+    memory_bytes = reduced.memory_bytes + mask_bytes;
+    plan->recommendations[plan->nb_recommendations] = "--storage <directory>";
+    plan->recommended_memory_bytes[plan->nb_recommendations++] = memory_bytes;
+  }
+
+  if(memory_bytes > memory_budget) {
+    // The fine graph is then restricted to the surroundings of the
+    // coarse trajectories, by how much depends on the scores
+    plan->recommendations[plan->nb_recommendations] =
+      grid_width > 0 ? "--coarse-to-fine 2" : "--temporal-factor 4";
+    plan->recommended_memory_bytes[plan->nb_recommendations++] = 0;
+  }
+}
+
+void MTPTracker::set_score_lengths() {
+  for(int t = 0; t < nb_time_steps; t++) {
+    // The edges inside the node pairs come first in every time step
+    index_t e = _layer_first_edge[t];
+    for(index_t p = _layer_first_pair[t]; p < _layer_first_pair[t + 1]; p++) {
+      _graph->set_length(e++, - detection_score(t, _pair_location[p]));
+    }
+  }
+}
+
+void MTPTracker::print_graph_dot(ostream *os) {
+  set_score_lengths();
+  _graph->print_dot(os);
+}
+
+int MTPTracker::coarse_cell(int l) {
+  return (l / grid_width / coarse_cell_size) * _coarse_width
+    + (l % grid_width) / coarse_cell_size;
+}
+
+int MTPTracker::build_coarse_tracker(MTPTracker *coarse) {
+  int nb_cells = _coarse_width * _coarse_height;
+
+  coarse->memory_budget = memory_budget;
+  if(coarse->allocate(nb_time_steps, nb_cells) < 0) return -1;
+
+  for(int l = 0; l < nb_locations; l++) {
+    for(int k = _motion_first[l]; k < _motion_first[l + 1]; k++) {
+      coarse->allowed_motions[coarse_cell(l)][coarse_cell(_motion_to[k])] = 1;
+    }
+  }
+
+  for(int t = 0; t < nb_time_steps; t++) {
+    scalar_t *scores = coarse->detection_scores[t];
+
+    for(int c = 0; c < nb_cells; c++) scores[c] = -FLT_MAX;
+
+    for(int l = 0; l < nb_locations; l++) {
+      int c = coarse_cell(l);
+      if(entrances[t][l]) coarse->entrances[t][c] = 1;
+      if(exits[t][l]) coarse->exits[t][c] = 1;
+      if(detection_score(t, l) > scores[c]) scores[c] = detection_score(t, l);
+    }
+
+    // The log-sum-exp is offset by the mean score b of the cell, as
+    // b + log(1 + sum(exp(s - b) - 1)), so that a uniform background
+    // keeps its score and a lone detection its own. The sum is non
+    // negative since exp(x) - 1 >= x, and is computed relative to the
+    // max to avoid overflows
+    if(coarse_pooling == POOLING_LOG_SUM_EXP) {
+      scalar_t *means = new scalar_t[nb_cells], *sums = new scalar_t[nb_cells];
+      int *sizes = new int[nb_cells];
+      for(int c = 0; c < nb_cells; c++) { means[c] = 0; sums[c] = 0; sizes[c] = 0; }
+      for(int l = 0; l < nb_locations; l++) {
+        int c = coarse_cell(l);
+        means[c] += detection_score(t, l);
+        sums[c] += exp(detection_score(t, l) - scores[c]);
+        sizes[c]++;
+      }
+      for(int c = 0; c < nb_cells; c++) {
+        means[c] /= scalar_t(sizes[c]);
+        scalar_t background = exp(means[c] - scores[c]);
+        scores[c] += log(max(sums[c] - scalar_t(sizes[c] - 1) * background, background));
+      }
+      delete[] sizes;
+      delete[] sums;
+      delete[] means;
+    }
+  }
+
+  return 0;
+}
+
+int MTPTracker::dilate_corridor(int *cells, int c, int radius) {
+  int nb_added = 0;
+  int x = c % _coarse_width, y = c / _coarse_width;
+  for(int v = y - radius; v <= y + radius; v++) {
+    for(int u = x - radius; u <= x + radius; u++) {
+      if(u >= 0 && u < _coarse_width && v >= 0 && v < _coarse_height &&
+         !cells[u + v * _coarse_width]) {
+        cells[u + v * _coarse_width] = 1;
+        nb_added++;
+      }
+    }
+  }
+  return nb_added;
+}
+
+int MTPTracker::touches_corridor_border(int *cells, int l) {
+  for(int k = _motion_first[l]; k < _motion_first[l + 1]; k++) {
+    if(!cells[coarse_cell(_motion_to[k])]) return 1;
+  }
+  return 0;
+}
+
+int MTPTracker::track_coarse_to_fine() {
+  if(grid_width <= 0 || nb_locations % grid_width != 0) {
+    cerr << "The number of locations " << nb_locations
+         << " is not a multiple of the grid width " << grid_width << "." << endl;
+    abort();
+  }
+
+  _coarse_width = (grid_width + coarse_cell_size - 1) / coarse_cell_size;
+  _coarse_height = (nb_locations / grid_width + coarse_cell_size - 1) / coarse_cell_size;
+
+  int **corridor = allocate_array<int>(nb_time_steps, _coarse_width * _coarse_height);
+
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int c = 0; c < _coarse_width * _coarse_height; c++) {
+      corridor[t][c] = 0;
+    }
+  }
+
+  // Solve the coarse problem, and take the cells around its
+  // trajectories, at the same and neighboring time steps, as the
+  // initial corridor. The latter is for the targets which do not
+  // change cell at the same time as their coarse trajectory.
+
+  if(_stats) _stats->begin_phase(PHASE_COARSE_SOLVE);
+
+  MTPTracker *coarse = new MTPTracker();
+  if(build_coarse_tracker(coarse) < 0 || coarse->build_graph() < 0 ||
+     coarse->track_until(_deadline, _cancel) < 0) {
+    delete coarse;
+    if(_stats) _stats->end_phase(PHASE_COARSE_SOLVE, 0);
+    deallocate_array<int>(corridor);
+    return -1;
+  }
+
+  for(int k = 0; k < coarse->nb_trajectories(); k++) {
+    int entrance_time = coarse->trajectory_entrance_time(k);
+    for(int u = 0; u < coarse->trajectory_duration(k); u++) {
+      int t = entrance_time + u;
+      for(int s = t - 1; s <= t + 1; s++) {
+        if(s >= 0 && s < nb_time_steps) {
+          dilate_corridor(corridor[s], coarse->trajectory_location(k, u), corridor_radius);
+        }
+      }
+    }
+  }
+
+  delete coarse;
+
+  if(_stats) _stats->end_phase(PHASE_COARSE_SOLVE, 0);
+
+  int **kept = allocate_array<int>(nb_time_steps, nb_locations);
+  int result = 0;
+
+  for(int w = 0; ; w++) {
+    for(int t = 0; t < nb_time_steps; t++) {
+      for(int l = 0; l < nb_locations; l++) {
+        kept[t][l] = corridor[t][coarse_cell(l)];
+      }
+    }
+
+    if(solve_in_mask(kept) < 0) {
+      result = -1;
+      break;
+    }
+
+    if(w == max_corridor_widenings || _graph->interrupted) break;
+
+    // Widen the corridor by one cell around the fine trajectories
+    // which reach its border, on the previous and next time steps as
+    // well, since a trajectory may have been cut there
+
+    int nb_added = 0;
+
+    for(int k = 0; k < nb_trajectories(); k++) {
+      int entrance_time = trajectory_entrance_time(k);
+      for(int u = 0; u < trajectory_duration(k); u++) {
+        int t = entrance_time + u;
+        int l = trajectory_location(k, u), c = coarse_cell(l);
+        if(touches_corridor_border(corridor[t], l)) {
+          for(int s = t - 1; s <= t + 1; s++) {
+            if(s >= 0 && s < nb_time_steps) {
+              nb_added += dilate_corridor(corridor[s], c, 1);
+            }
+          }
+        }
+      }
+    }
+
+    if(nb_added == 0) break;
+
+    if(_stats) _stats->nb_corridor_widenings++;
+  }
+
+  deallocate_array<int>(kept);
+  deallocate_array<int>(corridor);
+
+  return result;
+}
+
+void MTPTracker::build_temporal_coarse_tracker(MTPTracker *coarse) {
+  int k = temporal_factor;
+  int nb_blocks = (nb_time_steps + k - 1) / k;
+
+  coarse->allocate_without_motions(nb_blocks, nb_locations);
+
+  // The motions in k steps, computed by propagating k times the set
+  // of reachable locations
+
+  int *next = new int[nb_locations];
+  int *list = new int[nb_locations], *next_list = new int[nb_locations];
+  int nb_motions = 0, size = nb_locations;
+  int *motion_to = new int[size];
+
+  for(int l = 0; l < nb_locations; l++) next[l] = 0;
+
+  coarse->_motion_first = new int[nb_locations + 1];
+
+  for(int l = 0; l < nb_locations; l++) {
+    int n = 1;
+    list[0] = l;
+    for(int s = 0; s < k; s++) {
+      int next_n = 0;
+      for(int i = 0; i < n; i++) {
+        int m = list[i];
+        for(int j = _motion_first[m]; j < _motion_first[m + 1]; j++) {
+          if(!next[_motion_to[j]]) {
+            next[_motion_to[j]] = 1;
+            next_list[next_n++] = _motion_to[j];
+          }
+        }
+      }
+      for(int i = 0; i < next_n; i++) next[next_list[i]] = 0;
+      int *tmp = list; list = next_list; next_list = tmp;
+      n = next_n;
+    }
+
+    coarse->_motion_first[l] = nb_motions;
+    if(nb_motions + n > size) {
+      size = 2 * size + n;
+      int *tmp = new int[size];
+      for(int i = 0; i < nb_motions; i++) tmp[i] = motion_to[i];
+      delete[] motion_to;
+      motion_to = tmp;
+    }
+    for(int i = 0; i < n; i++) motion_to[nb_motions++] = list[i];
+  }
+
+  coarse->_motion_first[nb_locations] = nb_motions;
+  coarse->_motion_to = motion_to;
+
+  delete[] next_list;
+  delete[] list;
+  delete[] next;
+
+  // The score of (b, l) is the best total score of a trajectory
+  // going through the frames of block b from l, computed backward
+  // from the last frame of the block
+
+  scalar_t *best = new scalar_t[nb_locations];
+
+  for(int b = 0; b < nb_blocks; b++) {
+    int start = b * k, end = start + k;
+    if(end > nb_time_steps) end = nb_time_steps;
+
+    for(int l = 0; l < nb_locations; l++) {
+      best[l] = detection_score(end - 1, l);
+    }
+
+    for(int t = end - 2; t >= start; t--) {
+      scalar_t *scores = coarse->detection_scores[b];
+      for(int l = 0; l < nb_locations; l++) {
+        scalar_t s = -FLT_MAX;
+        for(int j = _motion_first[l]; j < _motion_first[l + 1]; j++) {
+          if(best[_motion_to[j]] > s) s = best[_motion_to[j]];
+        }
+        scores[l] = detection_score(t, l) + s;
+      }
+      for(int l = 0; l < nb_locations; l++) best[l] = scores[l];
+    }
+
+    // Only the local maxima are kept, so that a trail does not get
+    // several coarse trajectories side by side. The others get the
+    // score of staying at their location.
+
+    for(int l = 0; l < nb_locations; l++) {
+      int maximum = 1;
+      for(int j = _motion_first[l]; maximum && j < _motion_first[l + 1]; j++) {
+        maximum = best[_motion_to[j]] <= best[l];
+      }
+      if(maximum) {
+        coarse->detection_scores[b][l] = best[l];
+      } else {
+        scalar_t s = 0;
+        for(int t = start; t < end; t++) s += detection_score(t, l);
+        coarse->detection_scores[b][l] = s;
+      }
+      for(int t = start; t < end; t++) {
+        if(entrances[t][l]) coarse->entrances[b][l] = 1;
+        if(exits[t][l]) coarse->exits[b][l] = 1;
+      }
+    }
+  }
+
+  delete[] best;
+}
+
+int MTPTracker::dilate_tube(int *tube, int l, int radius, int *distance, int *queue) {
+  int nb_added = 0, head = 0, tail = 0;
+
+  distance[l] = 0;
+  queue[tail++] = l;
+
+  while(head < tail) {
+    int m = queue[head++];
+    if(!tube[m]) {
+      tube[m] = 1;
+      nb_added++;
+    }
+    if(distance[m] < radius) {
+      for(int j = _motion_first[m]; j < _motion_first[m + 1]; j++) {
+        int n = _motion_to[j];
+        if(distance[n] < 0) {
+          distance[n] = distance[m] + 1;
+          queue[tail++] = n;
+        }
+      }
+    }
+  }
+
+  for(int i = 0; i < tail; i++) distance[queue[i]] = -1;
+
+  return nb_added;
+}
+
+int MTPTracker::track_temporal_coarse_to_fine() {
+  int k = temporal_factor;
+  int radius = k - 1 + corridor_radius;
+
+  int **tube = allocate_array<int>(nb_time_steps, nb_locations);
+  int *distance = new int[nb_locations], *queue = new int[nb_locations];
+
+  for(int l = 0; l < nb_locations; l++) distance[l] = -1;
+
+  for(int t = 0; t < nb_time_steps; t++) {
+    for(int l = 0; l < nb_locations; l++) {
+      tube[t][l] = 0;
+    }
+  }
+
+  // Solve on one frame out of k, and take as the initial tubes the
+  // locations less than k-1 motions away from the coarse trajectory
+  // during its block, since the target may be anywhere in it
+
+  if(_stats) _stats->begin_phase(PHASE_COARSE_SOLVE);
+
+  MTPTracker *coarse = new MTPTracker();
+  coarse->memory_budget = memory_budget;
+  build_temporal_coarse_tracker(coarse);
+  if(coarse->build_graph() < 0 || coarse->track_until(_deadline, _cancel) < 0) {
+    delete coarse;
+    if(_stats) _stats->end_phase(PHASE_COARSE_SOLVE, 0);
+    delete[] queue;
+    delete[] distance;
+    deallocate_array<int>(tube);
+    return -1;
+  }
+
+  for(int c = 0; c < coarse->nb_trajectories(); c++) {
+    int entrance_time = coarse->trajectory_entrance_time(c);
+    for(int u = 0; u < coarse->trajectory_duration(c); u++) {
+      int l = coarse->trajectory_location(c, u);
+      for(int t = (entrance_time + u) * k; t < (entrance_time + u + 1) * k && t < nb_time_steps; t++) {
+        dilate_tube(tube[t], l, radius, distance, queue);
+      }
+    }
+  }
+
+  delete coarse;
+
+  if(_stats) _stats->end_phase(PHASE_COARSE_SOLVE, 0);
+
+  int **kept = allocate_array<int>(nb_time_steps, nb_locations);
+  int result = 0;
+
+  for(int w = 0; ; w++) {
+    for(int t = 0; t < nb_time_steps; t++) {
+      for(int l = 0; l < nb_locations; l++) {
+        kept[t][l] = tube[t][l];
+      }
+    }
+
+    if(solve_in_mask(kept) < 0) {
+      result = -1;
+      break;
+    }
+
+    if(w == max_corridor_widenings || _graph->interrupted) break;
+
+    // Widen the tubes by k motions around the fine trajectories which
+    // reach their border
+
+    int nb_added = 0;
+
+    for(int c = 0; c < nb_trajectories(); c++) {
+      int entrance_time = trajectory_entrance_time(c);
+      for(int u = 0; u < trajectory_duration(c); u++) {
+        int t = entrance_time + u;
+        int l = trajectory_location(c, u);
+        int touches = 0;
+        for(int j = _motion_first[l]; !touches && j < _motion_first[l + 1]; j++) {
+          touches = !tube[t][_motion_to[j]];
+        }
+        if(touches) {
+          for(int s = t - 1; s <= t + 1; s++) {
+            if(s >= 0 && s < nb_time_steps) {
+              nb_added += dilate_tube(tube[s], l, k, distance, queue);
+            }
+          }
+        }
+      }
+    }
+
+    if(nb_added == 0) break;
+
+    if(_stats) _stats->nb_corridor_widenings++;
+  }
+
+  deallocate_array<int>(kept);
+  delete[] queue;
+  delete[] distance;
+  deallocate_array<int>(tube);
+
+  return result;
+}
+
+int MTPTracker::solve_in_mask(int **kept) {
+  delete _graph;
+  _graph = 0;
+
+  if(_stats) _stats->begin_phase(PHASE_BUILD_GRAPH);
+  if(gating) gate(kept);
+  prune_unreachable(kept);
+  int result = build_masked_graph(kept);
+  if(_stats) _stats->end_phase(PHASE_BUILD_GRAPH, 0);
+  if(result < 0) return -1;
+
+  set_score_lengths();
+  _graph->set_interruption(_deadline, _cancel);
+  _graph->set_incremental(incremental_shortest_paths);
+  _graph->set_bidirectional(bidirectional_shortest_paths);
+  _graph->find_best_paths(0,
+                          max_nb_trajectories, min_trajectory_gain, exact_nb_trajectories);
+  _graph->retrieve_disjoint_paths();
+
+  return 0;
+}
+
+int MTPTracker::nb_initial_trajectories() {
+  return _nb_initial_trajectories;
+}
+
+void MTPTracker::set_initial_paths() {
+  if(_nb_initial_trajectories == 0) {
+    _graph->set_initial_paths(0, 0, 0);
+    return;
+  }
+
+  int nb = _nb_initial_trajectories, error = 0;
+  index_t *first = new index_t[nb + 1];
+  index_t *nodes = new index_t[2 * _initial_first[nb] + 2 * nb];
+  index_t n = 0;
+
+  for(int k = 0; k < nb && !error; k++) {
+    first[k] = n;
+    nodes[n++] = 0;
+    for(int i = _initial_first[k]; i < _initial_first[k + 1] && !error; i++) {
+      int t = _initial_entrance_times[k] + i - _initial_first[k];
+      index_t p = _layer_first_pair[t];
+      while(p < _layer_first_pair[t + 1] && _pair_location[p] != _initial_locations[i]) p++;
+      if(p < _layer_first_pair[t + 1]) {
+        nodes[n++] = early_pair_node(t, p);
+        nodes[n++] = late_pair_node(t, p);
+      } else {
+        error = 1;
+      }
+    }
+    nodes[n++] = 1 + 2 * _nb_pairs;
+  }
+  first[nb] = n;
+
+  if(error || _graph->set_initial_paths(nb, first, nodes) < 0) {
+    cerr << "The initial trajectories go through pruned locations, they are ignored." << endl;
+    _graph->set_initial_paths(0, 0, 0);
+  }
+
+  delete[] first;
+  delete[] nodes;
+}
+
+ScoreTransform::ScoreTransform() {
+  offset = 0;
+  scale = 1;
+  clamp = 0;
+}
+
+void MTPTracker::sweep_block(int nb, const ScoreTransform *transforms, SweepResult *results) {
+  MTPGraph *graph = new MTPGraph(_graph);
+  graph->set_incremental(incremental_shortest_paths);
+  graph->set_bidirectional(bidirectional_shortest_paths);
+
+  index_t *first = 0, *nodes = 0;
+
+  for(int k = 0; k < nb; k++) {
+    double start_time = now_in_seconds();
+
+    for(int t = 0; t < nb_time_steps; t++) {
+      index_t e = _layer_first_edge[t];
+      for(index_t p = _layer_first_pair[t]; p < _layer_first_pair[t + 1]; p++) {
+        graph->set_length(e++, - transforms[k].apply(detection_score(t, _pair_location[p])));
+      }
+    }
+
+    // The paths of the previous transform
+    int nb_paths = graph->nb_paths;
+    delete[] first;
+    delete[] nodes;
+    first = new index_t[nb_paths + 1];
+    first[0] = 0;
+    for(int q = 0; q < nb_paths; q++) first[q + 1] = first[q] + graph->paths[q]->nb_nodes;
+    nodes = new index_t[first[nb_paths]];
+    for(int q = 0; q < nb_paths; q++) {
+      for(int n = 0; n < graph->paths[q]->nb_nodes; n++) {
+        nodes[first[q] + n] = graph->paths[q]->nodes[n];
+      }
+    }
+    graph->set_initial_paths(nb_paths, first, nodes);
+
+    graph->find_best_paths(0,
+                           max_nb_trajectories, min_trajectory_gain, exact_nb_trajectories);
+    graph->retrieve_disjoint_paths();
+
+    results[k].total_score = - graph->total_length;
+    results[k].nb_trajectories = graph->nb_paths;
+    results[k].nb_initial_trajectories = nb_paths;
+    results[k].duration = now_in_seconds() - start_time;
+  }
+
+  delete[] first;
+  delete[] nodes;
+  delete graph;
+}
+
+int MTPTracker::sweep(int nb_transforms, const ScoreTransform *transforms, SweepResult *results,
+                      int nb_threads) {
+  if(coarse_cell_size > 1 || temporal_factor > 1) {
+    cerr << "The coarse-to-fine trackings can not be swept." << endl;
+    abort();
+  }
+
+  if(!_graph) return -1;
+
+  int n = nb_threads;
+  if(n <= 0) n = int(thread::hardware_concurrency());
+  if(n > nb_transforms) n = nb_transforms;
+  if(n < 1) n = 1;
+
+  if(memory_budget > 0) {
+    // The structures of the graph, once per copy
+    MTPPlan plan;
+    plan_sizes(&plan, _nb_pairs, _layer_first_edge[nb_time_steps], _nb_entrances, 0,
+               storage_directory != 0);
+    size_t graph_bytes = 0;
+    for(int s = STRUCTURE_VERTICES; s < NB_STRUCTURES; s++) {
+      if(s != STRUCTURE_BUILD && !plan.structure_in_storage[s]) {
+        graph_bytes += plan.structure_bytes[s];
+      }
+    }
+    while(n > 1 && plan.memory_bytes + size_t(n) * graph_bytes > memory_budget) n--;
+    if(check_memory(plan.memory_bytes + size_t(n) * graph_bytes, "graph of the sweep") < 0) {
+      return -1;
+    }
+  }
+
+  if(n <= 1) {
+    sweep_block(nb_transforms, transforms, results);
+  } else {
+    thread *threads = new thread[n];
+    for(int k = 0; k < n; k++) {
+      int first = (nb_transforms * k) / n, last = (nb_transforms * (k + 1)) / n;
+      threads[k] = thread(&MTPTracker::sweep_block, this, last - first,
+                          transforms + first, results + first);
+    }
+    for(int k = 0; k < n; k++) threads[k].join();
+    delete[] threads;
+  }
+
+  return 0;
+}
+
+int MTPTracker::track(double time_budget, const atomic<bool> *cancel) {
+  return track_until(time_budget > 0 ? now_in_seconds() + time_budget : 0, cancel);
+}
+
+future<int> MTPTracker::track_async(double time_budget, const atomic<bool> *cancel) {
+  return async(launch::async, &MTPTracker::track, this, time_budget, cancel);
+}
+
+// The trackers of a server may capture concurrently
+static mutex replay_mutex;
+
+int MTPTracker::track_until(double deadline, const atomic<bool> *cancel) {
+  double start_time = now_in_seconds();
+  int result = 0;
+
+  _deadline = deadline;
+  _cancel = cancel;
+
+  if(replay_file) enable_stats(1);
+
+  if(coarse_cell_size > 1 && temporal_factor > 1) {
+    cerr << "The spatial and temporal coarse-to-fine trackings can not be combined." << endl;
+    abort();
+  }
+
+  if((coarse_cell_size > 1 || temporal_factor > 1) && corridor_radius < 0) {
+    cerr << "The corridor radius can not be negative." << endl;
+    abort();
+  }
+
+  if((coarse_cell_size > 1 || temporal_factor > 1) && (checkpoint_file || resume_file)) {
+    cerr << "The coarse-to-fine trackings can not be checkpointed." << endl;
+    abort();
+  }
+
+  if((coarse_cell_size > 1 || temporal_factor > 1) && _nb_initial_trajectories > 0) {
+    cerr << "The coarse-to-fine trackings can not start from initial trajectories." << endl;
+    abort();
+  }
+
+  if(coarse_cell_size > 1) {
+    result = track_coarse_to_fine();
+  } else if(temporal_factor > 1) {
+    result = track_temporal_coarse_to_fine();
+  } else if(!_graph) {
+    // build_graph was not called, or was over memory_budget
+    result = -1;
+  } else {
+    set_score_lengths();
+
+    _graph->set_interruption(_deadline, _cancel);
+    _graph->set_incremental(incremental_shortest_paths);
+    _graph->set_bidirectional(bidirectional_shortest_paths);
+    _graph->set_checkpoint(checkpoint_file, checkpoint_period, checkpoint_request);
+    _graph->set_resume(resume_file);
+    set_initial_paths();
+    _graph->find_best_paths(0,
+                            max_nb_trajectories, min_trajectory_gain, exact_nb_trajectories);
+    _graph->retrieve_disjoint_paths();
+  }
+
+  if(result < 0) {
+    delete _graph;
+    _graph = 0;
+    return -1;
+  }
+
+  if(_stats && _dequantization) {
+    int nb_locations_on_trajectories = 0;
+    for(int k = 0; k < nb_trajectories(); k++) {
+      nb_locations_on_trajectories += trajectory_duration(k);
+    }
+    _stats->quantization_max_error = _quantization_max_error;
+    _stats->quantization_score_error = scalar_t(nb_locations_on_trajectories) * _quantization_max_error;
+  }
+
+  if(replay_file && !interrupted()) {
+    double duration = now_in_seconds() - start_time;
+    lock_guard<mutex> lock(replay_mutex);
+    ofstream out(replay_file, ios::binary | ios::app);
+    write_replay(&out, duration);
+    out.close();
+    // Like a checkpoint, a failed capture does not stop the tracking
+    if(!out) cerr << "Can not write the replay record to " << replay_file << "." << endl;
+  }
+
+#ifdef VERBOSE
+  for(int p = 0; p < _graph->nb_paths; p++) {
+    Path *path = _graph->paths[p];
+    cout << "PATH " << p << " [length " << path->nb_nodes << "] " << path->nodes[0];
     for(int n = 1; n < path->nb_nodes; n++) {
       cout << " -> " << path->nodes[n];
     }
     cout << endl;
   }
 #endif
+
+  return 0;
+}
+
+// Without a graph, after a track which failed, there is no trajectory
+
+int MTPTracker::interrupted() {
+  return _graph ? _graph->interrupted : 0;
+}
+
+scalar_t MTPTracker::total_score() {
+  return _graph ? -_graph->total_length : 0;
 }
 
 int MTPTracker::nb_trajectories() {
-  return _graph->nb_paths;
+  return _graph ? _graph->nb_paths : 0;
 }
 
 scalar_t MTPTracker::trajectory_score(int k) {
@@ -316,7 +2229,7 @@ scalar_t MTPTracker::trajectory_score(int k) {
 }
 
 int MTPTracker::trajectory_entrance_time(int k) {
-  return (_graph->paths[k]->nodes[1] - 1) / (2 * nb_locations);
+  return node_time(_graph->paths[k]->nodes[1]);
 }
 
 int MTPTracker::trajectory_duration(int k) {
@@ -324,5 +2237,19 @@ int MTPTracker::trajectory_duration(int k) {
 }
 
 int MTPTracker::trajectory_location(int k, int time_from_entry) {
-  return (_graph->paths[k]->nodes[2 * time_from_entry + 1] - 1) % nb_locations;
+  return node_location(_graph->paths[k]->nodes[2 * time_from_entry + 1]);
+}
+
+void MTPTracker::enable_stats(int enabled) {
+  if(enabled && !_stats) {
+    _stats = new MTPStats();
+  } else if(!enabled && _stats) {
+    delete _stats;
+    _stats = 0;
+  }
+  if(_graph) _graph->set_stats(_stats);
+}
+
+MTPStats *MTPTracker::stats() {
+  return _stats;
 }
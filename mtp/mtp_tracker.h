@@ -26,24 +26,215 @@
 #define MTP_TRACKER_H
 
 #include <iostream>
+#include <future>
 
 using namespace std;
 
 #include "misc.h"
 #include "mtp_graph.h"
+#include "mtp_plan.h"
+
+// A transform of the detection scores for MTPTracker::sweep: a score
+// s becomes offset + scale * s, bounded to [-clamp, clamp] if clamp
+// is not zero. The scores of MTPDetections are affine in the
+// probability of detection, so changing their false positive and
+// negative rates is such a transform, see README.txt.
+
+class ScoreTransform {
+public:
+  scalar_t offset, scale, clamp;
+
+  // The identity
+  ScoreTransform();
+
+  scalar_t apply(scalar_t s) const {
+    s = offset + scale * s;
+    if(clamp > 0) {
+      if(s > clamp) s = clamp;
+      else if(s < - clamp) s = - clamp;
+    }
+    return s;
+  }
+};
+
+// What MTPTracker::sweep found for one transform
+
+class SweepResult {
+public:
+  scalar_t total_score;
+  int nb_trajectories;
+  // The trajectories the solve started from, those of the previous
+  // transform, and its duration
+  int nb_initial_trajectories;
+  double duration;
+};
+
+// What a replay record says of the tracking it was captured from,
+// see MTPTracker::replay_file
+
+class ReplayRecord {
+public:
+  scalar_t total_score;
+  int nb_trajectories;
+  // The duration of track, and of its phases as counted by the
+  // statistics, all zero if they were disabled
+  double duration;
+  double phase_durations[NB_PHASES];
+};
 
 class MTPTracker {
+  // Which reads the topology and the scores directly
+  friend class MTPGreedy;
+
+  // The edges are grouped by time step, the ones of time t being
+  // _layer_first_edge[t] to _layer_first_edge[t+1]-1. They are first
+  // the edges inside the node pairs of time t, which have lengths
+  // equal to the opposite of the detection scores, then the edges of
+  // the motions to t+1, and finally the edges from source and to
+  // sink, of length zero.
   MTPGraph *_graph;
+  index_t *_layer_first_edge;
+
+  // The quantized detection scores, see quantize_detection_scores.
+  // The score of (t, l) is _dequantization[code] where code is the
+  // byte or the half-precision float at t * nb_locations + l.
+  unsigned char *_int8_scores;
+  unsigned short *_fp16_scores;
+  scalar_t *_dequantization;
+  scalar_t _quantization_max_error;
+
+  // Null when the statistics are disabled
+  MTPStats *_stats;
+
+  // The allowed motions as lists: the locations reachable from l are
+  // _motion_to[_motion_first[l]] to _motion_to[_motion_first[l+1]-1]
+  int *_motion_first, *_motion_to;
+
+  // The (t, l) which have a node pair in the graph. The pairs of time
+  // t are numbered from _layer_first_pair[t] to
+  // _layer_first_pair[t+1]-1, in the order of _location_order, and
+  // the location of pair p is _pair_location[p]. Without pruning and
+  // with the locations in increasing order, pair (t, l) is t *
+  // nb_locations + l.
+  index_t _nb_pairs;
+  index_t *_layer_first_pair;
+  int *_pair_location;
+
+  // The number of entrance edges of the graph, for the sweep copies
+  index_t _nb_entrances;
+
+  // The two nodes of the pair p of time t
+  index_t early_pair_node(int t, index_t p);
+  index_t late_pair_node(int t, index_t p);
+  int node_time(index_t n);
+  int node_location(index_t n);
+
+  void compute_motion_lists();
+
+  // The locations in the order their node pairs are numbered in every
+  // time step, see vertex_order. Null for the increasing order.
+  int *_location_order;
+  void compute_location_order();
+
+  // Sets to 0 in kept the (t, l) farther than gating_radius from
+  // every location with a detection score above gating_threshold. It
+  // keeps no corridor between the regions left, the entrances and the
+  // exits, so trajectories crossing longer gaps are cut.
+  void gate(int **kept);
+
+  // Sets to 0 in kept the (t, l) which are not on a path from an
+  // entrance to an exit going only through kept ones
+  void prune_unreachable(int **kept);
+
+  // Builds the graph with a node pair for every (t, l) such that
+  // kept[t][l] is non-zero, or for all of them if kept is null.
+  // Returns -1 and builds none if it is over memory_budget.
+  int build_masked_graph(int **kept);
+
+  // Sets the edges of the nb_t time steps from first_t in _graph,
+  // but the ones from the source, which are stored from
+  // layer_first_entrance[t] in entrance_edges, with their terminal
+  // node in entrance_nodes
+  void set_layer_edges(int first_t, int nb_t, index_t *layer_first_entrance,
+                       index_t *entrance_edges, index_t *entrance_nodes);
+
+  void set_score_lengths();
+
+  // The sizes of the graph build_masked_graph would build with kept
+  void count_graph(int **kept, index_t *nb_pairs, index_t *nb_edges, index_t *nb_entrances);
+
+  // Fills the sizes of plan for a graph of these sizes, scores taking
+  // score_bytes, and the graph in the file-backed storage if
+  // in_storage is non-zero
+  void plan_sizes(MTPPlan *plan, index_t nb_pairs, index_t nb_edges, index_t nb_entrances,
+                  size_t score_bytes, int in_storage);
+
+  // Prints why and returns -1 if bytes is above memory_budget, 0
+  // otherwise
+  int check_memory(size_t bytes, const char *what);
+
+  // The coarse grid of the coarse-to-fine tracking
+  int _coarse_width, _coarse_height;
+
+  // The coarse-to-fine trackings and their coarse trackers return -1
+  // when a graph or a coarse tracker is over memory_budget
+  int coarse_cell(int l);
+  int build_coarse_tracker(MTPTracker *coarse);
+  // Adds to the corridor cells the ones at most radius cells away
+  // from c, and returns how many were added
+  int dilate_corridor(int *cells, int c, int radius);
+  // Returns 1 if a motion from l leaves the corridor cells
+  int touches_corridor_border(int *cells, int l);
+  int track_coarse_to_fine();
+
+  // The same on one frame out of temporal_factor
+  void build_temporal_coarse_tracker(MTPTracker *coarse);
+  // Adds to the tube the locations at most radius motions away from
+  // l, and returns how many were added. distance has to be -1
+  // everywhere, and is left so.
+  int dilate_tube(int *tube, int l, int radius, int *distance, int *queue);
+  int track_temporal_coarse_to_fine();
 
-  // The edges will be ordered as follows: First the nb_locations *
-  // nb_time_steps edges inside the node pairs, which will have
-  // lengths equal to the opposite of the detection scores, then the
-  // edges between these node pairs, and finally the edges from source
-  // and to sink.
-  scalar_t *_edge_lengths;
+  // Builds the graph for the kept (t, l) and tracks on it
+  int solve_in_mask(int **kept);
 
-  int early_pair_node(int t, int l);
-  int late_pair_node(int t, int l);
+  // Solves the nb transforms with a copy of _graph, each one starting
+  // from the trajectories of the previous one
+  void sweep_block(int nb, const ScoreTransform *transforms, SweepResult *results);
+
+  // The trajectories set with set_initial_trajectories. Trajectory k
+  // enters at _initial_entrance_times[k] and goes through the
+  // locations _initial_locations[_initial_first[k]] to
+  // _initial_locations[_initial_first[k+1]-1].
+  int _nb_initial_trajectories;
+  int *_initial_entrance_times, *_initial_first, *_initial_locations;
+
+  int motion_allowed(int l, int m);
+
+  // Gives the initial trajectories to _graph as paths, or nothing if
+  // some of their (t, l) were pruned
+  void set_initial_paths();
+
+  scalar_t detection_score(int t, int l) {
+    if(detection_scores) return detection_scores[t][l];
+    size_t k = size_t(t) * size_t(nb_locations) + size_t(l);
+    if(_int8_scores) return _dequantization[_int8_scores[k]];
+    return _dequantization[_fp16_scores[k]];
+  }
+
+  // Non-zero if the rows of detection_scores point into a buffer we
+  // do not own
+  int _detection_scores_borrowed;
+
+  // Where track stops, see there
+  double _deadline;
+  const atomic<bool> *_cancel;
+
+  int track_until(double deadline, const atomic<bool> *cancel);
+
+  // Allocates everything but allowed_motions, for trackers whose
+  // motion lists are set directly
+  void allocate_without_motions(int nb_time_steps, int nb_locations);
 
 public:
 
@@ -52,27 +243,242 @@ public:
   int **allowed_motions;
   int **entrances, **exits;
 
-  // The detection scores at each location and time
+  // The detection scores at each location and time, null once they
+  // are quantized
   scalar_t **detection_scores;
 
   MTPTracker();
   ~MTPTracker();
 
-  void allocate(int nb_time_steps, int nb_locations);
+  // The allocations return -1 and leave the tracker as it was if
+  // they are over memory_budget, 0 otherwise
+  int allocate(int nb_time_steps, int nb_locations);
   void free();
 
+  // Allocates with the motions given as lists instead of
+  // allowed_motions, which stays null: the locations reachable from l
+  // are motion_to[motion_first[l]] to
+  // motion_to[motion_first[l+1]-1]. This avoids the nb_locations x
+  // nb_locations matrix for large sparse topologies.
+  int allocate(int nb_time_steps, int nb_locations,
+               const int *motion_first, const int *motion_to);
+
+  // Makes detection_scores point into scores, a nb_time_steps x
+  // nb_locations row-major buffer owned by the caller, which has to
+  // stay valid as long as the tracker uses it
+  void borrow_detection_scores(scalar_t *scores);
+
+  // Replaces detection_scores with 8 bits codes of evenly spaced
+  // values, or with half-precision floats, both scaled and offset to
+  // cover the range of the scores. The tracking is then done with the
+  // decoded scores, and the total score of the trajectories may
+  // differ from the exact one by their total duration times
+  // quantization_max_error.
+  enum { QUANTIZATION_NONE, QUANTIZATION_INT8, QUANTIZATION_FP16 };
+  void quantize_detection_scores(int quantization);
+  // The largest difference between a score and its decoded value
+  scalar_t quantization_max_error();
+
   void write(ostream *os);
   void read(istream *is);
   void write_trajectories(ostream *os);
 
-  // Build or print the graph needed for the tracking per se
+  // Writes a replay record of the last track, which took duration
+  // seconds, see replay_file. It is a few bytes per motion, per
+  // entrance and exit, and per score which is not the most frequent
+  // one.
+  void write_replay(ostream *os, double duration);
+  // Allocates the tracker and sets its topology, scores and options
+  // from the next replay record of is, and fills record. Returns -1 at
+  // the end of the file, and aborts if the record is invalid.
+  int read_replay(istream *is, ReplayRecord *record);
+
+  // Sets the trajectories track starts from, for instance the ones of
+  // a previous tracking, instead of starting from none, see
+  // MTPGraph::set_initial_paths. Trajectory k enters at
+  // entrance_times[k] and stays durations[k] time steps, and the
+  // locations of all of them follow each other in locations. Returns
+  // -1 and keeps none if one of them does not start on an entrance,
+  // end on an exit, or follow the allowed motions, or if two of them
+  // go through the same (t, l), and 0 otherwise. They are copied, and
+  // kept until the next call or allocate, with nb zero to remove them.
+  // Not available with the coarse-to-fine trackings.
+  int set_initial_trajectories(int nb, const int *entrance_times, const int *durations,
+                               const int *locations);
+  // The same from trajectories in the format of write_trajectories
+  int read_initial_trajectories(istream *is);
+  int nb_initial_trajectories();
+
+  // Pruning of the graph, done by build_graph. With prune_unreachable
+  // set, only the (t, l) on a path from an entrance to an exit get a
+  // node pair, which does not change the optimal trajectories. With
+  // gating set, a (t, l) gets one only if there is a location with a
+  // score above gating_threshold less than gating_radius motions and
+  // time steps away, and the unreachable ones are pruned too. The
+  // radius can not be negative. Since
+  // the gating depends on the detection scores, they have to be set
+  // before build_graph.
+  int prune_unreachable_vertices;
+  int gating;
+  scalar_t gating_threshold;
+  int gating_radius;
 
-  void build_graph();
+  // Coarse-to-fine tracking, for locations forming a grid of
+  // grid_width columns numbered row by row. With coarse_cell_size
+  // above 1, track first solves on a grid of coarse_cell_size x
+  // coarse_cell_size cells, with the scores pooled with coarse_pooling
+  // (the max, or the log-sum-exp offset by the mean score of the
+  // cell), and then at full resolution only in a corridor of
+  // corridor_radius cells, at least 0, around the coarse trajectories.
+  // Where the fine trajectories reach the border of the corridor, it
+  // is widened and the fine problem solved again, at most
+  // max_corridor_widenings times. The graph is then built by track and
+  // not by build_graph.
+  enum { POOLING_MAX, POOLING_LOG_SUM_EXP };
+  int grid_width;
+  int coarse_cell_size;
+  int coarse_pooling;
+  int corridor_radius;
+  int max_corridor_widenings;
+
+  // Temporal coarse-to-fine tracking. With temporal_factor k above 1,
+  // track first solves on one frame out of k, with the motions
+  // possible in k steps and the scores of every block of k frames
+  // pooled with coarse_pooling and multiplied by k. It then solves at
+  // full frame rate in tubes of k-1+corridor_radius motions around
+  // the coarse trajectories, widened as above. It can not be combined
+  // with the spatial one.
+  int temporal_factor;
+
+  // Build or print the graph needed for the tracking per se. The
+  // build returns -1 and leaves no graph if it is over memory_budget,
+  // 0 otherwise.
+
+  int build_graph();
   void print_graph_dot(ostream *os);
 
-  // Compute the optimal set of trajectories
+  // The fraction of the (t, l) which were pruned by the last
+  // build_graph
+  scalar_t pruning_ratio();
+
+  // Predicts from the topology and the options the size of the graph
+  // build_graph would build, the memory it would take, and the
+  // duration of the tracking according to the cost model of plan. If
+  // that is over memory_budget, it recommends options to reduce it.
+  void plan(MTPPlan *plan);
 
-  void track();
+  // Compute the optimal set of trajectories. With
+  // max_nb_trajectories not zero, it is the optimal set of at most
+  // that many. Trajectories are added only if they increase the total
+  // score by more than min_trajectory_gain. With
+  // exact_nb_trajectories, it is the optimal set of exactly
+  // max_nb_trajectories, which has then to be at least 1, if there
+  // are that many disjoint paths from the entrances to the exits,
+  // whatever their scores.
+
+  int max_nb_trajectories;
+  scalar_t min_trajectory_gain;
+  int exact_nb_trajectories;
+
+  // With incremental_shortest_paths, the shortest path tree is only
+  // repaired below the last trajectory added instead of recomputed,
+  // see MTPGraph::set_incremental
+  int incremental_shortest_paths;
+
+  // With bidirectional_shortest_paths, the shortest paths are computed
+  // from both the source and the sink, see MTPGraph::set_bidirectional
+  int bidirectional_shortest_paths;
+
+  // The order of the node pairs, and so of the vertices and edges,
+  // within a time step. With ORDER_HILBERT or ORDER_MORTON, the
+  // locations, which have to form a grid of grid_width columns, are
+  // visited along a Hilbert or Z-order curve, so that neighbouring
+  // locations have close vertices and edges in memory. The
+  // trajectories are read out in locations anyway.
+  enum { ORDER_LOCATION, ORDER_HILBERT, ORDER_MORTON };
+  int vertex_order;
+
+  // Number of threads build_graph uses to set the edges, one per
+  // core if zero
+  int nb_build_threads;
+
+  // The memory allocate, build_graph, track and sweep can use, in
+  // bytes. They fail before allocating more, as predicted by plan. It
+  // is the size of the RAM by default, and 0 disables the check.
+  size_t memory_budget;
+
+  // If not null, the graph is kept in a memory map of a file in that
+  // directory instead of in memory, see storage.h, for sequences
+  // whose graph is larger than the RAM. The string is not copied.
+  const char *storage_directory;
+
+  // How the arrays of a graph in memory are mapped, with
+  // STORAGE_PAGES_DEFAULT, STORAGE_PAGES_TRANSPARENT or
+  // STORAGE_PAGES_HUGETLB, and the NUMA node they are bound to, or -1
+  // for none, see StoragePolicy. Without binding, every page is on the
+  // node of the thread which touches it first: the one which calls
+  // build_graph for the vertices, and the build threads for the edges
+  // of their time steps.
+  int storage_pages;
+  int storage_numa_node;
+
+  // If not null, every track which is not interrupted appends to that
+  // file a replay record of the tracking: the topology, the scores,
+  // the options above which change the result or the timings, and the
+  // total score, number of trajectories and durations. The stats are
+  // enabled to record the durations of the phases. The trackers of a
+  // process can share the file. The string is not copied.
+  const char *replay_file;
+
+  // Copies all the above options from another tracker
+  void copy_options(MTPTracker *tracker);
+
+  // Checkpointing of a long tracking, which copy_options does not
+  // copy. With checkpoint_file not null, track writes there the state
+  // of the solver every checkpoint_period seconds if it is not zero,
+  // and when *checkpoint_request becomes true if it is not null, for
+  // instance from a signal handler, see MTPGraph::set_checkpoint. With
+  // resume_file not null, track starts from such a checkpoint, written
+  // with the same sequence and options, and gives the same
+  // trajectories as the run which wrote it. Not available with the
+  // coarse-to-fine trackings. The strings are not copied.
+  const char *checkpoint_file;
+  double checkpoint_period;
+  atomic<bool> *checkpoint_request;
+  const char *resume_file;
+
+  // If time_budget is not zero, the tracking stops after that many
+  // seconds, and if cancel is not null, as soon as *cancel becomes
+  // true. The result is then the best set of trajectories found so
+  // far, which is the optimal one with fewer trajectories, and
+  // interrupted returns non-zero. Returns -1 and finds no trajectory
+  // if there is no graph, or if the coarse-to-fine trackings build one
+  // over memory_budget, 0 otherwise.
+  int track(double time_budget = 0, const atomic<bool> *cancel = 0);
+
+  // The same in a background thread. The MTPTracker should not be
+  // used until the returned future is ready.
+  future<int> track_async(double time_budget = 0, const atomic<bool> *cancel = 0);
+
+  // Tracks with the detection scores changed by each of the
+  // nb_transforms transforms, on copies of the graph of build_graph,
+  // and fills the nb_transforms results. The transforms are split in
+  // nb_threads blocks of consecutive ones, or one per core if it is
+  // zero, solved concurrently, each one on its own graph, and every
+  // solve of a block starts from the trajectories of the previous one
+  // instead of from none, see set_initial_trajectories. Nearby
+  // transforms should then follow each other. There are fewer blocks
+  // if their graphs do not fit in memory_budget. The scores and the
+  // trajectories of the tracker are not changed, and the statistics
+  // do not count the sweep. Not available with the coarse-to-fine
+  // trackings. Returns -1 and solves nothing if there is no graph, or
+  // if the graph and a copy are over memory_budget, 0 otherwise.
+  int sweep(int nb_transforms, const ScoreTransform *transforms, SweepResult *results,
+             int nb_threads = 0);
+
+  int interrupted();
+  // The sum of the trajectory scores
+  scalar_t total_score();
 
   // Read-out of the optimal trajectories
 
@@ -81,6 +487,12 @@ public:
   int trajectory_entrance_time(int k);
   int trajectory_duration(int k);
   int trajectory_location(int k, int time_from_entry);
+
+  // Solver statistics. They are disabled by default, and when
+  // enabled, read, build_graph and track accumulate in the same
+  // MTPStats until it is reset.
+  void enable_stats(int enabled);
+  MTPStats *stats();
 };
 
 #endif
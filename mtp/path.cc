@@ -26,7 +26,7 @@
 
 Path::Path(int n) {
   nb_nodes = n;
-  nodes = new int[nb_nodes];
+  nodes = new index_t[nb_nodes];
 }
 
 Path::~Path() {
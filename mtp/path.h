@@ -32,7 +32,7 @@ public:
   Path(int n);
   ~Path();
   int nb_nodes;
-  int *nodes;
+  index_t *nodes;
   scalar_t length;
 };
 
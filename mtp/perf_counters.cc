@@ -0,0 +1,128 @@
+/*
+ *  mtp is the ``Multi Tracked Paths'', an implementation of the
+ *  k-shortest paths algorithm for multi-target tracking.
+ *
+ *  Copyright (c) 2012 Idiap Research Institute, http://www.idiap.ch/
+ *  Written by Francois Fleuret <francois.fleuret@idiap.ch>
+ *
+ *  This file is part of mtp.
+ *
+ *  mtp is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  mtp is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ *  License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with selector.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "perf_counters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#endif
+
+PerfCounters::PerfCounters() {
+  for(int c = 0; c < NB_COUNTERS; c++) _fds[c] = -1;
+}
+
+PerfCounters::~PerfCounters() {
+  close();
+}
+
+#ifdef __linux__
+
+static int open_counter(unsigned int type, unsigned long long config) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // Counts the threads started later too, such as the workers of the
+  // multithreaded phases. Their counts are added when they exit.
+  attr.inherit = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  // The calling thread and its future children, on any CPU
+  return int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+int PerfCounters::open() {
+  close();
+
+  _fds[COUNTER_CYCLES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+  _fds[COUNTER_INSTRUCTIONS] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+  _fds[COUNTER_LLC_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+  _fds[COUNTER_DTLB_MISSES] =
+    open_counter(PERF_TYPE_HW_CACHE,
+                 PERF_COUNT_HW_CACHE_DTLB |
+                 (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+  _fds[COUNTER_BRANCH_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+
+  int nb_available = 0;
+  for(int c = 0; c < NB_COUNTERS; c++) {
+    if(_fds[c] >= 0) nb_available++;
+  }
+  return nb_available;
+}
+
+void PerfCounters::close() {
+  for(int c = 0; c < NB_COUNTERS; c++) {
+    if(_fds[c] >= 0) ::close(_fds[c]);
+    _fds[c] = -1;
+  }
+}
+
+void PerfCounters::read(long long *values) {
+  unsigned long long buffer[3];
+  for(int c = 0; c < NB_COUNTERS; c++) {
+    values[c] = -1;
+    if(_fds[c] >= 0 && ::read(_fds[c], buffer, sizeof(buffer)) == sizeof(buffer)) {
+      // buffer is value, time enabled, time running
+      if(buffer[2] > 0 && buffer[2] < buffer[1]) {
+        values[c] = (long long) (double(buffer[0]) * double(buffer[1]) / double(buffer[2]));
+      } else {
+        values[c] = (long long) buffer[0];
+      }
+    }
+  }
+}
+
+#else
+
+int PerfCounters::open() {
+  return 0;
+}
+
+void PerfCounters::close() { }
+
+void PerfCounters::read(long long *values) {
+  for(int c = 0; c < NB_COUNTERS; c++) values[c] = -1;
+}
+
+#endif
+
+int PerfCounters::available(int counter) {
+  return _fds[counter] >= 0;
+}
+
+const char *PerfCounters::counter_name(int counter) {
+  switch(counter) {
+  case COUNTER_CYCLES: return "cycles";
+  case COUNTER_INSTRUCTIONS: return "instructions";
+  case COUNTER_LLC_MISSES: return "llc_misses";
+  case COUNTER_DTLB_MISSES: return "dtlb_misses";
+  case COUNTER_BRANCH_MISSES: return "branch_misses";
+  default: return "unknown";
+  }
+}
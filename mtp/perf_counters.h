@@ -0,0 +1,61 @@
+/*
+ *  mtp is the ``Multi Tracked Paths'', an implementation of the
+ *  k-shortest paths algorithm for multi-target tracking.
+ *
+ *  Copyright (c) 2012 Idiap Research Institute, http://www.idiap.ch/
+ *  Written by Francois Fleuret <francois.fleuret@idiap.ch>
+ *
+ *  This file is part of mtp.
+ *
+ *  mtp is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  mtp is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ *  License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with selector.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+enum {
+  COUNTER_CYCLES,
+  COUNTER_INSTRUCTIONS,
+  COUNTER_LLC_MISSES,
+  COUNTER_DTLB_MISSES,
+  COUNTER_BRANCH_MISSES,
+  NB_COUNTERS
+};
+
+// Hardware performance counters of the calling thread and of the
+// threads it starts afterwards, read through perf_event_open under
+// Linux. A thread is counted once it has exited. Every counter which
+// cannot be opened (other OS, no PMU in a VM, perf_event_paranoid too
+// restrictive, etc.) is simply marked as unavailable, and reads as -1.
+
+class PerfCounters {
+  int _fds[NB_COUNTERS];
+public:
+  PerfCounters();
+  ~PerfCounters();
+
+  // Opens the counters and returns how many are available
+  int open();
+  void close();
+
+  int available(int counter);
+
+  // Fills values with the current counts, scaled if the kernel had
+  // to multiplex the counters, or -1 for the unavailable ones
+  void read(long long *values);
+
+  static const char *counter_name(int counter);
+};
+
+#endif
@@ -0,0 +1,232 @@
+/*
+ *  mtp is the ``Multi Tracked Paths'', an implementation of the
+ *  k-shortest paths algorithm for multi-target tracking.
+ *
+ *  Copyright (c) 2012 Idiap Research Institute, http://www.idiap.ch/
+ *  Written by Francois Fleuret <francois.fleuret@idiap.ch>
+ *
+ *  This file is part of mtp.
+ *
+ *  mtp is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  mtp is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ *  License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with selector.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "storage.h"
+
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+using namespace std;
+
+StoragePolicy::StoragePolicy() {
+  directory = 0;
+  pages = STORAGE_PAGES_DEFAULT;
+  numa_node = -1;
+}
+
+// Non-zero if the arrays are allocated with new
+
+static int with_new(const StoragePolicy *policy) {
+  return !policy ||
+    (!policy->directory && policy->pages == STORAGE_PAGES_DEFAULT && policy->numa_node < 0);
+}
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#endif
+
+static const size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+// The length of the anonymous map of an array of that size, whole
+// huge pages if they are asked for
+
+static size_t map_length(size_t size, const StoragePolicy *policy) {
+  if(size == 0) size = 1;
+  if(policy->pages == STORAGE_PAGES_DEFAULT) return size;
+  return (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+}
+
+static void bind_to_numa_node(void *p, size_t length, int node) {
+#if defined(__linux__) && defined(__NR_mbind)
+  unsigned long mask[1024 / (8 * sizeof(unsigned long))];
+  const int nb_bits = 8 * sizeof(unsigned long);
+  if(node >= int(8 * sizeof(mask))) {
+    cerr << "There is no NUMA node " << node << "." << endl;
+    abort();
+  }
+  memset(mask, 0, sizeof(mask));
+  mask[node / nb_bits] |= 1UL << (node % nb_bits);
+  // The kernel reads one bit less than maxnode
+  if(syscall(__NR_mbind, p, length, MPOL_BIND, mask, 8 * sizeof(mask) + 1, 0) != 0) {
+    cerr << "Can not bind " << length << " bytes to the NUMA node " << node
+         << ": " << strerror(errno) << endl;
+    abort();
+  }
+#else
+  cerr << "The NUMA binding is not available, ignoring it." << endl;
+#endif
+}
+
+static void *map_in_memory(size_t size, const StoragePolicy *policy) {
+  size_t length = map_length(size, policy);
+  void *p = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+  if(policy->pages == STORAGE_PAGES_HUGETLB) {
+    // Fails if the pool of huge pages is too small
+    p = mmap(0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  }
+#endif
+
+  if(p == MAP_FAILED && policy->pages == STORAGE_PAGES_DEFAULT) {
+    p = mmap(0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  } else if(p == MAP_FAILED) {
+    // Map one huge page more, and trim it to start on a huge page
+    // boundary
+    char *q = (char *) mmap(0, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(q != MAP_FAILED) {
+      char *start = (char *) ((uintptr_t(q) + HUGE_PAGE_SIZE - 1) & ~uintptr_t(HUGE_PAGE_SIZE - 1));
+      if(start > q) munmap(q, size_t(start - q));
+      if(q + HUGE_PAGE_SIZE > start) munmap(start + length, size_t(q + HUGE_PAGE_SIZE - start));
+      p = start;
+#ifdef MADV_HUGEPAGE
+      madvise(p, length, MADV_HUGEPAGE);
+#endif
+    }
+  }
+
+  if(p == MAP_FAILED) {
+    cerr << "Can not map " << length << " bytes: " << strerror(errno) << endl;
+    abort();
+  }
+
+  // Before anything touches the pages
+  if(policy->numa_node >= 0) bind_to_numa_node(p, length, policy->numa_node);
+
+  return p;
+}
+
+void *storage_allocate(size_t size, const StoragePolicy *policy) {
+  if(with_new(policy)) return new char[size];
+  if(!policy->directory) return map_in_memory(size, policy);
+
+  const char *directory = policy->directory;
+
+  if(size == 0) size = 1;
+  size_t length = strlen(directory);
+  char *filename = new char[length + 32];
+  strcpy(filename, directory);
+  strcpy(filename + length, "/mtp_storage_XXXXXX");
+  int fd = mkstemp(filename);
+  if(fd < 0) {
+    cerr << "Can not create a storage file in " << directory << ": " << strerror(errno) << endl;
+    abort();
+  }
+  unlink(filename);
+  delete[] filename;
+
+  if(ftruncate(fd, off_t(size)) < 0) {
+    cerr << "Can not extend a storage file to " << size << " bytes: " << strerror(errno) << endl;
+    abort();
+  }
+
+  void *p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(p == MAP_FAILED) {
+    cerr << "Can not map a storage file of " << size << " bytes: " << strerror(errno) << endl;
+    abort();
+  }
+
+  // The map keeps the file alive
+  close(fd);
+
+  return p;
+}
+
+void storage_free(void *p, size_t size, const StoragePolicy *policy) {
+  if(!p) return;
+  if(with_new(policy)) {
+    delete[] (char *) p;
+  } else if(!policy->directory) {
+    munmap(p, map_length(size, policy));
+  } else {
+    munmap(p, size == 0 ? 1 : size);
+  }
+}
+
+// madvise wants page-aligned addresses
+
+static void advise(void *p, size_t size, int advice) {
+  uintptr_t page_size = uintptr_t(sysconf(_SC_PAGESIZE));
+  uintptr_t start = uintptr_t(p) & ~(page_size - 1);
+  uintptr_t end = uintptr_t(p) + size;
+  if(end > start) madvise((void *) start, size_t(end - start), advice);
+}
+
+void storage_will_need(void *p, size_t size, const StoragePolicy *policy) {
+  if(policy && policy->directory) advise(p, size, MADV_WILLNEED);
+}
+
+int storage_nb_numa_nodes() {
+  int nb_nodes = 0, node;
+  DIR *dir = opendir("/sys/devices/system/node");
+  if(!dir) return 1;
+  while(struct dirent *entry = readdir(dir)) {
+    if(sscanf(entry->d_name, "node%d", &node) == 1) nb_nodes++;
+  }
+  closedir(dir);
+  return nb_nodes > 0 ? nb_nodes : 1;
+}
+
+size_t storage_physical_memory() {
+  long nb_pages = sysconf(_SC_PHYS_PAGES), page_size = sysconf(_SC_PAGESIZE);
+  if(nb_pages <= 0 || page_size <= 0) return 0;
+  return size_t(nb_pages) * size_t(page_size);
+}
+
+#else
+
+void *storage_allocate(size_t size, const StoragePolicy *policy) {
+  if(!with_new(policy)) {
+    cerr << "The file-backed storage, the huge pages and the NUMA binding need memory maps,"
+         << " using the memory." << endl;
+  }
+  return new char[size];
+}
+
+void storage_free(void *p, size_t size, const StoragePolicy *policy) {
+  delete[] (char *) p;
+}
+
+void storage_will_need(void *p, size_t size, const StoragePolicy *policy) { }
+
+int storage_nb_numa_nodes() {
+  return 1;
+}
+
+size_t storage_physical_memory() {
+  return 0;
+}
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ *  mtp is the ``Multi Tracked Paths'', an implementation of the
+ *  k-shortest paths algorithm for multi-target tracking.
+ *
+ *  Copyright (c) 2012 Idiap Research Institute, http://www.idiap.ch/
+ *  Written by Francois Fleuret <francois.fleuret@idiap.ch>
+ *
+ *  This file is part of mtp.
+ *
+ *  mtp is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License version 3 as
+ *  published by the Free Software Foundation.
+ *
+ *  mtp is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ *  License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with selector.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <stddef.h>
+
+// How the arrays in memory are mapped. With STORAGE_PAGES_DEFAULT,
+// they are allocated with new. With STORAGE_PAGES_TRANSPARENT, they
+// are anonymous maps aligned on 2MB and flagged with MADV_HUGEPAGE, so
+// that the kernel backs them with transparent huge pages when it can,
+// even if it does so only on request. With STORAGE_PAGES_HUGETLB,
+// they are taken from the pool of explicit huge pages (vm.nr_hugepages),
+// and from transparent ones if the pool is too small. Huge pages cut
+// the TLB misses of the random accesses of Dijkstra.
+
+enum { STORAGE_PAGES_DEFAULT, STORAGE_PAGES_TRANSPARENT, STORAGE_PAGES_HUGETLB };
+
+class StoragePolicy {
+public:
+  // With a null directory, the arrays are in memory, and otherwise in
+  // a memory map of a temporary file in that directory, so that the
+  // kernel can page them out to it and the problem can be larger than
+  // the RAM. The file is deleted right away, and disappears with the
+  // map. pages and numa_node apply only to the arrays in memory.
+  const char *directory;
+  int pages;
+  // The NUMA node the pages of the arrays are bound to, or -1 to let
+  // the kernel put them on the node of the thread which touches them
+  // first
+  int numa_node;
+
+  StoragePolicy();
+};
+
+// Allocation of the large arrays of the solver. The policy has to be
+// the same for the allocation and the release, and a null one is the
+// default: in memory, with new.
+
+void *storage_allocate(size_t size, const StoragePolicy *policy);
+void storage_free(void *p, size_t size, const StoragePolicy *policy);
+
+// Hints that [p, p+size) of an array allocated in a directory is going
+// to be needed soon. It does nothing for the arrays in memory, or
+// where memory maps are not available.
+
+void storage_will_need(void *p, size_t size, const StoragePolicy *policy);
+
+// The number of NUMA nodes, 1 if it is not known
+
+int storage_nb_numa_nodes();
+
+// The size of the RAM, or 0 if it is not known
+
+size_t storage_physical_memory();
+
+#endif
@@ -31,6 +31,25 @@ def generate_spatial_topology(numX, numY):
 
     return outputMatrix
 
+#(1b) Same topology, as the lists of reachable locations used by the tracker library, which avoids the
+#     numPositions x numPositions matrix.
+#   - The locations reachable from idx are motion_to[motion_first[idx]:motion_first[idx + 1]]
+
+def generate_sparse_spatial_topology(numX, numY):
+    numPositions = numX * numY
+    motion_first = np.zeros(numPositions + 1, dtype=np.int32)
+    motion_to = []
+    for idx in range(0, numPositions):
+        x = idx % numX
+        y = idx // numX
+        for dy in (-1, 0, 1):
+            for dx in (-1, 0, 1):
+                if 0 <= x + dx < numX and 0 <= y + dy < numY:
+                    motion_to.append(idx + dy * numX + dx)
+        motion_first[idx + 1] = len(motion_to)
+
+    return motion_first, np.array(motion_to, dtype=np.int32)
+
 #(2) Generate entry points to the graph.
 #   - Subjects are allowed to enter at the first time-frame at any position
 
@@ -112,4 +131,27 @@ def create_graph_input(data_dir, tracab_id, params):
     confidenceMatrix = read_mock_data(mock_data_path, numX * numY, numT)
     data = writeMatrix(data, confidenceMatrix)
 
-    data.close()
\ No newline at end of file
+    data.close()
+
+#Same input as create_graph_input, returned as arrays for the tracker library instead of written to config.dat
+
+def create_topology_arrays(params):
+
+    numT = params[1] - params[0] + 1
+    numX = params[6]
+    numY = params[7]
+
+    motion_first, motion_to = generate_sparse_spatial_topology(numX, numY)
+    entryMatrix = generate_entry_points(numX * numY, numT)
+    exitMatrix = generate_exit_points(numX * numY, numT)
+
+    return numT, motion_first, motion_to, entryMatrix, exitMatrix
+
+def create_graph_arrays(data_dir, tracab_id, params):
+
+    mock_data_path = os.path.join(data_dir, tracab_id, "mock")
+
+    numT, motion_first, motion_to, entryMatrix, exitMatrix = create_topology_arrays(params)
+    confidenceMatrix = read_mock_data(mock_data_path, params[6] * params[7], numT).astype(np.float32)
+
+    return numT, motion_first, motion_to, entryMatrix, exitMatrix, confidenceMatrix
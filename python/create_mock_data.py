@@ -41,4 +41,22 @@ def create_mock_data(data_dir, tracab_id, params, event_telemetry, telemetry_map
 
         # Save results
         with open(os.path.join(output_dir, "proba-f{}.dat".format(adjusted_frame)), "w") as f:
-            f.write("\n".join(["{} {}".format(a, b) for a, b in zip(range(len(Z)), Z)]))
\ No newline at end of file
+            f.write("\n".join(["{} {}".format(a, b) for a, b in zip(range(len(Z)), Z)]))
+
+#The positions of the players at every frame from start_frame to end_frame, for rasterize_detections
+
+def get_detections(params, event_telemetry, telemetry_map, video_metadata):
+
+    start_frame = params[0]
+    end_frame = params[1]
+
+    tracking_initial_frame = event_telemetry.metadata['initial_frame']
+    video_initial_frame = int(video_metadata['MediaproPanaMetaData']['match']['videofile']['start']['@iFrame'])
+    global_zero_frame = max(video_initial_frame, tracking_initial_frame)
+
+    detections = []
+    for frame in range(start_frame, end_frame + 1):
+        adjusted_frame = frame + global_zero_frame - tracking_initial_frame
+        detections.append(get_positions(adjusted_frame, telemetry_map))
+
+    return detections
@@ -1,6 +1,6 @@
 import os
 
-def write_trajectory_files(data_dir, tracab_id, params):
+def write_trajectories(data_dir, tracab_id, params, trajectories):
 
     xmin = params[2]
     xmax = params[3]
@@ -9,27 +9,20 @@ def write_trajectory_files(data_dir, tracab_id, params):
     num_x_grid = params[6]
     num_y_grid = params[7]
 
-    trajectory_file = os.path.join(data_dir, tracab_id, "graph", "trajectories.dat")
     output_path = os.path.join(data_dir, tracab_id, "trajectory_files")
     if not os.path.exists(output_path):
         os.mkdir(output_path)
 
-    count = 1
-    for line in open(trajectory_file):
-
-        x_bucket_width = (xmax - xmin) // num_x_grid
-        y_bucket_width = (ymax - ymin) // num_y_grid
-
-        points = []
+    x_bucket_width = (xmax - xmin) // num_x_grid
+    y_bucket_width = (ymax - ymin) // num_y_grid
 
-        data = line.split(" ")
-        if len(data) == 1:
-            continue
+    count = 1
+    for locations in trajectories:
 
         traj_data = open(os.path.join(output_path, str(count) + ".txt"), "w")
 
-        for i in range(4, len(data)):
-            grid_id = int(data[i])
+        for grid_id in locations:
+            grid_id = int(grid_id)
 
             y_grid_pos = grid_id // num_x_grid
             x_grid_pos = grid_id - y_grid_pos * num_x_grid
@@ -40,4 +33,19 @@ def write_trajectory_files(data_dir, tracab_id, params):
             traj_data.write("{0} {1} \n".format(xpos, ypos))
 
         traj_data.close()
-        count = count + 1
\ No newline at end of file
+        count = count + 1
+
+#Same from the trajectories.dat written by the mtp executable
+
+def write_trajectory_files(data_dir, tracab_id, params):
+
+    trajectory_file = os.path.join(data_dir, tracab_id, "graph", "trajectories.dat")
+
+    trajectories = []
+    for line in open(trajectory_file):
+        data = line.split(" ")
+        if len(data) == 1:
+            continue
+        trajectories.append(data[4:])
+
+    write_trajectories(data_dir, tracab_id, params, trajectories)
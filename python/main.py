@@ -1,6 +1,7 @@
 from create_mock_data import *
-from create_graph_input import create_graph_input
-from create_trajectory_files import write_trajectory_files
+from create_graph_input import create_topology_arrays
+from create_trajectory_files import write_trajectories
+from mtp_library import Tracker, rasterize_detections
 from create_video import write_video
 from download_utils import download_single_entry, unzip_entries
 
@@ -68,11 +69,13 @@ def main():
 
     print("Done!")
 
-    #Create mock data from tracab
+    #Compute the detection scores from tracab
 
-    print("Creating mock data...")
+    print("Computing detection scores...")
 
-    create_mock_data(data_dir, tracab_id, params, event_telemetry, telemetry_map, video_metadata)
+    detections = get_detections(params, event_telemetry, telemetry_map, video_metadata)
+    scores = rasterize_detections(detections, xmin, xmax, ymin, ymax, num_x_grid, num_y_grid,
+                                  false_pos_rate, false_neg_rate)
 
     print("Done!")
 
@@ -80,21 +83,20 @@ def main():
 
     print("Preparing KSP input...")
 
-    create_graph_input(data_dir, tracab_id, params)
+    numT, motion_first, motion_to, entries, exits = create_topology_arrays(params)
 
     print("Done!")
 
-    #Run C++ code
+    #Run C++ code through the library, the scores are not copied
 
     print("Running KSP...")
 
-    KSP_executable_path = "C:\\Users\\antonios.o\\Documents\\Test_projects\\MOT-MTP\\mtp\\MTP\\x64\\Release\\MTP.exe"
-    config_path = os.path.join(data_dir, tracab_id, "graph", "config.dat")
-    trajectory_path = os.path.join(data_dir, tracab_id, "graph", "trajectories.dat")
-    graph_path = os.path.join(data_dir, tracab_id, "graph", "graph.dat")
-
-    args = KSP_executable_path + " " + config_path + " " + trajectory_path + " " + graph_path + " 1"
-    os.system(args)
+    tracker = Tracker(numT, motion_first, motion_to)
+    tracker.set_entrances(entries)
+    tracker.set_exits(exits)
+    tracker.set_scores(scores)
+    tracker.track()
+    trajectories = [locations for (entrance_time, score, locations) in tracker.trajectories()]
 
     print("Done!")
 
@@ -102,7 +104,7 @@ def main():
 
     print("Writing trajectory files...")
 
-    write_trajectory_files(data_dir, tracab_id, params)
+    write_trajectories(data_dir, tracab_id, params, trajectories)
 
     print("Done!")
 
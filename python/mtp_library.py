@@ -0,0 +1,169 @@
+import ctypes
+import os
+import sys
+import numpy as np
+
+#Wrapper around libmtp, the C interface of the tracker.
+#   - All the arrays are passed as pointers to contiguous numpy arrays, int32 for the topology, entrances and exits,
+#     float32 for the detection scores.
+#   - The detection scores are not copied, the tracker reads them from the numpy array, so we keep a reference to it.
+
+def _library_name():
+    if sys.platform.startswith("win"):
+        return "mtp.dll"
+    elif sys.platform == "darwin":
+        return "libmtp.dylib"
+    return "libmtp.so"
+
+def load_library(path=None):
+    if path is None:
+        path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "mtp", _library_name())
+    lib = ctypes.CDLL(path)
+
+    p = ctypes.c_void_p
+    lib.mtp_create.restype = p
+    lib.mtp_create.argtypes = [ctypes.c_int, ctypes.c_int, p, p]
+    lib.mtp_destroy.restype = None
+    lib.mtp_destroy.argtypes = [p]
+    lib.mtp_set_entrances.argtypes = [p, p]
+    lib.mtp_set_exits.argtypes = [p, p]
+    lib.mtp_set_scores.argtypes = [p, p]
+    lib.mtp_set_option.argtypes = [p, ctypes.c_char_p, ctypes.c_double]
+    lib.mtp_track.argtypes = [p, ctypes.c_double]
+    lib.mtp_interrupted.argtypes = [p]
+    lib.mtp_nb_trajectories.argtypes = [p]
+    lib.mtp_total_nb_locations.argtypes = [p]
+    lib.mtp_get_trajectories.argtypes = [p, p, p, p, p, ctypes.c_int]
+    lib.mtp_sweep.argtypes = [p, ctypes.c_int, p, p, p, p, p, ctypes.c_int]
+    f = ctypes.c_float
+    lib.mtp_rasterize_detections.argtypes = [p, ctypes.c_int, p, p, p, f, f, f, f,
+                                             ctypes.c_int, ctypes.c_int, ctypes.c_int, f, f, ctypes.c_int]
+    return lib
+
+def _pointer(array):
+    return array.ctypes.data_as(ctypes.c_void_p)
+
+class Tracker:
+
+    def __init__(self, numT, motion_first, motion_to, lib=None):
+        self.lib = lib if lib is not None else load_library()
+        self.numT = numT
+        self.numPositions = len(motion_first) - 1
+        motion_first = np.ascontiguousarray(motion_first, dtype=np.int32)
+        motion_to = np.ascontiguousarray(motion_to, dtype=np.int32)
+        self.handle = self.lib.mtp_create(numT, self.numPositions, _pointer(motion_first), _pointer(motion_to))
+        if not self.handle:
+            raise ValueError("Invalid topology, or over the memory budget")
+        self.scores = None
+
+    def __del__(self):
+        if getattr(self, "handle", None):
+            self.lib.mtp_destroy(self.handle)
+            self.handle = None
+
+    def _check_shape(self, matrix, dtype):
+        matrix = np.ascontiguousarray(matrix, dtype=dtype)
+        if matrix.shape != (self.numT, self.numPositions):
+            raise ValueError("Expected a {0}x{1} array".format(self.numT, self.numPositions))
+        return matrix
+
+    def set_entrances(self, entrances):
+        self.lib.mtp_set_entrances(self.handle, _pointer(self._check_shape(entrances, np.int32)))
+
+    def set_exits(self, exits):
+        self.lib.mtp_set_exits(self.handle, _pointer(self._check_shape(exits, np.int32)))
+
+    #The array is used in place if it is already a contiguous float32 one, so modifying it changes the scores of the
+    #next tracking
+    def set_scores(self, scores):
+        self.scores = self._check_shape(scores, np.float32)
+        self.lib.mtp_set_scores(self.handle, _pointer(self.scores))
+
+    def set_option(self, name, value):
+        if self.lib.mtp_set_option(self.handle, name.encode(), float(value)) != 0:
+            raise ValueError("Invalid option {0}".format(name))
+
+    def track(self, time_budget=0):
+        if self.scores is None:
+            raise ValueError("No detection scores")
+        if self.lib.mtp_track(self.handle, float(time_budget)) != 0:
+            raise ValueError("Invalid tracking options, or over the memory budget")
+
+    def interrupted(self):
+        return self.lib.mtp_interrupted(self.handle) != 0
+
+    #Returns a list of (entrance_time, score, locations) tuples
+    def trajectories(self):
+        n = self.lib.mtp_nb_trajectories(self.handle)
+        total = self.lib.mtp_total_nb_locations(self.handle)
+        entrance_times = np.zeros(n, dtype=np.int32)
+        durations = np.zeros(n, dtype=np.int32)
+        scores = np.zeros(n, dtype=np.float32)
+        locations = np.zeros(total, dtype=np.int32)
+        self.lib.mtp_get_trajectories(self.handle, _pointer(entrance_times), _pointer(durations),
+                                      _pointer(scores), _pointer(locations), total)
+        result = []
+        start = 0
+        for k in range(n):
+            result.append((int(entrance_times[k]), float(scores[k]), locations[start:start + durations[k]]))
+            start = start + durations[k]
+        return result
+
+    #Tracks once per (offset, scale, clamp) transform of the scores, each one starting from the trajectories of the
+    #previous one, and returns a list of (total_score, number of trajectories). See rate_transform.
+    def sweep(self, transforms, num_threads=0):
+        if self.scores is None:
+            raise ValueError("No detection scores")
+        transforms = np.asarray(transforms, dtype=np.float32).reshape(-1, 3)
+        n = transforms.shape[0]
+        offsets = np.ascontiguousarray(transforms[:, 0])
+        scales = np.ascontiguousarray(transforms[:, 1])
+        clamps = np.ascontiguousarray(transforms[:, 2])
+        total_scores = np.zeros(n, dtype=np.float32)
+        num_trajectories = np.zeros(n, dtype=np.int32)
+        if self.lib.mtp_sweep(self.handle, n, _pointer(offsets), _pointer(scales), _pointer(clamps),
+                              _pointer(total_scores), _pointer(num_trajectories), num_threads) != 0:
+            raise ValueError("Invalid tracking options, or over the memory budget")
+        return [(float(total_scores[k]), int(num_trajectories[k])) for k in range(n)]
+
+#The (offset, scale, clamp) transform which turns the scores of rasterize_detections computed with the given rates
+#into the ones it would compute with the new rates, since they are affine in the probability of detection.
+def rate_transform(false_pos_rate, false_neg_rate, new_false_pos_rate, new_false_neg_rate):
+    detected = np.log((1 - false_neg_rate) / false_pos_rate)
+    missed = np.log(false_neg_rate / (1 - false_pos_rate))
+    new_detected = np.log((1 - new_false_neg_rate) / new_false_pos_rate)
+    new_missed = np.log(new_false_neg_rate / (1 - new_false_pos_rate))
+    scale = (new_detected - new_missed) / (detected - missed)
+    return (float(new_missed - scale * missed), float(scale), 0.0)
+
+#Computes the numT x (num_x_grid * num_y_grid) float32 scores of the grid from point detections, without the dense
+#distance matrix and the per-frame files of create_mock_data.
+#   - detections is a list with, for every frame, an array of (x, y) positions, and confidences an optional list with,
+#     for every frame, the array of their confidences.
+#   - Every detection is snapped to its nearest grid location, or with splat, spread on the four nearest ones.
+#   - The scores are the log-odds of occupancy given the false positive and false negative rates.
+
+def rasterize_detections(detections, xmin, xmax, ymin, ymax, num_x_grid, num_y_grid, false_pos_rate, false_neg_rate,
+                         confidences=None, splat=False, lib=None):
+    if lib is None:
+        lib = load_library()
+    numT = len(detections)
+    frame_first = np.zeros(numT + 1, dtype=np.int32)
+    for t in range(numT):
+        frame_first[t + 1] = frame_first[t] + len(detections[t])
+    xy = np.zeros((max(frame_first[numT], 1), 2), dtype=np.float32)
+    conf = None
+    if confidences is not None:
+        conf = np.ones(max(frame_first[numT], 1), dtype=np.float32)
+    for t in range(numT):
+        if len(detections[t]) > 0:
+            xy[frame_first[t]:frame_first[t + 1]] = np.asarray(detections[t], dtype=np.float32).reshape(-1, 2)
+            if conf is not None:
+                conf[frame_first[t]:frame_first[t + 1]] = confidences[t]
+    scores = np.zeros((numT, num_x_grid * num_y_grid), dtype=np.float32)
+    if lib.mtp_rasterize_detections(_pointer(scores), numT, _pointer(frame_first), _pointer(xy),
+                                    _pointer(conf) if conf is not None else None,
+                                    xmin, xmax, ymin, ymax, num_x_grid, num_y_grid, int(splat),
+                                    false_pos_rate, false_neg_rate, 0) != 0:
+        raise ValueError("Invalid detections")
+    return scores